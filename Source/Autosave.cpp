@@ -0,0 +1,96 @@
+#include "Autosave.h"
+#include "Fog.h"
+#include "SaveGame.h"
+#include <chrono>
+#include <utility>
+
+Autosaver::~Autosaver()
+{
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_quit = true;
+   }
+   m_wake.notify_one();
+   if (m_thread.joinable()) m_thread.join();
+}
+
+void Autosaver::request(const GameState& state, const std::string& path)
+{
+   using Clock = std::chrono::steady_clock;
+   const Clock::time_point start = Clock::now();
+   {
+      // The writer only holds the lock to swap buffers, never while writing
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_thread.joinable()) m_thread = std::thread(&Autosaver::writerLoop, this);
+      if (m_hasPending) ++m_superseded;
+      m_pending.copyFrom(state, false);
+      m_pendingPath = path;
+      m_pendingSnapshotMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+      m_hasPending = true;
+   }
+   m_wake.notify_one();
+}
+
+bool Autosaver::poll(AutosaveResult& result)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   if (!m_hasResult) return false;
+   result = m_result;
+   m_hasResult = false;
+   return true;
+}
+
+bool Autosaver::busy() const
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   return m_hasPending || m_writingNow;
+}
+
+void Autosaver::wait()
+{
+   std::unique_lock<std::mutex> lock(m_mutex);
+   m_idle.wait(lock, [this] { return !m_hasPending && !m_writingNow; });
+}
+
+int Autosaver::superseded() const
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   return m_superseded;
+}
+
+void Autosaver::writerLoop()
+{
+   using Clock = std::chrono::steady_clock;
+   std::unique_lock<std::mutex> lock(m_mutex);
+   for (;;)
+   {
+      m_wake.wait(lock, [this] { return m_quit || m_hasPending; });
+      if (!m_hasPending) return; // Quitting, with nothing left to write
+
+      // Swapping moves the arenas, so both buffers keep their capacity
+      std::swap(m_pending, m_writing);
+      const std::string path = m_pendingPath;
+      AutosaveResult result;
+      result.turn = m_writing.currentTurn;
+      result.snapshotMs = m_pendingSnapshotMs;
+      m_hasPending = false;
+      m_writingNow = true;
+      lock.unlock();
+
+      const Clock::time_point start = Clock::now();
+      if (m_writing.fogWordsPerRow > 0)
+      {
+         m_writing.fogVisible.resize(m_writing.fogExplored.size());
+         m_writing.fogVisionCount.resize(m_writing.clans.size() * m_writing.width * m_writing.height);
+         rebuildFog(m_writing);
+      }
+      result.ok = saveGame(m_writing, path, result.error);
+      result.writeMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+      lock.lock();
+      m_writingNow = false;
+      m_result = result;
+      m_hasResult = true;
+      m_idle.notify_all();
+   }
+}
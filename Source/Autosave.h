@@ -0,0 +1,71 @@
+#ifndef AUTOSAVE_H
+#define AUTOSAVE_H
+
+#include "GameState.h"
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// One finished autosave, for the caller to log
+struct AutosaveResult
+{
+   int turn = 0;
+   bool ok = false;
+   std::string error;
+   double snapshotMs = 0.0; // Main thread: copying the state
+   double writeMs = 0.0;    // Writer thread: rebuilding visibility, saveGame, sync and rename
+};
+
+// Saves the game in the background.  request() copies the state into a snapshot
+// buffer on the calling thread, which is one memmove per arena and allocates nothing
+// once the buffers have grown (see GameState::copyFrom).  Visibility is left out of
+// the copy, which halves it on large worlds; a writer thread of its own rebuilds it
+// from the snapshot and turns the snapshot into a save with saveGame.  The writer is a dedicated
+// thread rather than a WorkerPool job because a write can outlast several turns and
+// the pool belongs to the simulation.
+//
+// There are two buffers, the one being written and one pending.  A request made
+// while a write is still going replaces the pending snapshot, so a slow disk costs
+// skipped autosaves, never a stall.
+class Autosaver
+{
+public:
+   Autosaver() = default;
+   ~Autosaver(); // Finishes the pending save, if any
+
+   Autosaver(const Autosaver&) = delete;
+   Autosaver& operator=(const Autosaver&) = delete;
+
+   // Snapshots state to be saved to path.  Starts the writer thread on first use.
+   void request(const GameState& state, const std::string& path);
+
+   // Takes the result of the latest finished save, once
+   bool poll(AutosaveResult& result);
+
+   bool busy() const;
+   void wait(); // Blocks until every requested save is on disk
+   int superseded() const; // Snapshots replaced before they were written
+
+private:
+   void writerLoop();
+
+   mutable std::mutex m_mutex;
+   std::condition_variable m_wake;
+   std::condition_variable m_idle;
+   std::thread m_thread;
+
+   GameState m_pending;
+   GameState m_writing;
+   std::string m_pendingPath;
+   double m_pendingSnapshotMs = 0.0;
+   bool m_hasPending = false;
+   bool m_writingNow = false;
+   bool m_quit = false;
+   int m_superseded = 0;
+
+   AutosaveResult m_result;
+   bool m_hasResult = false;
+};
+
+#endif
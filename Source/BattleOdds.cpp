@@ -0,0 +1,188 @@
+#include "BattleOdds.h"
+#include "Combat.h"
+#include "GameState.h"
+#include "Units.h"
+#include <algorithm>
+#include <cstring>
+
+static_assert((ODDS_CACHE_SIZE & (ODDS_CACHE_SIZE - 1)) == 0, "ODDS_CACHE_SIZE must be a power of two");
+
+static uint64_t hashKey(const StackKey& key)
+{
+   // FNV-1a over the raw bytes; keys are small and fully initialised
+   const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&key);
+   uint64_t hash = 0xcbf29ce484222325ULL;
+   for (size_t i = 0; i < sizeof(StackKey); ++i)
+   {
+      hash ^= bytes[i];
+      hash *= 0x100000001b3ULL;
+   }
+   return hash;
+}
+
+static bool sameKind(const CombatantKind& kind, const Unit& unit)
+{
+   return kind.type == static_cast<uint8_t>(unit.type) && kind.attack == unit.attackStrength && kind.defense == unit.defenseStrength
+      && kind.movement == unit.movementPoints && kind.abilities == unit.abilities;
+}
+
+static bool kindLess(const CombatantKind& a, const CombatantKind& b)
+{
+   if (a.type != b.type) return a.type < b.type;
+   if (a.attack != b.attack) return a.attack < b.attack;
+   if (a.defense != b.defense) return a.defense < b.defense;
+   if (a.movement != b.movement) return a.movement < b.movement;
+   return a.abilities < b.abilities;
+}
+
+// Counts the units on a tile that belong (or, for the defender, do not belong) to a
+// clan into kinds, up to the battle's per-side limit
+static bool addSide(const GameState& state, int side, int clanIdx, int x, int y, StackKey& key)
+{
+   int fighters = 0;
+   for (int slot = firstUnitOnTile(state, x, y); slot >= 0 && fighters < MAX_COMBATANTS_PER_SIDE; slot = state.units[slot].nextOnTile)
+   {
+      const Unit& unit = state.units[slot];
+      if ((unit.clanIdx == clanIdx) != (side == COMBAT_ATTACKER)) continue;
+      ++fighters;
+
+      CombatantKind* kinds = key.kinds[side];
+      int k = 0;
+      while (k < key.kindCount[side] && !sameKind(kinds[k], unit)) ++k;
+      if (k == key.kindCount[side])
+      {
+         if (k == ODDS_MAX_KINDS) return false;
+         kinds[k].type = static_cast<uint8_t>(unit.type);
+         kinds[k].attack = static_cast<uint8_t>(unit.attackStrength);
+         kinds[k].defense = static_cast<uint8_t>(unit.defenseStrength);
+         kinds[k].movement = static_cast<uint8_t>(unit.movementPoints);
+         kinds[k].abilities = unit.abilities;
+         ++key.kindCount[side];
+      }
+      ++kinds[k].count;
+   }
+   std::sort(key.kinds[side], key.kinds[side] + key.kindCount[side], kindLess);
+   return true;
+}
+
+bool makeStackKey(const GameState& state, int attackerClan, int fromX, int fromY, int toX, int toY, StackKey& key)
+{
+   std::memset(&key, 0, sizeof(key));
+   key.terrain = static_cast<uint8_t>(state.map[state.tileIndex(toX, toY)].terrain);
+   return addSide(state, COMBAT_ATTACKER, attackerClan, fromX, fromY, key)
+      && addSide(state, COMBAT_DEFENDER, attackerClan, toX, toY, key);
+}
+
+BattleOddsCache::BattleOddsCache()
+   : m_entries(ODDS_CACHE_SIZE)
+{
+   for (Entry& entry : m_entries)
+      entry.lastUsed = 0;
+}
+
+// Plays ODDS_SAMPLES battles, each set up by addUnits(battle), and averages the outcomes
+template <typename AddUnits>
+static void estimateOdds(Terrain terrain, uint64_t seed, AddUnits addUnits, BattleOdds& odds)
+{
+   int wins[2] = {};
+   int lost[2] = {};
+   Battle battle;
+   for (int sample = 0; sample < ODDS_SAMPLES; ++sample)
+   {
+      battle.reset(terrain, seed + sample);
+      addUnits(battle);
+
+      const BattleResult result = battle.run();
+      if (result.winner != COMBAT_DRAW) ++wins[result.winner];
+      for (int i = 0; i < battle.count(); ++i)
+         lost[battle.side(i)] += battle.alive(i) ? 0 : 1;
+   }
+
+   const float samples = static_cast<float>(ODDS_SAMPLES);
+   odds.attackerWins = wins[COMBAT_ATTACKER] / samples;
+   odds.defenderWins = wins[COMBAT_DEFENDER] / samples;
+   odds.attackerLosses = lost[COMBAT_ATTACKER] / samples;
+   odds.defenderLosses = lost[COMBAT_DEFENDER] / samples;
+}
+
+void BattleOddsCache::simulate(const StackKey& key, uint64_t hash, BattleOdds& odds)
+{
+   estimateOdds(static_cast<Terrain>(key.terrain), hash, [&key](Battle& battle)
+   {
+      for (int side = 0; side < 2; ++side)
+      {
+         for (int k = 0; k < key.kindCount[side]; ++k)
+         {
+            const CombatantKind& kind = key.kinds[side][k];
+            for (int n = 0; n < kind.count; ++n)
+               battle.add(side, static_cast<UnitType>(kind.type), kind.attack, kind.defense, kind.movement, kind.abilities, -1);
+         }
+      }
+   }, odds);
+}
+
+const BattleOdds& BattleOddsCache::get(const StackKey& key)
+{
+   const uint64_t hash = hashKey(key);
+   const size_t mask = ODDS_CACHE_SIZE - 1;
+   ++m_clock;
+
+   // Linear probe: a hit, else the first empty slot, else the least recently used
+   Entry* victim = nullptr;
+   for (int probe = 0; probe < ODDS_PROBE_LIMIT; ++probe)
+   {
+      Entry& entry = m_entries[(hash + probe) & mask];
+      if (entry.lastUsed != 0 && entry.hash == hash && std::memcmp(&entry.key, &key, sizeof(StackKey)) == 0)
+      {
+         entry.lastUsed = m_clock;
+         ++m_hits;
+         return entry.odds;
+      }
+      if (entry.lastUsed == 0)
+      {
+         if (!victim || victim->lastUsed != 0) victim = &entry;
+      }
+      else if (!victim || (victim->lastUsed != 0 && entry.lastUsed < victim->lastUsed))
+      {
+         victim = &entry;
+      }
+   }
+
+   ++m_misses;
+   victim->hash = hash;
+   victim->lastUsed = m_clock;
+   victim->key = key;
+   simulate(key, hash, victim->odds);
+   return victim->odds;
+}
+
+const BattleOdds& BattleOddsCache::get(const GameState& state, int attackerClan, int fromX, int fromY, int toX, int toY)
+{
+   StackKey key;
+   if (makeStackKey(state, attackerClan, fromX, fromY, toX, toY, key))
+      return get(key);
+
+   // Too many kinds for a key: simulate the real stacks without caching the result
+   ++m_misses;
+   estimateOdds(state.map[state.tileIndex(toX, toY)].terrain, 1, [&](Battle& battle)
+   {
+      for (int side = 0; side < 2; ++side)
+      {
+         const int x = side == COMBAT_ATTACKER ? fromX : toX;
+         const int y = side == COMBAT_ATTACKER ? fromY : toY;
+         for (int slot = firstUnitOnTile(state, x, y); slot >= 0; slot = state.units[slot].nextOnTile)
+         {
+            const Unit& unit = state.units[slot];
+            if ((unit.clanIdx == attackerClan) == (side == COMBAT_ATTACKER))
+               battle.add(side, unit.type, unit.attackStrength, unit.defenseStrength, unit.movementPoints, unit.abilities, slot);
+         }
+      }
+   }, m_uncached);
+   return m_uncached;
+}
+
+BattleOddsCache& threadBattleOdds()
+{
+   thread_local BattleOddsCache cache;
+   return cache;
+}
@@ -0,0 +1,89 @@
+#ifndef BATTLEODDS_H
+#define BATTLEODDS_H
+
+#include "Game.h"
+#include <cstdint>
+#include <vector>
+
+struct GameState;
+
+const int ODDS_MAX_KINDS = 6;        // Distinct combatant kinds per side a key can describe
+const int ODDS_SAMPLES = 64;         // Battles simulated per odds entry
+const int ODDS_CACHE_SIZE = 1024;    // Entries per cache; a power of two
+const int ODDS_PROBE_LIMIT = 8;      // Slots tried before the stalest one is replaced
+
+struct BattleOdds
+{
+   float attackerWins = 0.0f;
+   float defenderWins = 0.0f;        // The rest are draws
+   float attackerLosses = 0.0f;      // Expected units lost
+   float defenderLosses = 0.0f;
+};
+
+// Units that fight identically, and how many of them
+struct CombatantKind
+{
+   uint8_t type;
+   uint8_t attack;
+   uint8_t defense;
+   uint8_t movement;
+   uint8_t count;
+   uint8_t pad[3];
+   uint32_t abilities;
+};
+
+// A battle reduced to what decides it: the terrain and each side's kinds, sorted, so
+// the same stacks in any order give the same key.  Padding is always zeroed, so keys
+// compare and hash as raw bytes.
+struct StackKey
+{
+   uint8_t terrain;
+   uint8_t kindCount[2];
+   uint8_t pad;
+   CombatantKind kinds[2][ODDS_MAX_KINDS];
+};
+
+// Builds the key for resolveBattle(state, attackerClan, fromX, fromY, toX, toY).
+// Returns false if a side has more than ODDS_MAX_KINDS kinds.
+bool makeStackKey(const GameState& state, int attackerClan, int fromX, int fromY, int toX, int toY, StackKey& key);
+
+// Win chances and expected losses, estimated by playing ODDS_SAMPLES auto-resolved
+// battles and memoized by StackKey.  The odds depend on nothing but the key, so
+// entries never go stale; when the table fills, the least recently used entry in the
+// probe window is replaced.  Not thread-safe: use threadBattleOdds().
+class BattleOddsCache
+{
+public:
+   BattleOddsCache();
+
+   const BattleOdds& get(const StackKey& key);
+
+   // Odds for an attack from one tile onto another; stacks too varied for a key are
+   // simulated without being cached
+   const BattleOdds& get(const GameState& state, int attackerClan, int fromX, int fromY, int toX, int toY);
+
+   int hits() const { return m_hits; }
+   int misses() const { return m_misses; }
+
+private:
+   struct Entry
+   {
+      uint64_t hash;
+      uint32_t lastUsed; // 0 = empty
+      StackKey key;
+      BattleOdds odds;
+   };
+
+   static void simulate(const StackKey& key, uint64_t hash, BattleOdds& odds);
+
+   std::vector<Entry> m_entries;
+   BattleOdds m_uncached;
+   uint32_t m_clock = 0;
+   int m_hits = 0;
+   int m_misses = 0;
+};
+
+// One cache per thread, so AI jobs on a WorkerPool can look odds up without locking
+BattleOddsCache& threadBattleOdds();
+
+#endif
@@ -0,0 +1,147 @@
+#include "BuildQueues.h"
+#include "GameState.h"
+#include "StateHash.h"
+#include "Units.h"
+
+static int allocateItem(GameState& state)
+{
+   int idx = state.firstFreeQueueItem;
+   if (idx >= 0)
+   {
+      state.firstFreeQueueItem = state.queueItems[idx].next;
+   }
+   else
+   {
+      idx = (int)state.queueItems.size();
+      state.queueItems.push_back(QueueItem());
+   }
+   state.markChanged(ChangeKind::QUEUE_ITEM, idx);
+   return idx;
+}
+
+static void freeItem(GameState& state, int idx)
+{
+   QueueItem& item = state.queueItems[idx];
+   item.alive = false;
+   item.villageIdx = -1;
+   item.next = state.firstFreeQueueItem;
+   state.firstFreeQueueItem = idx;
+   state.markChanged(ChangeKind::QUEUE_ITEM, idx);
+}
+
+// Removes the front entry.  The caller keeps the village's hash key up to date.
+static void popFront(GameState& state, Village& village)
+{
+   const int idx = village.queueHead;
+   state.worldHash ^= hashQueueItem(idx, state.queueItems[idx]);
+   village.queueHead = state.queueItems[idx].next;
+   if (village.queueHead < 0) village.queueTail = -1;
+   --village.queueLength;
+   freeItem(state, idx);
+}
+
+bool enqueueBuild(GameState& state, int villageIdx, QueueItemKind kind, int type)
+{
+   if (villageIdx < 0 || villageIdx >= (int)state.villages.size() || !state.villages[villageIdx].alive) return false;
+   const int typeCount = kind == QueueItemKind::BUILDING ? BUILDING_TYPE_COUNT : UNIT_TYPE_COUNT;
+   if (type < 0 || type >= typeCount || state.villages[villageIdx].queueLength >= MAX_BUILD_QUEUE) return false;
+
+   // May grow the pool, so take it before holding references
+   const int idx = allocateItem(state);
+   QueueItem& item = state.queueItems[idx];
+   item.kind = kind;
+   item.type = static_cast<uint8_t>(type);
+   item.alive = true;
+   item.villageIdx = villageIdx;
+   item.next = -1;
+   state.worldHash ^= hashQueueItem(idx, item);
+
+   Village& village = state.villages[villageIdx];
+   const uint64_t villageKey = hashVillage(villageIdx, village);
+   if (village.queueTail >= 0)
+   {
+      QueueItem& tail = state.queueItems[village.queueTail];
+      const uint64_t tailKey = hashQueueItem(village.queueTail, tail);
+      tail.next = idx;
+      state.worldHash ^= tailKey ^ hashQueueItem(village.queueTail, tail);
+      state.markChanged(ChangeKind::QUEUE_ITEM, village.queueTail);
+   }
+   else
+   {
+      village.queueHead = idx;
+   }
+   village.queueTail = idx;
+   ++village.queueLength;
+   state.worldHash ^= villageKey ^ hashVillage(villageIdx, village);
+   state.markChanged(ChangeKind::VILLAGE, villageIdx);
+   return true;
+}
+
+void clearBuildQueue(GameState& state, int villageIdx)
+{
+   Village& village = state.villages[villageIdx];
+   if (village.queueHead < 0) return;
+
+   const uint64_t villageKey = hashVillage(villageIdx, village);
+   while (village.queueHead >= 0)
+      popFront(state, village);
+   state.worldHash ^= villageKey ^ hashVillage(villageIdx, village);
+   state.markChanged(ChangeKind::VILLAGE, villageIdx);
+}
+
+// Whether the front entry can be paid for this turn
+static bool frontReady(const GameState& state, const Village& village)
+{
+   const QueueItem& item = state.queueItems[village.queueHead];
+   if (item.kind == QueueItemKind::BUILDING)
+      return village.productionStorehouse >= buildingCost(static_cast<BuildingType>(item.type));
+   return state.clans[village.clanIdx].gold >= unitTypeInfo(static_cast<UnitType>(item.type)).goldCost && state.firstFreeUnit >= 0;
+}
+
+// Pays for and completes the front entry, which must be ready
+static void completeFront(GameState& state, int villageIdx, TurnEventLog* events)
+{
+   Village& village = state.villages[villageIdx];
+   const QueueItem item = state.queueItems[village.queueHead];
+
+   if (item.kind == QueueItemKind::BUILDING)
+   {
+      const BuildingType type = static_cast<BuildingType>(item.type);
+      int tileX, tileY;
+      const bool built = canBuild(state, village, type, tileX, tileY) && buildBuilding(village, type, tileX, tileY);
+      popFront(state, village);
+      if (built && events)
+         events->push(TurnEventType::BUILDING_COMPLETED, village.clanIdx, villageIdx, village.buildingCount, item.type);
+      return;
+   }
+
+   const UnitType type = static_cast<UnitType>(item.type);
+   Clan& clan = state.clans[village.clanIdx];
+   const uint64_t clanKey = hashClan(village.clanIdx, clan);
+   clan.gold -= unitTypeInfo(type).goldCost;
+   state.worldHash ^= clanKey ^ hashClan(village.clanIdx, clan);
+   state.markChanged(ChangeKind::CLAN, village.clanIdx);
+
+   const UnitHandle unit = createUnit(state, type, village.clanIdx, village.x, village.y);
+   popFront(state, village);
+   if (events)
+      events->push(TurnEventType::UNIT_TRAINED, village.clanIdx, villageIdx, unit.index, item.type);
+}
+
+void processBuildQueues(GameState& state, TurnEventLog* events)
+{
+   // Most villages have nothing queued or are still saving up, so the common case is
+   // one or two tests per village and no hashing
+   for (int v = 0; v < (int)state.villages.size(); ++v)
+   {
+      Village& village = state.villages[v];
+      if (village.queueHead < 0 || !village.alive || !frontReady(state, village)) continue;
+
+      const uint64_t villageKey = hashVillage(v, village);
+      do
+         completeFront(state, v, events);
+      while (village.queueHead >= 0 && frontReady(state, village));
+      state.worldHash ^= villageKey ^ hashVillage(v, village);
+      state.markChanged(ChangeKind::VILLAGE, v);
+   }
+}
@@ -0,0 +1,28 @@
+#ifndef BUILDQUEUES_H
+#define BUILDQUEUES_H
+
+#include "Clan.h"
+#include "TurnEvents.h"
+
+struct GameState;
+
+// Per-village build queues.  Entries live in one shared pool, GameState::queueItems,
+// with a free list through QueueItem::next, and each village chains its own entries
+// from Village::queueHead.  Queues are plain data in the GameState, so they are copied
+// with it and covered by the world hash.
+
+// Appends an entry to the village's queue.  Returns false if the village is not alive,
+// the type is out of range or the queue already holds MAX_BUILD_QUEUE entries.
+bool enqueueBuild(GameState& state, int villageIdx, QueueItemKind kind, int type);
+
+// Drops every entry, for a village that is razed or changes hands
+void clearBuildQueue(GameState& state, int villageIdx);
+
+// One pass over the villages, run at the end of each turn after production.  Each
+// village completes entries from the front of its queue until one cannot be paid for
+// yet: a building takes productionStorehouse and pushes BUILDING_COMPLETED, a unit
+// takes the clan's gold and pushes UNIT_TRAINED.  A building whose village has no
+// free worker or site left is dropped rather than blocking the queue.
+void processBuildQueues(GameState& state, TurnEventLog* events = nullptr);
+
+#endif
@@ -1,50 +1,75 @@
 #include "Clan.h"
+#include "BuildQueues.h"
 #include "Map.h"
 #include "Game.h"
+#include "GameState.h"
+#include "StateHash.h"
+#include <cstring>
 
-bool canBuild(const Village& village, const std::vector<SquareTile>& map, BuildingType type, int& tileX, int& tileY)
+const char* buildingName(BuildingType type)
+{
+   switch (type)
+   {
+   case BuildingType::FARM:         return "Farm";
+   case BuildingType::LOGGING_CAMP: return "Logging Camp";
+   case BuildingType::MINE:         return "Mine";
+   case BuildingType::WORSHIP_SITE: return "Worship Site";
+   case BuildingType::LIBRARY:      return "Library";
+   }
+   return "Unknown";
+}
+
+void setName(char (&dest)[MAX_NAME_LENGTH], const char* name)
+{
+   std::strncpy(dest, name, MAX_NAME_LENGTH - 1);
+   dest[MAX_NAME_LENGTH - 1] = '\0';
+}
+
+void setName(char (&dest)[MAX_NAME_LENGTH], const std::string& name)
+{
+   setName(dest, name.c_str());
+}
+
+int buildingCost(BuildingType type)
+{
+   switch (type)
+   {
+   case BuildingType::FARM:         return 5;
+   case BuildingType::LOGGING_CAMP: return 5;
+   case BuildingType::MINE:         return 7;
+   case BuildingType::WORSHIP_SITE: return 7;
+   case BuildingType::LIBRARY:      return 6;
+   }
+   return 0;
+}
+
+bool canBuild(const GameState& state, const Village& village, BuildingType type, int& tileX, int& tileY)
 {
    // Check if there's an available worker
    bool hasFreeWorker = false;
-   int freeWorkerIdx = -1;
-   for (size_t i = 0; i < village.workers.size(); ++i)
+   for (int i = 0; i < MAX_VILLAGE_POPULATION; ++i)
    {
-      if (!village.workers[i])
+      if (!(village.workers & (1u << i)))
       {
          hasFreeWorker = true;
-         freeWorkerIdx = i;
          break;
       }
    }
-   if (!hasFreeWorker || (int)village.buildings.size() >= village.population) return false; // Max buildings = current population
+   if (!hasFreeWorker || village.buildingCount >= village.population || village.buildingCount >= MAX_VILLAGE_BUILDINGS) return false; // Max buildings = current population
 
    // Check production points
-   int cost = 0;
+   if (village.productionStorehouse < buildingCost(type)) return false;
+
+   // Each building needs its own kind of site
    Terrain requiredTerrain = Terrain::GRASSLAND; // Default
    switch (type)
    {
-   case BuildingType::FARM:
-      cost = 5; // Example cost
-      requiredTerrain = Terrain::GRASSLAND;
-      break;
-   case BuildingType::LOGGING_CAMP:
-      cost = 5;
-      requiredTerrain = Terrain::FOREST;
-      break;
-   case BuildingType::MINE:
-      cost = 7;
-      requiredTerrain = Terrain::HILLS;
-      break;
-   case BuildingType::WORSHIP_SITE:
-      cost = 7;
-      requiredTerrain = Terrain::HILLS;
-      break;
-   case BuildingType::LIBRARY:
-      cost = 6;
-      requiredTerrain = Terrain::GRASSLAND;
-      break;
+   case BuildingType::FARM:         requiredTerrain = Terrain::GRASSLAND; break;
+   case BuildingType::LOGGING_CAMP: requiredTerrain = Terrain::FOREST;    break;
+   case BuildingType::MINE:         requiredTerrain = Terrain::HILLS;     break;
+   case BuildingType::WORSHIP_SITE: requiredTerrain = Terrain::HILLS;     break;
+   case BuildingType::LIBRARY:      requiredTerrain = Terrain::GRASSLAND; break;
    }
-   if (village.productionStorehouse < cost) return false;
 
    // Check adjacent tiles
    for (int dy = -1; dy <= 1; ++dy)
@@ -54,15 +79,15 @@ bool canBuild(const Village& village, const std::vector<SquareTile>& map, Buildi
          if (dx == 0 && dy == 0) continue; // Skip village tile itself
          int nx = village.x + dx;
          int ny = village.y + dy;
-         if (nx >= 0 && nx < GRID_WIDTH && ny >= 0 && ny < GRID_HEIGHT)
+         if (state.inBounds(nx, ny))
          {
-            int idx = ny * GRID_WIDTH + nx;
-            if (map[idx].terrain == requiredTerrain && !map[idx].hasVillage) // Check if tile is free
+            int idx = state.tileIndex(nx, ny);
+            if (state.map[idx].terrain == requiredTerrain && !state.map[idx].hasVillage) // Check if tile is free
             {
                bool tileOccupied = false;
-               for (const auto& b : village.buildings)
+               for (int b = 0; b < village.buildingCount; ++b)
                {
-                  if (b.tileX == nx && b.tileY == ny)
+                  if (village.buildings[b].tileX == nx && village.buildings[b].tileY == ny)
                   {
                      tileOccupied = true;
                      break;
@@ -81,8 +106,17 @@ bool canBuild(const Village& village, const std::vector<SquareTile>& map, Buildi
    return false; // No suitable tile found
 }
 
-void buildBuilding(Village& village, BuildingType type, int tileX, int tileY)
+bool buildBuilding(Village& village, BuildingType type, int tileX, int tileY)
 {
+   // Checked before anything is spent, so a full village keeps its production and workers
+   int workerIdx = -1;
+   for (int i = 0; i < MAX_VILLAGE_POPULATION && workerIdx < 0; ++i)
+   {
+      if (!(village.workers & (1u << i)))
+         workerIdx = i;
+   }
+   if (workerIdx < 0 || village.buildingCount >= MAX_VILLAGE_BUILDINGS) return false;
+
    Building building;
    building.tileX = tileX;
    building.tileY = tileY;
@@ -90,35 +124,30 @@ void buildBuilding(Village& village, BuildingType type, int tileX, int tileY)
    switch (type)
    {
    case BuildingType::FARM:
-      building.name = "Farm";
       building.type = BuildingType::FARM;
       building.productionCost = 5;
       building.upkeepCost = 0;
       building.productionBonus = 1;
       break;
    case BuildingType::LOGGING_CAMP:
-      building.name = "Logging Camp";
       building.type = BuildingType::LOGGING_CAMP;
       building.productionCost = 5;
       building.upkeepCost = 0;
       building.productionBonus = 1;
       break;
    case BuildingType::MINE:
-      building.name = "Mine";
       building.type = BuildingType::MINE;
       building.productionCost = 7;
       building.upkeepCost = 0;
       building.goldBonus = 1;
       break;
    case BuildingType::WORSHIP_SITE:
-      building.name = "Worship Site";
       building.type = BuildingType::WORSHIP_SITE;
       building.productionCost = 7;
       building.upkeepCost = 0;
       building.worshipBonus = 1;
       break;
    case BuildingType::LIBRARY:
-      building.name = "Library";
       building.type = BuildingType::LIBRARY;
       building.productionCost = 6;
       building.upkeepCost = 0;
@@ -126,94 +155,127 @@ void buildBuilding(Village& village, BuildingType type, int tileX, int tileY)
       break;
    }
 
-   // Assign worker
-   for (size_t i = 0; i < village.workers.size(); ++i)
-   {
-      if (!village.workers[i])
-      {
-         village.workers[i] = true;
-         building.workerIdx = i;
-         break;
-      }
-   }
-
-   // Deduct production cost
+   village.workers |= (1u << workerIdx);
+   building.workerIdx = workerIdx;
    village.productionStorehouse -= building.productionCost;
-
-   // Add building
-   village.buildings.push_back(building);
+   village.buildings[village.buildingCount++] = building;
+   return true;
 }
 
 VillageProduction calculateVillageProduction(const Village& village, const Clan& owner)
 {
-    VillageProduction prod;
-    prod.food         = BASE_FOOD;
-    prod.production   = BASE_PRODUCTION;
-    prod.gold         = BASE_GOLD;
-    prod.knowledge    = BASE_KNOWLEDGE;
-    prod.worship      = BASE_WORSHIP;
-
-    bool isGlendwellers = (owner.name == "Glendwellers");
-    bool isGilded       = (owner.name == "Gilded");
+    // Fixed cost whatever the clan's traits and techs: they are already folded into
+    // owner.production by compileProduction
+    const ProductionTable& table = owner.production;
+    int counts[BUILDING_TYPE_COUNT] = {};
+    for (int b = 0; b < village.buildingCount; ++b)
+        ++counts[static_cast<int>(village.buildings[b].type)];
 
-    for (const auto& building : village.buildings)
+    int yield[RESOURCE_TYPE_COUNT];
+    for (int r = 0; r < RESOURCE_TYPE_COUNT; ++r)
     {
-        switch (building.type)
-        {
-        case BuildingType::FARM:
-            prod.food += (isGlendwellers ? 2 : 1);
-            break;
-        case BuildingType::LOGGING_CAMP:
-            prod.production += 1;
-            break;
-        case BuildingType::MINE:
-            prod.gold += (isGilded ? 2 : 1);
-            break;
-        case BuildingType::WORSHIP_SITE:
-            prod.worship += 1;
-            break;
-        case BuildingType::LIBRARY:
-            prod.knowledge += 1;
-            break;
-        }
+        int total = table.base[r];
+        for (int t = 0; t < BUILDING_TYPE_COUNT; ++t)
+            total += counts[t] * table.perBuilding[t][r];
+        yield[r] = total * table.percent[r] / 100;
     }
 
+    VillageProduction prod;
+    prod.food         = yield[static_cast<int>(ResourceType::RES_FOOD)];
+    prod.production   = yield[static_cast<int>(ResourceType::RES_PRODUCTION)];
+    prod.gold         = yield[static_cast<int>(ResourceType::RES_GOLD)];
+    prod.knowledge    = yield[static_cast<int>(ResourceType::RES_KNOWLEDGE)];
+    prod.worship      = yield[static_cast<int>(ResourceType::RES_WORSHIP)];
     return prod;
 }
 
-void processEndOfTurn(std::vector<Clan>& clans, std::vector<Village>& villages)
+// Adds amount to a clan stockpile, raising a RESOURCE_THRESHOLD event if it crosses a step boundary
+static void addToStockpile(int& stockpile, int amount, int clanIdx, ResourceType resource, TurnEventLog* events)
+{
+    const int before = stockpile;
+    stockpile += amount;
+    if (events && before / RESOURCE_THRESHOLD_STEP != stockpile / RESOURCE_THRESHOLD_STEP)
+        events->push(TurnEventType::RESOURCE_THRESHOLD, clanIdx, -1, stockpile, static_cast<uint8_t>(resource));
+}
+
+void processEndOfTurn(GameState& state, TurnEventLog* events, TurnProfiler* profiler)
 {
-    for (size_t vIdx = 0; vIdx < villages.size(); ++vIdx)
+    std::vector<Clan>& clans = state.clans;
+    std::vector<Village>& villages = state.villages;
+
+    // Clans change many times per turn, so take their keys out once here and put them back at the end
+    for (size_t cIdx = 0; cIdx < clans.size(); ++cIdx)
+    {
+        state.worldHash ^= hashClan((int)cIdx, clans[cIdx]);
+        state.markChanged(ChangeKind::CLAN, (int)cIdx);
+    }
+
+    {
+        ScopedPhaseTimer timer(profiler, TurnPhase::PRODUCTION);
+        for (size_t vIdx = 0; vIdx < villages.size(); ++vIdx)
+        {
+            Village& village = villages[vIdx];
+            if (village.clanIdx < 0 || village.clanIdx >= (int)clans.size()) continue;
+
+            Clan& owner = clans[village.clanIdx];
+            VillageProduction thisTurn = calculateVillageProduction(village, owner);
+            const uint64_t villageKey = hashVillage((int)vIdx, village);
+
+            // Accumulate into village stores
+            village.foodStorehouse       += thisTurn.food;
+            village.productionStorehouse += thisTurn.production;
+
+            // Update the village's "per turn" fields for UI display
+            village.foodProduction    = thisTurn.food;
+            village.productionOutput  = thisTurn.production;
+            village.goldOutput        = thisTurn.gold;
+            village.knowledgeOutput   = thisTurn.knowledge;
+            village.worshipOutput     = thisTurn.worship;
+
+            // Accumulate global resources into the clan
+            addToStockpile(owner.gold,      thisTurn.gold,      village.clanIdx, ResourceType::RES_GOLD,      events);
+            addToStockpile(owner.knowledge, thisTurn.knowledge, village.clanIdx, ResourceType::RES_KNOWLEDGE, events);
+            addToStockpile(owner.worship,   thisTurn.worship,   village.clanIdx, ResourceType::RES_WORSHIP,   events);
+
+            state.worldHash ^= villageKey ^ hashVillage((int)vIdx, village);
+            state.markChanged(ChangeKind::VILLAGE, (int)vIdx);
+        }
+    }
+
     {
-        Village& village = villages[vIdx];
-        if (village.clanIdx < 0 || village.clanIdx >= (int)clans.size()) continue;
-
-        Clan& owner = clans[village.clanIdx];
-        VillageProduction thisTurn = calculateVillageProduction(village, owner);
-
-        // Accumulate into village stores
-        village.foodStorehouse       += thisTurn.food;
-        village.productionStorehouse += thisTurn.production;
-
-        // Update the village's "per turn" fields for UI display
-        village.foodProduction    = thisTurn.food;
-        village.productionOutput  = thisTurn.production;
-        village.goldOutput        = thisTurn.gold;
-        village.knowledgeOutput   = thisTurn.knowledge;
-        village.worshipOutput     = thisTurn.worship;
-
-        // Accumulate global resources into the clan
-        owner.gold       += thisTurn.gold;
-        owner.knowledge  += thisTurn.knowledge;
-        owner.worship    += thisTurn.worship;
-
-        // Food growth / population increase
-        int growthThreshold = FOOD_PER_POP_GROWTH * village.population;
-        while (village.foodStorehouse >= growthThreshold && village.population < MAX_VILLAGE_POPULATION)
+        ScopedPhaseTimer timer(profiler, TurnPhase::GROWTH);
+        for (size_t vIdx = 0; vIdx < villages.size(); ++vIdx)
         {
-            village.foodStorehouse -= growthThreshold;
-            village.population++;
-            // Note: workers vector stays size 12 for now (or we can resize if desired)
+            Village& village = villages[vIdx];
+            if (village.clanIdx < 0 || village.clanIdx >= (int)clans.size()) continue;
+
+            // Food growth / population increase
+            int growthThreshold = FOOD_PER_POP_GROWTH * village.population;
+            if (village.foodStorehouse < growthThreshold || village.population >= MAX_VILLAGE_POPULATION) continue;
+
+            const uint64_t villageKey = hashVillage((int)vIdx, village);
+            while (village.foodStorehouse >= growthThreshold && village.population < MAX_VILLAGE_POPULATION)
+            {
+                village.foodStorehouse -= growthThreshold;
+                village.population++;
+                if (events)
+                    events->push(TurnEventType::POPULATION_GREW, village.clanIdx, (int)vIdx, village.population);
+            }
+
+            state.worldHash ^= villageKey ^ hashVillage((int)vIdx, village);
+            state.markChanged(ChangeKind::VILLAGE, (int)vIdx);
         }
     }
-}
\ No newline at end of file
+
+    for (size_t cIdx = 0; cIdx < clans.size(); ++cIdx)
+        state.worldHash ^= hashClan((int)cIdx, clans[cIdx]);
+
+    {
+        // After production, so this turn's production and gold can pay for the queues
+        ScopedPhaseTimer timer(profiler, TurnPhase::CONSTRUCTION);
+        processBuildQueues(state, events);
+    }
+
+    if (events)
+        events->push(TurnEventType::TURN_ENDED, -1, -1, 0);
+}
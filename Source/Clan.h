@@ -3,31 +3,38 @@
 
 #include "Game.h"
 #include "Map.h" // Added for SquareTile
+#include "Production.h"
+#include "TechTree.h"
+#include "TurnEvents.h"
+#include "TurnProfiler.h"
+#include <cstdint>
 #include <vector>
 #include <string>
 
+struct GameState;
+
+// Clan, Village and Building are plain data (no strings or vectors) so that a
+// GameState can be copied with a handful of bulk copies.  See GameState.h.
+
 // Clan struct
 struct Clan
 {
-   std::string name;
+   char name[MAX_NAME_LENGTH];
    Color color;
    int gold = 0;
    int knowledge = 0;
    int worship = 0;
-   std::vector<int> villages;
+   TechSet researched;     // See TechTree.h
+   uint32_t traits = 0;    // ClanTrait bits, see Production.h
+   ProductionTable production; // Compiled from the traits and techs by compileProduction
+   int firstVillage = -1;  // Head of this clan's village list, linked through Village::nextInClan
+   int villageCount = 0;
    Rectangle villageTile;
 };
 
-// Building types
-enum class BuildingType
-{
-   FARM, LOGGING_CAMP, MINE, WORSHIP_SITE, LIBRARY
-};
-
 // Building struct
 struct Building
 {
-   std::string name;
    BuildingType type;
    int productionCost;
    int upkeepCost;
@@ -44,8 +51,12 @@ struct Building
 struct Village
 {
    int x, y;
-   std::string name;
+   char name[MAX_NAME_LENGTH];
    int clanIdx;
+   int nextInClan = -1;         // Next village owned by the same clan (-1 at the end), or the free list when razed
+   int prevInClan = -1;
+   unsigned int generation = 0; // Bumped each time the slot is freed, invalidating old handles
+   bool alive = false;
    int population = 4;          // Starts at 4, max 12
    int foodStorehouse = 0;
    int productionStorehouse = 0;
@@ -54,25 +65,58 @@ struct Village
    int goldOutput = 1;          // Base 1 gold/turn
    int knowledgeOutput = 0;
    int worshipOutput = 0;
-   std::vector<Building> buildings;
-   std::vector<bool> workers;   // True if villager is assigned to a building
+   Building buildings[MAX_VILLAGE_BUILDINGS];
+   int buildingCount = 0;
+   uint16_t workers = 0;        // Bit i set if villager i is assigned to a building
+   int queueHead = -1;          // First QueueItem in this village's build queue (-1 if empty), see BuildQueues.h
+   int queueTail = -1;
+   int queueLength = 0;
+};
+
+// What a build queue entry makes
+enum class QueueItemKind : uint8_t
+{
+   BUILDING, UNIT
+};
+
+// One build queue entry.  Entries for every village share GameState::queueItems and
+// are chained through next, so a village's queue costs nothing until it is used.
+struct QueueItem
+{
+   QueueItemKind kind = QueueItemKind::BUILDING;
+   uint8_t type = 0;            // A BuildingType or UnitType
+   bool alive = false;
+   int villageIdx = -1;
+   int next = -1;               // Next entry in the village's queue, or the free list when unused
 };
 
-// Unit struct
+// Unit struct.  Units live in GameState's unit pool (see Units.h) and are referred
+// to by UnitHandle; the list links below are pool slot indices.
 struct Unit
 {
-   std::string name;
+   UnitType type;
    int clanIdx;
    int x, y;
    int attackStrength = 1;
    int defenseStrength = 1;
    int movementPoints = 2;
-   std::vector<SpecialAbility> specialAbilities;
+   unsigned int abilities = 0;  // SpecialAbility bits, see abilityBit()
+   unsigned int generation = 0; // Bumped each time the slot is freed, invalidating old handles
+   bool alive = false;
+   int nextOnTile = -1;         // Occupancy list for the unit's tile, or the free list when dead
+   int prevOnTile = -1;
+
+   bool hasAbility(SpecialAbility ability) const { return (abilities & abilityBit(ability)) != 0; }
 };
 
 // Functions
-bool canBuild(const Village& village, const std::vector<SquareTile>& map, BuildingType type, int& tileX, int& tileY);
-void buildBuilding(Village& village, BuildingType type, int tileX, int tileY);
+const char* buildingName(BuildingType type);
+void setName(char (&dest)[MAX_NAME_LENGTH], const char* name);
+void setName(char (&dest)[MAX_NAME_LENGTH], const std::string& name);
+int buildingCost(BuildingType type); // Production points
+bool canBuild(const GameState& state, const Village& village, BuildingType type, int& tileX, int& tileY);
+// False, changing nothing, if the village has no free worker or building slot; call canBuild first
+bool buildBuilding(Village& village, BuildingType type, int tileX, int tileY);
 
 // Turn processing
 struct VillageProduction
@@ -84,7 +128,9 @@ struct VillageProduction
     int worship = 0;
 };
 
+// What the village yields this turn under its owner's compiled ProductionTable
 VillageProduction calculateVillageProduction(const Village& village, const Clan& owner);
-void processEndOfTurn(std::vector<Clan>& clans, std::vector<Village>& villages);
+// Keeps state.worldHash up to date incrementally (see StateHash.h)
+void processEndOfTurn(GameState& state, TurnEventLog* events = nullptr, TurnProfiler* profiler = nullptr);
 
 #endif
\ No newline at end of file
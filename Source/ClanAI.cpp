@@ -0,0 +1,708 @@
+#include "ClanAI.h"
+#include "BattleOdds.h"
+#include "Clan.h"
+#include "Combat.h"
+#include "Fog.h"
+#include "GameState.h"
+#include "Replay.h"
+#include "Territory.h"
+#include "Units.h"
+#include "Villages.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cstdlib>
+
+const float AI_EXPLORE_BONUS = 1.0f;  // Value of a tile the clan has never seen
+const float AI_DISTANCE_COST = 0.25f; // Per tile of travel to a target
+const float AI_THREAT_THRESHOLD = 1.0f; // Blurred enemy strength that counts as a threat
+const float AI_MIN_ATTACK_ODDS = 0.6f;  // Chance of winning below which a stack is left alone
+const float AI_RALLY_SCORE = 0.0f;      // Soldiers whose best target scores below this answer a rally
+
+// Building preference before accounting for what the village already has
+static float buildingPreference(BuildingType type)
+{
+   switch (type)
+   {
+   case BuildingType::FARM:         return 3.0f; // Growth unlocks further buildings
+   case BuildingType::MINE:         return 2.5f; // Gold pays for units
+   case BuildingType::LOGGING_CAMP: return 2.0f;
+   case BuildingType::LIBRARY:      return 1.5f;
+   case BuildingType::WORSHIP_SITE: return 1.0f;
+   }
+   return 0.0f;
+}
+
+// Whether work that took ms the last time it ran would still finish before deadline
+static bool fitsBefore(std::chrono::steady_clock::time_point deadline, double ms)
+{
+   return deadline - std::chrono::steady_clock::now() > std::chrono::duration<double, std::milli>(ms);
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+   return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool pushCommand(ClanPlan& plan, const Command& command)
+{
+   if (plan.count >= MAX_AI_COMMANDS) return false;
+   plan.commands[plan.count++] = command;
+   return true;
+}
+
+// The passable neighbour that closes the most distance to the goal
+static bool greedyStep(const GameState& state, const MovementCostGrid& grid, const PathRequest& request, Command& command)
+{
+   bool stepped = false;
+   int bestDistance = std::max(std::abs(request.goalX - request.startX), std::abs(request.goalY - request.startY));
+   for (int n = 0; n < 8; ++n)
+   {
+      const int nx = request.startX + NEIGHBOR_DX[n];
+      const int ny = request.startY + NEIGHBOR_DY[n];
+      if (!state.inBounds(nx, ny) || grid.cost(request.movement, state.tileIndex(nx, ny)) == 0) continue;
+
+      const int distance = std::max(std::abs(request.goalX - nx), std::abs(request.goalY - ny));
+      if (distance < bestDistance)
+      {
+         bestDistance = distance;
+         command.x = nx;
+         command.y = ny;
+         stepped = true;
+      }
+   }
+   return stepped;
+}
+
+void ClanAI::resize(const GameState& state, int workers)
+{
+   const int clanCount = static_cast<int>(state.clans.size());
+   const size_t tiles = static_cast<size_t>(state.width) * state.height;
+
+   const MovementCostGrid& grid = m_paths.grid();
+   if (state.terrainStamp != m_pathsStamp || grid.width() != state.width || grid.height() != state.height)
+   {
+      m_paths.init(state, workers);
+      m_pathsStamp = state.terrainStamp;
+      m_useFlowFields = state.width * state.height < AI_LARGE_MAP_TILES;
+      m_useClusters = !m_useFlowFields;
+      if (m_useFlowFields)
+         m_flowFields.init(state.width, state.height);
+      if (m_useClusters)
+      {
+         m_clusters.build(m_paths.grid());
+         m_longPaths.resize(m_clusters, state.width, state.height);
+         m_waypoints.resize(AI_MAX_WAYPOINTS);
+         m_legSteps.resize(m_clusters.clusterSize() * m_clusters.clusterSize());
+      }
+   }
+
+   if ((int)m_scratch.size() != workers || m_influence.width() != state.width || m_influence.height() != state.height)
+   {
+      m_influence.resize(state.width, state.height, clanCount, workers);
+      m_scratch.clear();
+      m_scratch.resize(workers);
+      for (Scratch& scratch : m_scratch)
+         scratch.claimStamp.assign(tiles, 0);
+      m_influenceBuild = 0;
+   }
+
+   if ((int)m_plans.size() != clanCount)
+   {
+      m_plans.resize(clanCount);
+      m_targets.resize(clanCount);
+      m_moves.resize(clanCount);
+      m_campaign.assign(clanCount, -1);
+      m_firstClan = 0;
+      m_influenceBuild = 0;
+   }
+   if (m_influenceBuild == 0)
+      m_clanInfluenceBuild.assign(clanCount, 0);
+}
+
+void ClanAI::syncVillages(const GameState& state)
+{
+   const int slots = static_cast<int>(state.villages.size());
+   if ((int)m_knownVillages.size() < slots)
+      m_knownVillages.resize(slots);
+
+   for (int v = 0; v < (int)m_knownVillages.size(); ++v)
+   {
+      KnownVillage now;
+      if (v < slots && state.villages[v].alive)
+      {
+         const Village& village = state.villages[v];
+         now.tile = state.tileIndex(village.x, village.y);
+         now.clanIdx = village.clanIdx;
+         now.generation = village.generation;
+      }
+
+      KnownVillage& known = m_knownVillages[v];
+      if (known.tile == now.tile && known.clanIdx == now.clanIdx && known.generation == now.generation) continue;
+      if (m_useFlowFields)
+      {
+         if (known.tile >= 0) m_flowFields.release(known.tile);
+         if (now.tile >= 0) m_flowFields.release(now.tile);
+      }
+      // A razed village stops being a landmark; a captured one stays one for its new enemies
+      if (m_useClusters && known.tile >= 0 && known.tile != now.tile)
+         m_clusters.removeLandmark(known.tile);
+      known = now;
+   }
+}
+
+void ClanAI::playTurn(GameState& state, double budgetMs, int humanClan, WorkerPool* pool, ReplayRecorder* recorder)
+{
+   const Clock::time_point start = Clock::now();
+   const Clock::time_point deadline = budgetMs < 0.0 ? Clock::time_point::max()
+      : start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(budgetMs));
+   // Planning stops early enough to leave time for applying: the last turn's apply
+   // time, but never less than a fixed share of the budget
+   const double applyReserveMs = std::max(m_applyMs, budgetMs * AI_APPLY_RESERVE);
+   const Clock::time_point planDeadline = budgetMs < 0.0 ? deadline
+      : deadline - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(applyReserveMs));
+
+   const int clanCount = static_cast<int>(state.clans.size());
+   if (clanCount == 0) return;
+   const int workers = pool ? pool->workerCount() : 1;
+   resize(state, workers);
+   m_stats = ClanAIStats();
+   syncVillages(state);
+
+   // The shared layers are the one full-map cost every clan waits on.  A new build
+   // waits until every clan has caught up with the last one, so under a tight budget
+   // the time goes to the clans' own layers instead of rebuilding what they never read.
+   ++m_influenceAge;
+   bool caughtUp = true;
+   for (int c = 0; c < clanCount && caughtUp; ++c)
+      caughtUp = c == humanClan || m_clanInfluenceBuild[c] == m_influenceBuild;
+   if (m_influenceBuild == 0 || m_influenceAge >= AI_MAX_INFLUENCE_AGE || (caughtUp && fitsBefore(deadline, m_sharedInfluenceMs)))
+   {
+      const Clock::time_point before = Clock::now();
+      m_influence.updateShared(state, pool);
+      m_sharedInfluenceMs = millisecondsSince(before);
+      ++m_influenceBuild;
+      m_influenceAge = 0;
+   }
+
+   // Sort the live units by clan once, so each job only walks its own
+   for (auto& targets : m_targets)
+      targets.clear();
+   for (int slot = 0; slot < state.unitSlotsUsed; ++slot)
+   {
+      const Unit& unit = state.units[slot];
+      if (unit.alive && unit.clanIdx >= 0 && unit.clanIdx < clanCount)
+         m_targets[unit.clanIdx].push_back({ slot, unit.x, unit.y, -FLT_MAX, false });
+   }
+
+   // Every clan's economy comes first, so no clan's unit search can eat the time
+   // another needs for its research, build and train orders.  A clan whose job starts
+   // after the deadline is left for the next turn.
+   const int firstClan = m_firstClan;
+   auto economyJob = [&](int item, int)
+   {
+      const int clanIdx = (firstClan + item) % clanCount;
+      ClanPlan& plan = m_plans[clanIdx];
+      plan.clanIdx = clanIdx;
+      plan.count = 0;
+      plan.searchRadius = 0;
+      plan.complete = true;
+      plan.planned = false;
+      m_moves[clanIdx].clear();
+      m_campaign[clanIdx] = -1;
+      if (clanIdx == humanClan || Clock::now() >= planDeadline) return;
+      planEconomy(state, clanIdx, plan);
+      plan.planned = true;
+   };
+
+   // Then the unit searches, in the same order, for the clans that got their economy
+   auto searchJob = [&](int item, int worker)
+   {
+      const int clanIdx = (firstClan + item) % clanCount;
+      ClanPlan& plan = m_plans[clanIdx];
+      if (!plan.planned) return;
+
+      // A worker that has not built a clan's layers yet expects them to cost what the shared ones did
+      Scratch& scratch = m_scratch[worker];
+      const double layersMs = scratch.clanInfluenceMs > 0.0 ? scratch.clanInfluenceMs : m_sharedInfluenceMs;
+      if (m_clanInfluenceBuild[clanIdx] != m_influenceBuild && fitsBefore(planDeadline, layersMs))
+      {
+         const Clock::time_point before = Clock::now();
+         m_influence.updateClan(clanIdx, worker);
+         scratch.clanInfluenceMs = millisecondsSince(before);
+         m_clanInfluenceBuild[clanIdx] = m_influenceBuild;
+      }
+      planClan(state, clanIdx, planDeadline, scratch, plan);
+   };
+
+   auto forEachClan = [&](auto&& job)
+   {
+      if (pool)
+         pool->parallelFor(clanCount, job);
+      else
+         for (int i = 0; i < clanCount; ++i)
+            job(i, 0);
+   };
+   forEachClan(economyJob);
+   forEachClan(searchJob);
+
+   // Campaign targets become landmarks, so the marches on them skip attaching the goal
+   if (m_useClusters)
+      for (int c = 0; c < clanCount; ++c)
+         if (m_campaign[c] >= 0) m_clusters.addLandmark(m_paths.grid(), m_campaign[c]);
+   solveMoves(state, firstClan, planDeadline, pool);
+
+   const Clock::time_point planned = Clock::now();
+   m_stats.planMs = std::chrono::duration<double, std::milli>(planned - start).count();
+
+   // Applying is serial and in planning order, so the outcome does not depend on which
+   // worker finished first.  Earlier clans can invalidate later clans' commands
+   // (a site gets taken); those are simply rejected.  Plans still waiting at the
+   // deadline are dropped.  The first clan left out, whether at planning or here, goes
+   // first next turn; if none was, the first clan rotates by one.
+   int nextFirstClan = -1;
+   for (int item = 0; item < clanCount; ++item)
+   {
+      const int c = (firstClan + item) % clanCount;
+      const ClanPlan& plan = m_plans[c];
+      if (c == humanClan) continue;
+      if (!plan.planned || Clock::now() >= deadline)
+      {
+         ++m_stats.clansDeferred;
+         if (nextFirstClan < 0) nextFirstClan = c;
+         continue;
+      }
+      if (plan.complete) ++m_stats.plansComplete;
+      else ++m_stats.plansCut;
+      if (m_clanInfluenceBuild[c] != m_influenceBuild || m_influenceAge > 0) ++m_stats.influenceReused;
+
+      for (int i = 0; i < plan.count; ++i)
+      {
+         const bool applied = recorder ? recorder->apply(state, plan.commands[i]) : applyCommand(state, plan.commands[i]);
+         if (applied) ++m_stats.commandsApplied;
+         else ++m_stats.commandsRejected;
+      }
+   }
+   m_stats.applyMs = std::chrono::duration<double, std::milli>(Clock::now() - planned).count();
+   m_applyMs = m_stats.applyMs;
+   m_firstClan = nextFirstClan >= 0 ? nextFirstClan : (firstClan + 1) % clanCount;
+}
+
+void ClanAI::planClan(const GameState& state, int clanIdx, Clock::time_point deadline, Scratch& scratch, ClanPlan& plan)
+{
+   // The economy is already planned.  A clan whose search would start after the
+   // deadline, or with no layers of its own yet, stops there.
+   if (Clock::now() >= deadline || !m_influence.hasClanLayers(clanIdx))
+   {
+      plan.complete = false;
+      return;
+   }
+
+   // Then widen the unit search while time remains.  Each pass only replaces a target
+   // with a better one, so stopping anywhere leaves a usable plan.
+   int radius = 2;
+   for (int pass = 0; pass < AI_SEARCH_RADIUS_STEPS; ++pass, radius *= 2)
+   {
+      if (!searchTargets(state, clanIdx, radius, deadline, scratch)) break;
+      plan.searchRadius = radius;
+   }
+   plan.complete = plan.searchRadius == (2 << (AI_SEARCH_RADIUS_STEPS - 1)) || m_targets[clanIdx].empty();
+
+   planRally(state, clanIdx);
+   planMoves(state, clanIdx, plan);
+}
+
+void ClanAI::planEconomy(const GameState& state, int clanIdx, ClanPlan& plan)
+{
+   const Clan& clan = state.clans[clanIdx];
+   int gold = clan.gold;
+
+   // Knowledge and worship only buy techs: take the cheapest one the clan can afford
+   const int research = sharedTechTree().cheapestAffordable(clan.researched, clan.knowledge, clan.worship);
+   if (research >= 0)
+   {
+      Command command;
+      command.type = CommandType::RESEARCH;
+      command.detail = static_cast<uint8_t>(research);
+      command.clanIdx = clanIdx;
+      if (!pushCommand(plan, command)) return;
+   }
+
+   int military = 0;
+   int settlers = 0;
+   for (const UnitTarget& target : m_targets[clanIdx])
+   {
+      if (state.units[target.slot].hasAbility(SpecialAbility::BUILD_VILLAGE)) ++settlers;
+      else ++military;
+   }
+
+   for (int v = clan.firstVillage; v >= 0; v = state.villages[v].nextInClan)
+   {
+      const Village& village = state.villages[v];
+      if (village.queueLength > 0) continue; // Still waiting on earlier orders
+
+      // Prefer the most useful building the village has fewest of
+      int counts[BUILDING_TYPE_COUNT] = {};
+      for (int b = 0; b < village.buildingCount; ++b)
+         ++counts[static_cast<int>(village.buildings[b].type)];
+
+      int bestType = -1;
+      float bestScore = -FLT_MAX;
+      for (int t = 0; t < BUILDING_TYPE_COUNT; ++t)
+      {
+         const BuildingType type = static_cast<BuildingType>(t);
+         const float score = buildingPreference(type) - static_cast<float>(counts[t]);
+         int tileX, tileY;
+         if (score > bestScore && canBuild(state, village, type, tileX, tileY))
+         {
+            bestType = t;
+            bestScore = score;
+         }
+      }
+      if (bestType >= 0)
+      {
+         Command build;
+         build.type = CommandType::BUILD;
+         build.detail = static_cast<uint8_t>(bestType);
+         build.clanIdx = clanIdx;
+         build.village = villageHandle(state, v);
+         if (!pushCommand(plan, build)) return;
+      }
+
+      // Then at most one unit per village: soldiers while the army is short (twice the
+      // usual size if the village is threatened), otherwise a settler while there are
+      // few in the field
+      const float threat = m_influence.hasClanLayers(clanIdx) ? m_influence.sample(InfluenceLayer::THREAT, clanIdx, village.x, village.y) : 0.0f;
+      const bool threatened = threat >= AI_THREAT_THRESHOLD;
+      const int armyTarget = clan.villageCount * AI_MILITARY_PER_VILLAGE * (threatened ? 2 : 1);
+      UnitType train = UnitType::SETTLER;
+      bool wantUnit = false;
+      if (military < armyTarget)
+      {
+         train = threatened && gold >= unitTypeInfo(UnitType::SWORDSMAN).goldCost ? UnitType::SWORDSMAN : UnitType::SPEARMAN;
+         wantUnit = true;
+      }
+      else if (settlers < AI_MAX_SETTLERS)
+      {
+         wantUnit = true;
+      }
+
+      const int cost = unitTypeInfo(train).goldCost;
+      if (wantUnit && gold >= cost)
+      {
+         Command command;
+         command.type = CommandType::TRAIN;
+         command.detail = static_cast<uint8_t>(train);
+         command.clanIdx = clanIdx;
+         command.village = villageHandle(state, v);
+         if (!pushCommand(plan, command)) return;
+
+         gold -= cost;
+         if (train == UnitType::SETTLER) ++settlers;
+         else ++military;
+      }
+   }
+}
+
+void ClanAI::planRally(const GameState& state, int clanIdx)
+{
+   // The rally point is the clan's most threatened village, if any is threatened at all.
+   // Failing that, on large maps, the clan campaigns against the enemy village it has
+   // seen nearest its first village.
+   const Clan& clan = state.clans[clanIdx];
+   const Village* rally = nullptr;
+   float worst = AI_THREAT_THRESHOLD;
+   for (int v = clan.firstVillage; v >= 0; v = state.villages[v].nextInClan)
+   {
+      const Village& village = state.villages[v];
+      const float threat = m_influence.sample(InfluenceLayer::THREAT, clanIdx, village.x, village.y);
+      if (threat >= worst)
+      {
+         worst = threat;
+         rally = &village;
+      }
+   }
+   if (!rally && m_useClusters && clan.firstVillage >= 0)
+   {
+      const Village& home = state.villages[clan.firstVillage];
+      int nearest = INT_MAX;
+      for (const Village& village : state.villages)
+      {
+         if (!village.alive || village.clanIdx == clanIdx || !isTileExplored(state, clanIdx, village.x, village.y)) continue;
+         const int distance = std::max(std::abs(village.x - home.x), std::abs(village.y - home.y));
+         if (distance < nearest)
+         {
+            nearest = distance;
+            rally = &village;
+         }
+      }
+      if (rally) m_campaign[clanIdx] = state.tileIndex(rally->x, rally->y);
+   }
+   if (!rally) return;
+
+   for (UnitTarget& target : m_targets[clanIdx])
+   {
+      if (target.score >= AI_RALLY_SCORE || state.units[target.slot].hasAbility(SpecialAbility::BUILD_VILLAGE)) continue;
+      target.x = rally->x;
+      target.y = rally->y;
+      target.rally = true;
+   }
+}
+
+float ClanAI::scoreTarget(const GameState& state, const Unit& unit, int x, int y, int distance, Clock::time_point deadline, bool& cut) const
+{
+   const int idx = state.tileIndex(x, y);
+   const float threat = m_influence.sample(InfluenceLayer::THREAT, unit.clanIdx, x, y);
+   const float travel = AI_DISTANCE_COST * static_cast<float>(distance);
+
+   // Settlers look for a good, safe site they already know about
+   if (unit.hasAbility(SpecialAbility::BUILD_VILLAGE))
+   {
+      if (!isTileExplored(state, unit.clanIdx, x, y) || !canFoundVillage(state, x, y)) return -FLT_MAX;
+      const float resources = m_influence.sample(InfluenceLayer::RESOURCES, unit.clanIdx, x, y);
+      const float home = territoryClan(state, idx) == unit.clanIdx ? 1.0f : 0.0f;
+      return resources + home - 2.0f * threat - travel;
+   }
+
+   // Soldiers go for poorly guarded enemy yields, stand between threats and their own
+   // villages, and otherwise scout
+   const float strength = static_cast<float>(unit.attackStrength + unit.defenseStrength);
+   float score = m_influence.sample(InfluenceLayer::OPPORTUNITY, unit.clanIdx, x, y) - std::max(threat - 2.0f * strength, 0.0f);
+   if (territoryClan(state, idx) == unit.clanIdx)
+   {
+      score += 0.5f * threat;
+      const SquareTile& tile = state.map[idx];
+      if (tile.hasVillage)
+         score += threat;
+   }
+   if (!isTileExplored(state, unit.clanIdx, x, y))
+      score += AI_EXPLORE_BONUS;
+
+   // An occupied tile means a battle: only pick fights the odds table says are won,
+   // and prefer the ones that trade best
+   if (hasEnemyUnits(state, unit.clanIdx, x, y))
+   {
+      // An odds table the cache misses costs about 230 us, so the deadline is checked first
+      if (Clock::now() >= deadline)
+      {
+         cut = true;
+         return -FLT_MAX;
+      }
+      const BattleOdds& odds = threadBattleOdds().get(state, unit.clanIdx, unit.x, unit.y, x, y);
+      if (odds.attackerWins < AI_MIN_ATTACK_ODDS) return -FLT_MAX;
+      score += odds.attackerWins * odds.defenderLosses - odds.attackerLosses;
+   }
+   return score - travel;
+}
+
+bool ClanAI::searchTargets(const GameState& state, int clanIdx, int radius, Clock::time_point deadline, Scratch& scratch)
+{
+   // Targets already taken this pass are skipped so units spread out; a settler's
+   // target blocks the whole area another village could not be founded in
+   ++scratch.stamp;
+   for (UnitTarget& target : m_targets[clanIdx])
+   {
+      if (Clock::now() >= deadline) return false;
+
+      const Unit& unit = state.units[target.slot];
+      const MovementClass movement = movementClassFor(unit.abilities);
+      const bool settler = unit.hasAbility(SpecialAbility::BUILD_VILLAGE);
+      const int minX = std::max(unit.x - radius, 0);
+      const int maxX = std::min(unit.x + radius, state.width - 1);
+      const int minY = std::max(unit.y - radius, 0);
+      const int maxY = std::min(unit.y + radius, state.height - 1);
+
+      for (int y = minY; y <= maxY; ++y)
+      {
+         for (int x = minX; x <= maxX; ++x)
+         {
+            const int idx = state.tileIndex(x, y);
+            if (scratch.claimStamp[idx] == scratch.stamp || m_paths.grid().cost(movement, idx) == 0) continue;
+
+            const int distance = std::max(std::abs(x - unit.x), std::abs(y - unit.y));
+            bool cut = false;
+            const float score = scoreTarget(state, unit, x, y, distance, deadline, cut);
+            if (cut) return false;
+            if (score > target.score)
+            {
+               target.score = score;
+               target.x = x;
+               target.y = y;
+            }
+         }
+      }
+
+      const int claim = settler ? MIN_VILLAGE_SPACING - 1 : 0;
+      for (int y = std::max(target.y - claim, 0); y <= std::min(target.y + claim, state.height - 1); ++y)
+         for (int x = std::max(target.x - claim, 0); x <= std::min(target.x + claim, state.width - 1); ++x)
+            scratch.claimStamp[state.tileIndex(x, y)] = scratch.stamp;
+   }
+   return true;
+}
+
+void ClanAI::planMoves(const GameState& state, int clanIdx, ClanPlan& plan)
+{
+   for (const UnitTarget& target : m_targets[clanIdx])
+   {
+      const Unit& unit = state.units[target.slot];
+      Command command;
+      command.clanIdx = clanIdx;
+      command.unit = unitHandle(state, target.slot);
+
+      if (target.x == unit.x && target.y == unit.y)
+      {
+         if (!unit.hasAbility(SpecialAbility::BUILD_VILLAGE) || !canFoundVillage(state, unit.x, unit.y)) continue;
+         command.type = CommandType::FOUND_VILLAGE;
+         if (!pushCommand(plan, command)) return;
+         continue;
+      }
+
+      // The step is filled in by solveMoves.  The search window keeps an unreachable
+      // target from flooding the whole map.
+      command.type = CommandType::MOVE;
+      if (!pushCommand(plan, command)) return;
+      PendingMove move;
+      move.command = plan.count - 1;
+      move.result = -1;
+      move.request = { unit.x, unit.y, target.x, target.y, movementClassFor(unit.abilities), AI_MAX_PATH_STEPS / 2 };
+      const int distance = std::max(std::abs(target.x - unit.x), std::abs(target.y - unit.y));
+      if (target.rally && m_useFlowFields) move.route = Route::FLOW_FIELD;
+      else if (m_useClusters && distance > move.request.window) move.route = Route::HIERARCHICAL;
+      else move.route = Route::PATH;
+      m_moves[clanIdx].push_back(move);
+   }
+}
+
+void ClanAI::solveMoves(const GameState& state, int firstClan, Clock::time_point deadline, WorkerPool* pool)
+{
+   const int clanCount = static_cast<int>(m_plans.size());
+   m_pathRequests.clear();
+   for (int item = 0; item < clanCount; ++item)
+   {
+      for (PendingMove& move : m_moves[(firstClan + item) % clanCount])
+      {
+         if (move.route != Route::PATH) continue;
+         move.result = static_cast<int>(m_pathRequests.size());
+         m_pathRequests.push_back(move.request);
+      }
+   }
+   const int total = static_cast<int>(m_pathRequests.size());
+   if ((int)m_pathResults.size() < total)
+   {
+      m_pathResults.resize(total);
+      m_pathSteps.resize(static_cast<size_t>(total) * AI_MAX_PATH_STEPS);
+   }
+
+   // Clans planned first get their paths first, as they got their searches first
+   int solved = 0;
+   while (solved < total && Clock::now() < deadline)
+   {
+      const int count = std::min(AI_PATH_BATCH, total - solved);
+      m_paths.solve(&m_pathRequests[solved], count, &m_pathResults[solved],
+         &m_pathSteps[static_cast<size_t>(solved) * AI_MAX_PATH_STEPS], AI_MAX_PATH_STEPS, pool);
+      solved += count;
+   }
+
+   // Fill in each move's step: the first one of its path, the rally point's flow field
+   // or its HPA* plan, or past the deadline (or if the route is long) the neighbouring
+   // step that closes the most distance.  Moves with neither are dropped from the plan.
+   // Long-range moves are planned here, one after another in planning order.
+   for (int item = 0; item < clanCount; ++item)
+   {
+      const int clanIdx = (firstClan + item) % clanCount;
+      ClanPlan& plan = m_plans[clanIdx];
+      const std::vector<PendingMove>& moves = m_moves[clanIdx];
+      size_t next = 0;
+      int kept = 0;
+      for (int i = 0; i < plan.count; ++i)
+      {
+         Command command = plan.commands[i];
+         if (next < moves.size() && moves[next].command == i)
+         {
+            const PendingMove& move = moves[next++];
+            const int r = move.result;
+            bool stepped = false;
+            if (move.route == Route::FLOW_FIELD)
+            {
+               stepped = rallyStep(move, deadline, plan, command);
+            }
+            else if (move.route == Route::HIERARCHICAL)
+            {
+               stepped = longStep(move, deadline, plan, command);
+            }
+            else if (r >= solved)
+            {
+               plan.complete = false;
+            }
+            else if (m_pathResults[r].length > 0)
+            {
+               const PathStep& step = m_pathSteps[static_cast<size_t>(r) * AI_MAX_PATH_STEPS];
+               command.x = step.x;
+               command.y = step.y;
+               stepped = true;
+            }
+            if (!stepped && !greedyStep(state, m_paths.grid(), move.request, command)) continue;
+         }
+         plan.commands[kept++] = command;
+      }
+      plan.count = kept;
+   }
+}
+
+bool ClanAI::rallyStep(const PendingMove& move, Clock::time_point deadline, ClanPlan& plan, Command& command)
+{
+   // Everyone bound for the rally point shares its field; building one is a full-map
+   // search, so past the deadline the unit takes a greedy step instead
+   const PathRequest& request = move.request;
+   const FlowField* field = m_flowFields.find(request.goalX, request.goalY, request.movement);
+   if (!field)
+   {
+      if (!fitsBefore(deadline, m_flowBuildMs))
+      {
+         plan.complete = false;
+         return false;
+      }
+      const Clock::time_point before = Clock::now();
+      field = m_flowFields.get(m_paths.grid(), request.goalX, request.goalY, request.movement);
+      m_flowBuildMs = millisecondsSince(before);
+      ++m_stats.flowFieldBuilds;
+   }
+
+   PathStep step;
+   if (!field || !field->nextStep(m_paths.grid().width(), request.startX, request.startY, step)) return false;
+   command.x = step.x;
+   command.y = step.y;
+   ++m_stats.rallyMoves;
+   return true;
+}
+
+bool ClanAI::longStep(const PendingMove& move, Clock::time_point deadline, ClanPlan& plan, Command& command)
+{
+   // Only the first leg is refined; the unit plans again next turn from where it is
+   if (!fitsBefore(deadline, m_longPathMs))
+   {
+      plan.complete = false;
+      return false;
+   }
+
+   const PathRequest& request = move.request;
+   const MovementCostGrid& grid = m_paths.grid();
+   const Clock::time_point before = Clock::now();
+   int steps = -1;
+   const int waypoints = m_longPaths.planPath(m_clusters, grid, request.movement, request.startX, request.startY,
+      request.goalX, request.goalY, m_waypoints.data(), AI_MAX_WAYPOINTS);
+   if (waypoints > 0)
+   {
+      steps = m_longPaths.refineSegment(m_clusters, grid, request.movement, request.startX, request.startY,
+         m_waypoints[0].x, m_waypoints[0].y, m_legSteps.data(), static_cast<int>(m_legSteps.size()));
+   }
+   m_longPathMs = millisecondsSince(before);
+   m_stats.longPathMsMax = std::max(m_stats.longPathMsMax, m_longPathMs);
+   ++m_stats.longPaths;
+
+   if (steps <= 0) return false;
+   command.x = m_legSteps[0].x;
+   command.y = m_legSteps[0].y;
+   return true;
+}
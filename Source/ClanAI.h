@@ -0,0 +1,184 @@
+#ifndef CLANAI_H
+#define CLANAI_H
+
+#include "Commands.h"
+#include "FlowFields.h"
+#include "HierarchicalPath.h"
+#include "InfluenceMaps.h"
+#include "Pathfinding.h"
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+struct GameState;
+class ReplayRecorder;
+class WorkerPool;
+
+const double DEFAULT_AI_BUDGET_MS = 8.0; // Wall time all AI clans share per turn
+const int MAX_AI_COMMANDS = 256;         // Per clan per turn; units past this wait a turn
+const int AI_SEARCH_RADIUS_STEPS = 3;    // Unit target searches widen through 2, 4, 8 tiles
+const int AI_MAX_PATH_STEPS = 64;        // Longer routes fall back to a greedy step
+const int AI_PATH_BATCH = 64;            // Path requests solved between deadline checks
+const int AI_MILITARY_PER_VILLAGE = 2;   // Standing army a clan aims for
+const int AI_MAX_SETTLERS = 2;           // Settlers a clan keeps in the field at once
+const double AI_APPLY_RESERVE = 0.1;     // Share of the budget planning always leaves for applying
+const int AI_MAX_INFLUENCE_AGE = 4;      // Turns the shared influence maps may be reused to stay in budget
+const int AI_LARGE_MAP_TILES = 512 * 512; // From this size flow fields cost too much, and long routes go through HPA*
+const int AI_MAX_WAYPOINTS = 256;        // Longest HPA* plan a long-range move takes
+
+// What one clan decided to do this turn
+struct ClanPlan
+{
+   int clanIdx = -1;
+   int count = 0;
+   int searchRadius = 0;  // Widest unit search that finished for every unit
+   bool complete = false; // False if the deadline cut the search short
+   bool planned = false;  // False if the clan was left for the next turn
+   Command commands[MAX_AI_COMMANDS];
+};
+
+struct ClanAIStats
+{
+   int plansComplete = 0;
+   int plansCut = 0;        // Plans returned early at the deadline
+   int commandsApplied = 0;
+   int commandsRejected = 0;
+   int influenceReused = 0; // Clans planned on layers from an earlier turn
+   int clansDeferred = 0;   // Clans left out at the deadline; the first of them goes first next turn
+   int rallyMoves = 0;      // Soldiers stepped towards a rally point from a shared flow field
+   int flowFieldBuilds = 0;
+   int longPaths = 0;          // Moves planned across the map through HPA*
+   double longPathMsMax = 0.0; // Worst of them, plan and first leg together
+   double planMs = 0.0;     // Influence maps plus planning, i.e. everything the budget covers
+   double applyMs = 0.0;
+};
+
+// Plans every computer-controlled clan's turn in parallel against the read-only state,
+// then applies the plans one clan after another.  The whole turn, applying included,
+// fits the budget however many clans there are.  Planning is anytime: each clan first
+// settles its cheap decisions (what to research, build and train), then keeps
+// widening the search for its units' targets until the shared deadline, and whatever
+// was found by then is the plan.  Planning stops early by the last turn's apply time.
+// A clan whose job starts after that, or whose plan is still waiting to be applied at
+// the deadline, is left out; the first clan left out goes first next turn, so every
+// clan gets its turn within a few.  Unit moves leave the clan jobs as path requests,
+// which are solved together through a PathService, batch by batch until the deadline;
+// the rest take a greedy step.
+//
+// Soldiers with nothing worth doing nearby gather on their clan's most threatened
+// village.  Everyone bound for one rally point reads their step from the same flow
+// field, keyed by (village tile, movement class), instead of each running A*.  At the
+// start of each turn the village slots are compared with the last turn's, and fields
+// aimed at a village that was founded, captured or razed since are released, as the
+// rally points they served are gone.
+//
+// On large maps soldiers with no rally to answer march on the nearest enemy village
+// their clan has seen, however far it is.  Moves beyond the A* window are planned
+// with HPA* on a ClusterGraph, one at a time until the deadline.  Campaign targets
+// are added to the graph as landmarks, and the comparison of village slots removes a
+// razed village's landmark; either way only that landmark's cluster is searched again.
+//
+// The influence maps are charged to the same budget.  Each full-map step (the shared
+// layers, then each clan's own) only starts if it took less than the time left the
+// last time it ran; otherwise the clan plans on the layers it already has.  The shared
+// layers are rebuilt once every clan has caught up with them, and at least every
+// AI_MAX_INFLUENCE_AGE turns.
+//
+// Because plans depend on how far the search got, two runs only play out the same if
+// every plan completes.  The commands themselves are plain data (see Commands.h).
+class ClanAI
+{
+public:
+   // humanClan is left alone; pass -1 to let the AI play every clan.  Commands carried
+   // out go into recorder when there is one.
+   void playTurn(GameState& state, double budgetMs, int humanClan, WorkerPool* pool = nullptr, ReplayRecorder* recorder = nullptr);
+
+   const ClanAIStats& lastStats() const { return m_stats; }
+   const InfluenceMaps& influence() const { return m_influence; }
+
+private:
+   using Clock = std::chrono::steady_clock;
+
+   // Where a unit is heading and how good that looked
+   struct UnitTarget
+   {
+      int slot;
+      int x, y;
+      float score;
+      bool rally; // Heading for the clan's rally point
+   };
+
+   // Where a PendingMove gets its step
+   enum class Route : uint8_t
+   {
+      PATH, FLOW_FIELD, HIERARCHICAL
+   };
+
+   // A move the plan holds a command for, waiting on its path
+   struct PendingMove
+   {
+      int command; // Index in the clan's plan
+      int result;  // Index in m_pathResults for a PATH move, else -1
+      Route route;
+      PathRequest request;
+   };
+
+   // What a village slot held the last time playTurn looked
+   struct KnownVillage
+   {
+      int tile = -1; // -1 for a free slot
+      int clanIdx = -1;
+      unsigned int generation = 0;
+   };
+
+   // Per-worker scratch, sized with the map
+   struct Scratch
+   {
+      std::vector<uint32_t> claimStamp; // == stamp when a tile is already someone's target
+      uint32_t stamp = 0;
+      double clanInfluenceMs = 0.0; // The last updateClan on this worker
+   };
+
+   void resize(const GameState& state, int workers);
+   void planClan(const GameState& state, int clanIdx, Clock::time_point deadline, Scratch& scratch, ClanPlan& plan);
+   void planEconomy(const GameState& state, int clanIdx, ClanPlan& plan);
+   void planRally(const GameState& state, int clanIdx);
+   void syncVillages(const GameState& state);
+   bool rallyStep(const PendingMove& move, Clock::time_point deadline, ClanPlan& plan, Command& command);
+   bool longStep(const PendingMove& move, Clock::time_point deadline, ClanPlan& plan, Command& command);
+   bool searchTargets(const GameState& state, int clanIdx, int radius, Clock::time_point deadline, Scratch& scratch);
+   void planMoves(const GameState& state, int clanIdx, ClanPlan& plan);
+   void solveMoves(const GameState& state, int firstClan, Clock::time_point deadline, WorkerPool* pool);
+   float scoreTarget(const GameState& state, const Unit& unit, int x, int y, int distance, Clock::time_point deadline, bool& cut) const;
+
+   InfluenceMaps m_influence;
+   PathService m_paths;
+   uint32_t m_pathsStamp = 0;
+   FlowFieldCache m_flowFields;                 // Only on maps under AI_LARGE_MAP_TILES
+   bool m_useFlowFields = false;
+   double m_flowBuildMs = 0.0;                  // The last field build
+   ClusterGraph m_clusters;                     // Only on maps of AI_LARGE_MAP_TILES and up
+   HierarchicalPathfinder m_longPaths;
+   bool m_useClusters = false;
+   double m_longPathMs = 0.0;                   // The last long-range move
+   std::vector<PathStep> m_waypoints;           // AI_MAX_WAYPOINTS
+   std::vector<PathStep> m_legSteps;            // The first leg of a long-range move
+   std::vector<KnownVillage> m_knownVillages;   // Per village slot
+   uint32_t m_influenceBuild = 0;               // Counts updateShared calls; 0 until the first
+   std::vector<uint32_t> m_clanInfluenceBuild;  // Per clan, the build its layers were made from
+   int m_influenceAge = 0;                      // Turns since the last updateShared
+   double m_sharedInfluenceMs = 0.0;
+   std::vector<Scratch> m_scratch;
+   std::vector<ClanPlan> m_plans;
+   std::vector<std::vector<UnitTarget>> m_targets; // Per clan, one entry per live unit
+   std::vector<std::vector<PendingMove>> m_moves;  // Per clan
+   std::vector<int> m_campaign;                    // Per clan, the enemy village tile it marches on, or -1
+   std::vector<PathRequest> m_pathRequests;        // Every clan's moves, in planning order
+   std::vector<PathResult> m_pathResults;
+   std::vector<PathStep> m_pathSteps;              // AI_MAX_PATH_STEPS per request
+   int m_firstClan = 0;
+   double m_applyMs = 0.0; // The last turn's apply, held back from planning
+   ClanAIStats m_stats;
+};
+
+#endif
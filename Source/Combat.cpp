@@ -0,0 +1,246 @@
+#include "Combat.h"
+#include "GameState.h"
+#include "Units.h"
+#include <algorithm>
+#include <cstdlib>
+
+int combatDefenseBonus(Terrain terrain)
+{
+   switch (terrain)
+   {
+   case Terrain::FOREST:   return 1;
+   case Terrain::HILLS:    return 1;
+   case Terrain::MOUNTAIN: return 2;
+   case Terrain::SWAMP:    return -1;
+   default:                return 0;
+   }
+}
+
+static int chebyshev(int dx, int dy)
+{
+   return std::max(std::abs(dx), std::abs(dy));
+}
+
+static int sign(int v)
+{
+   return (v > 0) - (v < 0);
+}
+
+void Battle::reset(Terrain terrain, uint64_t seed)
+{
+   m_terrain = terrain;
+   m_rng = seed * 0x9e3779b97f4a7c15ULL | 1;
+   m_round = 0;
+   m_count = 0;
+   m_sideCount[0] = m_sideCount[1] = 0;
+   m_alive[0] = m_alive[1] = 0;
+   std::fill(m_occupant, m_occupant + COMBAT_GRID_WIDTH * COMBAT_GRID_HEIGHT, static_cast<int8_t>(-1));
+}
+
+int Battle::add(int side, UnitType type, int attack, int defense, int movement, unsigned int abilities, int sourceSlot)
+{
+   if (m_sideCount[side] >= MAX_COMBATANTS_PER_SIDE) return -1;
+
+   // Fill the deployment columns from the front line back
+   const int k = m_sideCount[side]++;
+   const int column = k / COMBAT_GRID_HEIGHT;
+   const int i = m_count++;
+   m_side[i] = static_cast<int8_t>(side);
+   m_x[i] = static_cast<int8_t>(side == COMBAT_ATTACKER ? COMBAT_DEPLOY_COLUMNS - 1 - column : COMBAT_GRID_WIDTH - COMBAT_DEPLOY_COLUMNS + column);
+   m_y[i] = static_cast<int8_t>(k % COMBAT_GRID_HEIGHT);
+   m_type[i] = static_cast<uint8_t>(type);
+   m_movement[i] = static_cast<uint8_t>(movement);
+   m_range[i] = static_cast<uint8_t>(unitTypeInfo(type).attackRange);
+   m_attack[i] = static_cast<int16_t>(attack);
+   m_defense[i] = static_cast<int16_t>(defense);
+   m_hp[i] = static_cast<int16_t>(COMBAT_BASE_HP + 2 * defense);
+   m_damage[i] = 0;
+   m_target[i] = -1;
+   m_abilities[i] = abilities;
+   m_source[i] = sourceSlot;
+   m_occupant[cell(m_x[i], m_y[i])] = static_cast<int8_t>(i);
+   ++m_alive[side];
+   return i;
+}
+
+uint32_t Battle::roll()
+{
+   m_rng ^= m_rng >> 12;
+   m_rng ^= m_rng << 25;
+   m_rng ^= m_rng >> 27;
+   return static_cast<uint32_t>((m_rng * 0x2545f4914f6cdd1dULL) >> 32);
+}
+
+void Battle::buffPhase()
+{
+   int buffers[2] = {};
+   for (int i = 0; i < m_count; ++i)
+      buffers[m_side[i]] += (m_hp[i] > 0 && (m_abilities[i] & abilityBit(SpecialAbility::BUFF_STACK))) ? 1 : 0;
+   m_buff[0] = std::min(buffers[0], COMBAT_MAX_STACK_BUFF);
+   m_buff[1] = std::min(buffers[1], COMBAT_MAX_STACK_BUFF);
+}
+
+void Battle::targetPhase()
+{
+   for (int i = 0; i < m_count; ++i)
+   {
+      int best = -1;
+      int bestDistance = COMBAT_GRID_WIDTH + COMBAT_GRID_HEIGHT;
+      if (m_hp[i] > 0)
+      {
+         for (int j = 0; j < m_count; ++j)
+         {
+            if (m_side[j] == m_side[i] || m_hp[j] <= 0) continue;
+            const int distance = chebyshev(m_x[j] - m_x[i], m_y[j] - m_y[i]);
+            if (distance < bestDistance)
+            {
+               best = j;
+               bestDistance = distance;
+            }
+         }
+      }
+      m_target[i] = static_cast<int16_t>(best);
+   }
+}
+
+void Battle::movePhase()
+{
+   // Everyone advances one cell per pass, alternating the order, so neither side's
+   // front arrives piecemeal against the other's whole line.  Serial within a pass:
+   // each move changes which cells are free for the next.
+   int maxMovement = 0;
+   for (int i = 0; i < m_count; ++i)
+      maxMovement = std::max(maxMovement, static_cast<int>(m_movement[i]));
+
+   for (int pass = 0; pass < maxMovement; ++pass)
+   {
+      for (int k = 0; k < m_count; ++k)
+      {
+         const int i = (pass & 1) ? m_count - 1 - k : k;
+         const int target = m_target[i];
+         if (target < 0 || m_movement[i] <= pass) continue;
+         if (chebyshev(m_x[target] - m_x[i], m_y[target] - m_y[i]) <= m_range[i]) continue;
+
+         // Straight at the target, or slide along one axis if that cell is taken
+         const int dx = sign(m_x[target] - m_x[i]);
+         const int dy = sign(m_y[target] - m_y[i]);
+         const int tries[3][2] = { { dx, dy }, { dx, 0 }, { 0, dy } };
+         for (const auto& delta : tries)
+         {
+            if (delta[0] == 0 && delta[1] == 0) continue;
+            const int nx = m_x[i] + delta[0];
+            const int ny = m_y[i] + delta[1];
+            if (m_occupant[cell(nx, ny)] >= 0) continue;
+
+            m_occupant[cell(m_x[i], m_y[i])] = -1;
+            m_x[i] = static_cast<int8_t>(nx);
+            m_y[i] = static_cast<int8_t>(ny);
+            m_occupant[cell(nx, ny)] = static_cast<int8_t>(i);
+            break;
+         }
+      }
+   }
+}
+
+void Battle::attackPhase()
+{
+   const int terrainBonus = combatDefenseBonus(m_terrain);
+   for (int i = 0; i < m_count; ++i)
+   {
+      const int target = m_target[i];
+      if (target < 0 || m_attack[i] == 0) continue;
+
+      const int distance = chebyshev(m_x[target] - m_x[i], m_y[target] - m_y[i]);
+      if (distance > m_range[i]) continue;
+
+      const int defense = m_defense[target] + (m_side[target] == COMBAT_DEFENDER ? terrainBonus : 0);
+      const int damage = m_attack[i] + m_buff[m_side[i]] + static_cast<int>(roll() % 3) - defense;
+      m_damage[target] = static_cast<int16_t>(m_damage[target] + std::max(damage, 1));
+   }
+}
+
+void Battle::casualtyPhase()
+{
+   for (int i = 0; i < m_count; ++i)
+   {
+      if (m_damage[i] == 0) continue;
+      const bool wasAlive = m_hp[i] > 0;
+      m_hp[i] = static_cast<int16_t>(m_hp[i] - m_damage[i]);
+      m_damage[i] = 0;
+      if (wasAlive && m_hp[i] <= 0)
+      {
+         --m_alive[m_side[i]];
+         m_occupant[cell(m_x[i], m_y[i])] = -1;
+      }
+   }
+}
+
+bool Battle::finished() const
+{
+   return m_alive[COMBAT_ATTACKER] == 0 || m_alive[COMBAT_DEFENDER] == 0 || m_round >= COMBAT_MAX_ROUNDS;
+}
+
+BattleResult Battle::result() const
+{
+   BattleResult result;
+   result.rounds = m_round;
+   result.survivors[COMBAT_ATTACKER] = m_alive[COMBAT_ATTACKER];
+   result.survivors[COMBAT_DEFENDER] = m_alive[COMBAT_DEFENDER];
+   if (m_alive[COMBAT_DEFENDER] == 0 && m_alive[COMBAT_ATTACKER] > 0) result.winner = COMBAT_ATTACKER;
+   else if (m_alive[COMBAT_ATTACKER] == 0 && m_alive[COMBAT_DEFENDER] > 0) result.winner = COMBAT_DEFENDER;
+   return result;
+}
+
+bool Battle::step()
+{
+   if (finished()) return false;
+   buffPhase();
+   targetPhase();
+   movePhase();
+   attackPhase();
+   casualtyPhase();
+   ++m_round;
+   return !finished();
+}
+
+BattleResult Battle::run()
+{
+   while (step()) {}
+   return result();
+}
+
+bool hasEnemyUnits(const GameState& state, int clanIdx, int x, int y)
+{
+   for (int slot = firstUnitOnTile(state, x, y); slot >= 0; slot = state.units[slot].nextOnTile)
+      if (state.units[slot].clanIdx != clanIdx) return true;
+   return false;
+}
+
+BattleResult resolveBattle(GameState& state, int attackerClan, int fromX, int fromY, int toX, int toY)
+{
+   // Seeded from the world, so replaying the same commands fights the same battles
+   const int battleTile = state.tileIndex(toX, toY);
+   Battle battle;
+   battle.reset(state.map[battleTile].terrain, state.worldHash ^ (static_cast<uint64_t>(state.currentTurn) << 32) ^ battleTile);
+
+   for (int slot = firstUnitOnTile(state, fromX, fromY); slot >= 0; slot = state.units[slot].nextOnTile)
+   {
+      const Unit& unit = state.units[slot];
+      if (unit.clanIdx == attackerClan)
+         battle.add(COMBAT_ATTACKER, unit.type, unit.attackStrength, unit.defenseStrength, unit.movementPoints, unit.abilities, slot);
+   }
+   for (int slot = firstUnitOnTile(state, toX, toY); slot >= 0; slot = state.units[slot].nextOnTile)
+   {
+      const Unit& unit = state.units[slot];
+      if (unit.clanIdx != attackerClan)
+         battle.add(COMBAT_DEFENDER, unit.type, unit.attackStrength, unit.defenseStrength, unit.movementPoints, unit.abilities, slot);
+   }
+
+   const BattleResult result = battle.run();
+   for (int i = 0; i < battle.count(); ++i)
+   {
+      if (!battle.alive(i))
+         destroyUnit(state, unitHandle(state, battle.sourceSlot(i)));
+   }
+   return result;
+}
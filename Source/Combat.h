@@ -0,0 +1,110 @@
+#ifndef COMBAT_H
+#define COMBAT_H
+
+#include "Game.h"
+#include <cstdint>
+
+struct GameState;
+
+const int COMBAT_GRID_WIDTH = 12;
+const int COMBAT_GRID_HEIGHT = 8;
+const int COMBAT_DEPLOY_COLUMNS = 4;                   // Each side starts in the outer columns on its edge
+const int MAX_COMBATANTS_PER_SIDE = COMBAT_DEPLOY_COLUMNS * COMBAT_GRID_HEIGHT;
+const int MAX_COMBATANTS = MAX_COMBATANTS_PER_SIDE * 2;
+const int COMBAT_MAX_ROUNDS = 30;                      // After this the battle is a draw
+const int COMBAT_BASE_HP = 4;                          // Plus two per point of defense
+const int COMBAT_MAX_STACK_BUFF = 2;                   // Cap on the attack bonus from BUFF_STACK units
+
+const int COMBAT_ATTACKER = 0;
+const int COMBAT_DEFENDER = 1;
+const int COMBAT_DRAW = -1;
+
+// Extra defense the defending side gets from the terrain the battle is fought on
+int combatDefenseBonus(Terrain terrain);
+
+struct BattleResult
+{
+   int winner = COMBAT_DRAW; // COMBAT_ATTACKER, COMBAT_DEFENDER or COMBAT_DRAW
+   int rounds = 0;
+   int survivors[2] = {};
+};
+
+// A tactical battle on a small grid.  Combatants are stored as parallel arrays, one
+// per stat, and each round runs as a fixed series of phases, each a flat loop over
+// those arrays: buffs, targeting, movement, attacks (damage is only accumulated, so
+// attacks are simultaneous), then casualties.  A Battle holds no pointers and never
+// allocates, so it can live on the stack of whichever thread resolves it.
+//
+// The Combat View can drive it a round at a time with step(); auto-resolve just calls
+// run().  Rolls come from the battle's own seed, so the same setup always plays out
+// the same way.
+class Battle
+{
+public:
+   void reset(Terrain terrain, uint64_t seed);
+
+   // Returns the combatant index, or -1 if that side is full.  sourceSlot is passed
+   // back through sourceSlot() so callers can map casualties to their units.
+   int add(int side, UnitType type, int attack, int defense, int movement, unsigned int abilities, int sourceSlot);
+
+   bool step();            // Plays one round; false once the battle is over
+   BattleResult run();     // Plays to the end
+
+   bool finished() const;
+   BattleResult result() const;
+
+   int count() const { return m_count; }
+   int side(int i) const { return m_side[i]; }
+   int x(int i) const { return m_x[i]; }
+   int y(int i) const { return m_y[i]; }
+   int hp(int i) const { return m_hp[i]; }
+   bool alive(int i) const { return m_hp[i] > 0; }
+   UnitType type(int i) const { return static_cast<UnitType>(m_type[i]); }
+   int sourceSlot(int i) const { return m_source[i]; }
+
+private:
+   uint32_t roll();
+   int cell(int x, int y) const { return y * COMBAT_GRID_WIDTH + x; }
+
+   void buffPhase();
+   void targetPhase();
+   void movePhase();
+   void attackPhase();
+   void casualtyPhase();
+
+   Terrain m_terrain = Terrain::GRASSLAND;
+   uint64_t m_rng = 1;
+   int m_round = 0;
+   int m_count = 0;
+   int m_sideCount[2] = {};
+   int m_alive[2] = {};
+   int m_buff[2] = {};
+
+   // One array per field, indexed by combatant
+   int8_t m_side[MAX_COMBATANTS];
+   int8_t m_x[MAX_COMBATANTS];
+   int8_t m_y[MAX_COMBATANTS];
+   uint8_t m_type[MAX_COMBATANTS];
+   uint8_t m_movement[MAX_COMBATANTS];
+   uint8_t m_range[MAX_COMBATANTS];
+   int16_t m_attack[MAX_COMBATANTS];
+   int16_t m_defense[MAX_COMBATANTS];
+   int16_t m_hp[MAX_COMBATANTS];
+   int16_t m_damage[MAX_COMBATANTS];   // Taken this round, applied in casualtyPhase
+   int16_t m_target[MAX_COMBATANTS];   // Nearest living enemy, -1 if none
+   uint32_t m_abilities[MAX_COMBATANTS];
+   int m_source[MAX_COMBATANTS];
+
+   int8_t m_occupant[COMBAT_GRID_WIDTH * COMBAT_GRID_HEIGHT]; // Combatant in each cell, -1 if empty
+};
+
+// Auto-resolves an attack by the attacker clan's units on (fromX, fromY) against every
+// other clan's units on (toX, toY), fought on the defender's terrain.  Dead units are
+// destroyed through the unit pool, so the hash, fog and occupancy stay in step.  A
+// stack larger than MAX_COMBATANTS_PER_SIDE fights with its first units only.
+BattleResult resolveBattle(GameState& state, int attackerClan, int fromX, int fromY, int toX, int toY);
+
+// True if units of a clan other than clanIdx stand on (x, y)
+bool hasEnemyUnits(const GameState& state, int clanIdx, int x, int y);
+
+#endif
@@ -0,0 +1,115 @@
+#include "Commands.h"
+#include "BuildQueues.h"
+#include "Clan.h"
+#include "Combat.h"
+#include "GameState.h"
+#include "Pathfinding.h"
+#include "Production.h"
+#include "StateHash.h"
+#include "Villages.h"
+#include <cstdlib>
+
+static_assert(MAX_TECHS <= 256, "Command::detail must be able to name every tech");
+
+// The unit the command names, if it is still alive and still belongs to the clan
+static const Unit* commandedUnit(const GameState& state, const Command& command)
+{
+   const Unit* unit = getUnit(state, command.unit);
+   return unit && unit->clanIdx == command.clanIdx ? unit : nullptr;
+}
+
+// The village the command names, if it still stands and still belongs to the clan
+static const Village* commandedVillage(const GameState& state, const Command& command)
+{
+   const Village* village = getVillage(state, command.village);
+   return village && village->clanIdx == command.clanIdx ? village : nullptr;
+}
+
+// Both only queue the item; it is paid for and completed at the end of the turn, see BuildQueues.h
+static bool applyBuild(GameState& state, const Command& command)
+{
+   if (!commandedVillage(state, command)) return false;
+   return enqueueBuild(state, command.village.index, QueueItemKind::BUILDING, command.detail);
+}
+
+static bool applyTrain(GameState& state, const Command& command)
+{
+   if (!commandedVillage(state, command)) return false;
+   return enqueueBuild(state, command.village.index, QueueItemKind::UNIT, command.detail);
+}
+
+static bool applyMove(GameState& state, const Command& command)
+{
+   const Unit* unit = commandedUnit(state, command);
+   if (!unit || !state.inBounds(command.x, command.y)) return false;
+
+   // One tile per turn on the main map
+   const int dx = std::abs(command.x - unit->x);
+   const int dy = std::abs(command.y - unit->y);
+   if (dx > 1 || dy > 1 || (dx == 0 && dy == 0)) return false;
+
+   const Terrain terrain = state.map[state.tileIndex(command.x, command.y)].terrain;
+   if (terrainMoveCost(terrain, movementClassFor(unit->abilities)) == 0) return false;
+
+   // Enemy units on the tile have to be beaten first; the unit only advances if it
+   // survived and the tile was cleared
+   if (hasEnemyUnits(state, command.clanIdx, command.x, command.y))
+   {
+      resolveBattle(state, command.clanIdx, unit->x, unit->y, command.x, command.y);
+      if (!isValidUnit(state, command.unit) || hasEnemyUnits(state, command.clanIdx, command.x, command.y)) return true;
+   }
+
+   moveUnit(state, command.unit, command.x, command.y);
+
+   // Walking into an undefended enemy village takes it
+   const SquareTile& tile = state.map[state.tileIndex(command.x, command.y)];
+   if (tile.hasVillage && state.villages[tile.villageIdx].clanIdx != command.clanIdx)
+      captureVillage(state, villageHandle(state, tile.villageIdx), command.clanIdx);
+   return true;
+}
+
+static bool applyFoundVillage(GameState& state, const Command& command)
+{
+   const Unit* unit = commandedUnit(state, command);
+   if (!unit || !unit->hasAbility(SpecialAbility::BUILD_VILLAGE) || !canFoundVillage(state, unit->x, unit->y)) return false;
+
+   const int x = unit->x;
+   const int y = unit->y;
+   destroyUnit(state, command.unit);
+   foundVillage(state, x, y, command.clanIdx);
+   return true;
+}
+
+static bool applyResearch(GameState& state, const Command& command)
+{
+   const TechTree& tree = sharedTechTree();
+   Clan& clan = state.clans[command.clanIdx];
+   if (!tree.canResearch(clan.researched, command.detail)) return false;
+
+   const TechInfo& tech = tree.tech(command.detail);
+   if (clan.knowledge < tech.knowledgeCost || clan.worship < tech.worshipCost) return false;
+
+   const uint64_t clanKey = hashClan(command.clanIdx, clan);
+   clan.knowledge -= tech.knowledgeCost;
+   clan.worship -= tech.worshipCost;
+   clan.researched.set(command.detail);
+   compileProduction(clan, tree);
+   state.worldHash ^= clanKey ^ hashClan(command.clanIdx, clan);
+   state.markChanged(ChangeKind::CLAN, command.clanIdx);
+   return true;
+}
+
+bool applyCommand(GameState& state, const Command& command)
+{
+   if (command.clanIdx < 0 || command.clanIdx >= (int)state.clans.size()) return false;
+
+   switch (command.type)
+   {
+   case CommandType::BUILD:         return applyBuild(state, command);
+   case CommandType::TRAIN:         return applyTrain(state, command);
+   case CommandType::MOVE:          return applyMove(state, command);
+   case CommandType::FOUND_VILLAGE: return applyFoundVillage(state, command);
+   case CommandType::RESEARCH:      return applyResearch(state, command);
+   }
+   return false;
+}
@@ -0,0 +1,39 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include "Units.h"
+#include "Villages.h"
+#include <cstdint>
+
+struct GameState;
+
+// Everything a clan can decide to do during a turn
+enum class CommandType : uint8_t
+{
+   BUILD,         // village queues detail (a BuildingType), built on the first free site
+   TRAIN,         // village queues detail (a UnitType), trained for its goldCost
+   MOVE,          // unit steps to the neighbouring tile (x, y), attacking any enemy units there
+                  // and capturing an enemy village it walks into
+   FOUND_VILLAGE, // unit (a settler) becomes a village on its tile
+   RESEARCH       // the clan researches detail (a tech in sharedTechTree()) for its cost
+};
+
+// One decision, as plain data.  Planners produce commands against a read-only state
+// and applyCommand carries them out later, so the same command stream can come from
+// the AI, the UI or a log.
+struct Command
+{
+   CommandType type;
+   uint8_t detail = 0;
+   int clanIdx = -1;
+   VillageHandle village;
+   UnitHandle unit;
+   int x = 0, y = 0;
+};
+
+// Checks the command against the current state and carries it out, keeping the world
+// hash, fog and territory in step.  Returns false, changing nothing, if the command
+// is no longer legal (the unit died, the gold was spent, the site was taken...).
+bool applyCommand(GameState& state, const Command& command);
+
+#endif
@@ -0,0 +1,512 @@
+#include "DeltaSave.h"
+#include "Fog.h"
+#include "LineOfSight.h"
+#include "MappedFile.h"
+#include "Production.h"
+#include "SaveGame.h"
+#include "StateHash.h"
+#include "TechTree.h"
+#include "Territory.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+   const char CHAIN_MAGIC[4] = { 'C', 'D', 'D', 'C' };
+   const char FRAME_MAGIC[4] = { 'C', 'D', 'D', 'F' };
+
+   const size_t ELEMENT_SIZE[DeltaArrays::COUNT] = {
+      sizeof(SquareTile), sizeof(int), sizeof(Clan), sizeof(Village), sizeof(QueueItem), sizeof(Unit), sizeof(uint64_t)
+   };
+
+   // The arrays each ChangeKind stands for; -1 = none
+   const int KIND_ARRAYS[CHANGE_KIND_COUNT][2] = {
+      { DeltaArrays::MAP, DeltaArrays::TILE_FIRST_UNIT }, // TILE
+      { DeltaArrays::CLANS, -1 },                          // CLAN
+      { DeltaArrays::VILLAGES, -1 },                       // VILLAGE
+      { DeltaArrays::QUEUE_ITEMS, -1 },                    // QUEUE_ITEM
+      { DeltaArrays::UNITS, -1 },                          // UNIT
+      { DeltaArrays::FOG_EXPLORED, -1 }                    // FOG_WORD
+   };
+
+   template <typename T>
+   const uint8_t* bytesOf(const std::vector<T>& arena, size_t& count)
+   {
+      count = arena.size();
+      return reinterpret_cast<const uint8_t*>(arena.data());
+   }
+
+   const uint8_t* liveArray(const GameState& state, int array, size_t& count)
+   {
+      switch (array)
+      {
+      case DeltaArrays::MAP:             return bytesOf(state.map, count);
+      case DeltaArrays::TILE_FIRST_UNIT: return bytesOf(state.tileFirstUnit, count);
+      case DeltaArrays::CLANS:           return bytesOf(state.clans, count);
+      case DeltaArrays::VILLAGES:        return bytesOf(state.villages, count);
+      case DeltaArrays::QUEUE_ITEMS:     return bytesOf(state.queueItems, count);
+      case DeltaArrays::UNITS:           return bytesOf(state.units, count);
+      default:                           return bytesOf(state.fogExplored, count);
+      }
+   }
+
+   template <typename T>
+   void assignFromBytes(std::vector<T>& arena, const std::vector<uint8_t>& bytes)
+   {
+      arena.resize(bytes.size() / sizeof(T));
+      if (!bytes.empty()) std::memcpy(static_cast<void*>(arena.data()), bytes.data(), bytes.size());
+   }
+
+   void putVarint(std::vector<uint8_t>& out, uint32_t value)
+   {
+      while (value >= 0x80)
+      {
+         out.push_back(static_cast<uint8_t>(value | 0x80));
+         value >>= 7;
+      }
+      out.push_back(static_cast<uint8_t>(value));
+   }
+
+   bool getVarint(const uint8_t* in, size_t size, size_t& pos, uint32_t& value)
+   {
+      value = 0;
+      for (int shift = 0; shift < 35 && pos < size; shift += 7)
+      {
+         const uint8_t byte = in[pos++];
+         value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+         if (!(byte & 0x80)) return true;
+      }
+      return false;
+   }
+
+   // One entity as (unchanged run, changed run, changed bytes XOR before) pairs until
+   // its bytes are used up.  A changed run ends at two unchanged bytes in a row, so a
+   // lone unchanged byte inside a change does not cost a pair.
+   void putRecord(std::vector<uint8_t>& out, const uint8_t* now, const uint8_t* before, size_t size)
+   {
+      size_t pos = 0;
+      do
+      {
+         size_t start = pos;
+         while (start < size && now[start] == before[start]) ++start;
+         size_t end = start;
+         while (end < size && !(now[end] == before[end] && (end + 1 == size || now[end + 1] == before[end + 1])))
+            ++end;
+         putVarint(out, static_cast<uint32_t>(start - pos));
+         putVarint(out, static_cast<uint32_t>(end - start));
+         for (size_t i = start; i < end; ++i)
+            out.push_back(now[i] ^ before[i]);
+         pos = end;
+      } while (pos < size);
+   }
+
+   bool applyRecord(const uint8_t* in, size_t size, size_t& pos, uint8_t* record, size_t recordSize)
+   {
+      size_t at = 0;
+      do
+      {
+         uint32_t same, changed;
+         if (!getVarint(in, size, pos, same) || !getVarint(in, size, pos, changed)) return false;
+         at += same;
+         if (at + changed > recordSize || pos + changed > size) return false;
+         for (uint32_t i = 0; i < changed; ++i)
+            record[at + i] ^= in[pos + i];
+         at += changed;
+         pos += changed;
+      } while (at < recordSize);
+      return at == recordSize;
+   }
+
+   // Element counts of the stored arrays in the frame that header describes
+   void frameCounts(const DeltaChainHeader& chain, const DeltaFrameHeader& frame, size_t (&counts)[DeltaArrays::COUNT])
+   {
+      const size_t tiles = static_cast<size_t>(chain.width) * chain.height;
+      counts[DeltaArrays::MAP] = tiles;
+      counts[DeltaArrays::TILE_FIRST_UNIT] = frame.tileFirstUnitCount;
+      counts[DeltaArrays::CLANS] = chain.clanCount;
+      counts[DeltaArrays::VILLAGES] = frame.villageCount;
+      counts[DeltaArrays::QUEUE_ITEMS] = frame.queueItemCount;
+      counts[DeltaArrays::UNITS] = frame.unitCount;
+      counts[DeltaArrays::FOG_EXPLORED] = static_cast<size_t>(chain.clanCount) * chain.height * chain.fogWordsPerRow;
+   }
+
+   bool readIndex(const uint8_t* data, size_t size, DeltaChainHeader& chain, std::vector<DeltaFrameInfo>& frames,
+      const std::string& path, std::string& error)
+   {
+      frames.clear();
+      if (size < sizeof(DeltaChainHeader) || std::memcmp(data, CHAIN_MAGIC, sizeof(CHAIN_MAGIC)) != 0)
+      {
+         error = path + " is not a history chain";
+         return false;
+      }
+      std::memcpy(&chain, data, sizeof(chain));
+      if (chain.formatVersion != DELTA_FORMAT_VERSION || chain.rulesVersion != RULES_VERSION ||
+         chain.layoutFingerprint != saveLayoutFingerprint())
+      {
+         error = path + " was written by an incompatible build";
+         return false;
+      }
+      if (chain.width <= 0 || chain.height <= 0 || chain.clanCount < 0 || chain.fogWordsPerRow < 0)
+      {
+         error = path + " is damaged";
+         return false;
+      }
+
+      // Stops at the first frame that is not all there: the tail a crash left behind
+      size_t pos = sizeof(DeltaChainHeader);
+      DeltaFrameHeader frame;
+      while (size - pos >= sizeof(DeltaFrameHeader))
+      {
+         std::memcpy(&frame, data + pos, sizeof(frame));
+         if (std::memcmp(frame.magic, FRAME_MAGIC, sizeof(FRAME_MAGIC)) != 0 ||
+            frame.payloadBytes > size - pos - sizeof(DeltaFrameHeader))
+            break;
+         DeltaFrameInfo info;
+         info.turn = frame.currentTurn;
+         info.keyframe = frame.keyframe != 0;
+         info.offset = pos;
+         info.bytes = static_cast<uint32_t>(sizeof(DeltaFrameHeader) + frame.payloadBytes);
+         info.worldHash = frame.worldHash;
+         frames.push_back(info);
+         pos += info.bytes;
+      }
+      if (frames.empty() || !frames.front().keyframe)
+      {
+         error = path + " has no keyframe";
+         return false;
+      }
+      return true;
+   }
+
+   bool applyFrame(const uint8_t* data, const DeltaChainHeader& chain, const DeltaFrameInfo& info, DeltaArrays& arrays)
+   {
+      DeltaFrameHeader frame;
+      std::memcpy(&frame, data + info.offset, sizeof(frame));
+      if (frame.villageCount < 0 || frame.queueItemCount < 0 || frame.unitCount < 0 || frame.tileFirstUnitCount < 0)
+         return false;
+
+      // Pools only grow, and new slots start from zero bytes on both sides
+      size_t counts[DeltaArrays::COUNT];
+      frameCounts(chain, frame, counts);
+      for (int a = 0; a < DeltaArrays::COUNT; ++a)
+      {
+         if (frame.keyframe) arrays.bytes[a].clear();
+         arrays.bytes[a].resize(counts[a] * ELEMENT_SIZE[a], 0);
+      }
+
+      const uint8_t* payload = data + info.offset + sizeof(DeltaFrameHeader);
+      const size_t size = frame.payloadBytes;
+      size_t pos = 0;
+      for (int k = 0; k < CHANGE_KIND_COUNT; ++k)
+      {
+         uint32_t entries;
+         if (!getVarint(payload, size, pos, entries)) return false;
+         int idx = -1;
+         for (uint32_t e = 0; e < entries; ++e)
+         {
+            uint32_t gap;
+            if (!getVarint(payload, size, pos, gap)) return false;
+            idx += static_cast<int>(gap) + 1;
+            for (int array : KIND_ARRAYS[k])
+            {
+               if (array < 0 || static_cast<size_t>(idx) >= counts[array]) continue;
+               const size_t elementSize = ELEMENT_SIZE[array];
+               if (!applyRecord(payload, size, pos, &arrays.bytes[array][idx * elementSize], elementSize)) return false;
+            }
+         }
+      }
+      return pos == size;
+   }
+}
+
+DeltaWriter::~DeltaWriter()
+{
+   stopWriter();
+   if (m_file) std::fclose(m_file);
+}
+
+bool DeltaWriter::open(const std::string& path, GameState& state, std::string& error, int keyframeInterval)
+{
+   close(state);
+   m_file = std::fopen(path.c_str(), "wb");
+   if (!m_file)
+   {
+      error = "cannot open " + path;
+      return false;
+   }
+   m_path = path;
+   m_keyframeInterval = keyframeInterval > 0 ? keyframeInterval : 1;
+
+   DeltaChainHeader chain = {};
+   std::memcpy(chain.magic, CHAIN_MAGIC, sizeof(chain.magic));
+   chain.formatVersion = DELTA_FORMAT_VERSION;
+   chain.rulesVersion = RULES_VERSION;
+   chain.layoutFingerprint = saveLayoutFingerprint();
+   chain.seed = state.seed;
+   chain.width = state.width;
+   chain.height = state.height;
+   chain.clanCount = (int32_t)state.clans.size();
+   chain.fogWordsPerRow = state.fogWordsPerRow;
+   chain.keyframeInterval = static_cast<uint32_t>(m_keyframeInterval);
+   if (std::fwrite(&chain, sizeof(chain), 1, m_file) != 1)
+   {
+      error = "cannot write " + path;
+      close(state);
+      return false;
+   }
+
+   m_failed = false;
+   m_writeMsMax = 0.0;
+   m_thread = std::thread(&DeltaWriter::writerLoop, this);
+   state.changes.clear();
+   state.changes.enabled = true;
+   m_framesSinceKeyframe = 0;
+   return write(state, true, error);
+}
+
+bool DeltaWriter::writeFrame(GameState& state, std::string& error)
+{
+   if (!m_file)
+   {
+      error = "no history chain is open";
+      return false;
+   }
+   const bool keyframe = ++m_framesSinceKeyframe >= m_keyframeInterval;
+   if (keyframe) m_framesSinceKeyframe = 0;
+   return write(state, keyframe, error);
+}
+
+void DeltaWriter::close(GameState& state)
+{
+   state.changes.enabled = false;
+   state.changes.clear();
+   stopWriter();
+   if (m_file) std::fclose(m_file);
+   m_file = nullptr;
+   for (std::vector<uint8_t>& bytes : m_previous.bytes)
+      bytes.clear();
+}
+
+double DeltaWriter::writeMsMax() const
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   return m_writeMsMax;
+}
+
+void DeltaWriter::stopWriter()
+{
+   if (!m_thread.joinable()) return;
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_quit = true;
+   }
+   m_wake.notify_one();
+   m_thread.join();
+   m_quit = false;
+}
+
+void DeltaWriter::writerLoop()
+{
+   using Clock = std::chrono::steady_clock;
+   std::unique_lock<std::mutex> lock(m_mutex);
+   for (;;)
+   {
+      m_wake.wait(lock, [this] { return m_quit || !m_queued.empty(); });
+      if (m_queued.empty()) return; // Quitting, with every frame written
+
+      // Swapping keeps both buffers' capacity
+      m_writing.swap(m_queued);
+      lock.unlock();
+
+      // Flushed, not synced: a crashed game keeps its history, a lost disk cache may not
+      const Clock::time_point start = Clock::now();
+      const bool ok = std::fwrite(m_writing.data(), m_writing.size(), 1, m_file) == 1 && std::fflush(m_file) == 0;
+      const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+      m_writing.clear();
+
+      lock.lock();
+      if (!ok) m_failed = true;
+      if (ms > m_writeMsMax) m_writeMsMax = ms;
+   }
+}
+
+bool DeltaWriter::write(GameState& state, bool keyframe, std::string& error)
+{
+   using Clock = std::chrono::steady_clock;
+   const Clock::time_point start = Clock::now();
+   const uint8_t* live[DeltaArrays::COUNT];
+   size_t counts[DeltaArrays::COUNT];
+   for (int a = 0; a < DeltaArrays::COUNT; ++a)
+   {
+      live[a] = liveArray(state, a, counts[a]);
+      if (keyframe) m_previous.bytes[a].clear();
+      m_previous.bytes[a].resize(counts[a] * ELEMENT_SIZE[a], 0);
+   }
+
+   // The header goes in front once the payload is known
+   m_frame.assign(sizeof(DeltaFrameHeader), 0);
+   for (int k = 0; k < CHANGE_KIND_COUNT; ++k)
+   {
+      // A keyframe takes every entity, a delta the marked ones in slot order
+      const int primary = KIND_ARRAYS[k][0];
+      m_sorted.clear();
+      if (keyframe)
+      {
+         for (size_t i = 0; i < counts[primary]; ++i)
+            m_sorted.push_back(static_cast<int>(i));
+      }
+      else
+      {
+         for (int idx : state.changes.indices[k])
+            if (static_cast<size_t>(idx) < counts[primary]) m_sorted.push_back(idx);
+         std::sort(m_sorted.begin(), m_sorted.end());
+      }
+
+      putVarint(m_frame, static_cast<uint32_t>(m_sorted.size()));
+      int last = -1;
+      for (int idx : m_sorted)
+      {
+         putVarint(m_frame, static_cast<uint32_t>(idx - last - 1));
+         last = idx;
+         for (int array : KIND_ARRAYS[k])
+         {
+            if (array < 0 || static_cast<size_t>(idx) >= counts[array]) continue;
+            const size_t elementSize = ELEMENT_SIZE[array];
+            uint8_t* before = &m_previous.bytes[array][idx * elementSize];
+            const uint8_t* now = live[array] + idx * elementSize;
+            putRecord(m_frame, now, before, elementSize);
+            std::memcpy(before, now, elementSize);
+         }
+      }
+   }
+   state.changes.clear();
+
+   DeltaFrameHeader frame = {};
+   std::memcpy(frame.magic, FRAME_MAGIC, sizeof(frame.magic));
+   frame.keyframe = keyframe ? 1 : 0;
+   frame.currentTurn = state.currentTurn;
+   frame.payloadBytes = static_cast<uint32_t>(m_frame.size() - sizeof(frame));
+   frame.worldHash = state.worldHash;
+   frame.villageCount = (int32_t)counts[DeltaArrays::VILLAGES];
+   frame.queueItemCount = (int32_t)counts[DeltaArrays::QUEUE_ITEMS];
+   frame.unitCount = (int32_t)counts[DeltaArrays::UNITS];
+   frame.tileFirstUnitCount = (int32_t)counts[DeltaArrays::TILE_FIRST_UNIT];
+   frame.firstFreeVillage = state.firstFreeVillage;
+   frame.liveVillageCount = state.liveVillageCount;
+   frame.firstFreeQueueItem = state.firstFreeQueueItem;
+   frame.firstFreeUnit = state.firstFreeUnit;
+   frame.liveUnitCount = state.liveUnitCount;
+   frame.unitSlotsUsed = state.unitSlotsUsed;
+
+   std::memcpy(m_frame.data(), &frame, sizeof(frame));
+   m_lastFrameBytes = static_cast<uint32_t>(m_frame.size());
+   m_lastEncodeMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_failed)
+      {
+         error = "cannot write " + m_path;
+         return false;
+      }
+      // Handed over whole unless the writer is behind
+      if (m_queued.empty())
+         m_queued.swap(m_frame);
+      else
+         m_queued.insert(m_queued.end(), m_frame.begin(), m_frame.end());
+   }
+   m_wake.notify_one();
+   return true;
+}
+
+bool readDeltaChainIndex(const std::string& path, std::vector<DeltaFrameInfo>& frames, std::string& error)
+{
+   MappedFile file;
+   if (!file.open(path))
+   {
+      error = "cannot open " + path;
+      return false;
+   }
+   DeltaChainHeader chain;
+   return readIndex(file.data(), file.size(), chain, frames, path, error);
+}
+
+bool loadDeltaChain(GameState& state, const std::string& path, int turn, std::string& error)
+{
+   MappedFile file;
+   if (!file.open(path))
+   {
+      error = "cannot open " + path;
+      return false;
+   }
+   DeltaChainHeader chain;
+   std::vector<DeltaFrameInfo> frames;
+   if (!readIndex(file.data(), file.size(), chain, frames, path, error)) return false;
+
+   int target = (int)frames.size() - 1;
+   if (turn >= 0)
+   {
+      while (target >= 0 && frames[target].turn > turn) --target;
+      if (target < 0)
+      {
+         error = path + " starts after turn " + std::to_string(turn);
+         return false;
+      }
+   }
+   int first = target;
+   while (!frames[first].keyframe) --first;
+
+   DeltaArrays arrays;
+   for (int f = first; f <= target; ++f)
+   {
+      if (!applyFrame(file.data(), chain, frames[f], arrays))
+      {
+         error = path + " is damaged at turn " + std::to_string(frames[f].turn);
+         return false;
+      }
+   }
+
+   DeltaFrameHeader frame;
+   std::memcpy(&frame, file.data() + frames[target].offset, sizeof(frame));
+   GameState loaded;
+   loaded.width = chain.width;
+   loaded.height = chain.height;
+   loaded.seed = chain.seed;
+   loaded.currentTurn = frame.currentTurn;
+   loaded.worldHash = frame.worldHash;
+   loaded.terrainStamp = nextTerrainStamp(); // Before rebuildFog, which caches line of sight under it
+   loaded.firstFreeVillage = frame.firstFreeVillage;
+   loaded.liveVillageCount = frame.liveVillageCount;
+   loaded.firstFreeQueueItem = frame.firstFreeQueueItem;
+   loaded.firstFreeUnit = frame.firstFreeUnit;
+   loaded.liveUnitCount = frame.liveUnitCount;
+   loaded.unitSlotsUsed = frame.unitSlotsUsed;
+   loaded.fogWordsPerRow = chain.fogWordsPerRow;
+   assignFromBytes(loaded.map, arrays.bytes[DeltaArrays::MAP]);
+   assignFromBytes(loaded.tileFirstUnit, arrays.bytes[DeltaArrays::TILE_FIRST_UNIT]);
+   assignFromBytes(loaded.clans, arrays.bytes[DeltaArrays::CLANS]);
+   assignFromBytes(loaded.villages, arrays.bytes[DeltaArrays::VILLAGES]);
+   assignFromBytes(loaded.queueItems, arrays.bytes[DeltaArrays::QUEUE_ITEMS]);
+   assignFromBytes(loaded.units, arrays.bytes[DeltaArrays::UNITS]);
+   assignFromBytes(loaded.fogExplored, arrays.bytes[DeltaArrays::FOG_EXPLORED]);
+
+   // Everything derived is rebuilt rather than stored
+   for (Clan& clan : loaded.clans)
+      compileProduction(clan, sharedTechTree());
+   if (loaded.fogWordsPerRow > 0)
+   {
+      loaded.fogVisible.assign(loaded.fogExplored.size(), 0);
+      loaded.fogVisionCount.assign(loaded.clans.size() * loaded.width * loaded.height, 0);
+      rebuildFog(loaded);
+   }
+   rebuildTerritory(loaded);
+
+   if (computeWorldHash(loaded) != loaded.worldHash)
+   {
+      error = path + " does not add up to its world hash at turn " + std::to_string(frame.currentTurn);
+      return false;
+   }
+   state.copyFrom(loaded);
+   state.changes.clear();
+   return true;
+}
@@ -0,0 +1,143 @@
+#ifndef DELTASAVE_H
+#define DELTASAVE_H
+
+#include "GameState.h"
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+const uint16_t DELTA_FORMAT_VERSION = 1;
+const int DELTA_KEYFRAME_INTERVAL = 16; // Frames from one keyframe to the next
+
+// A history chain is one append-only file of per-turn frames:
+//
+//    DeltaChainHeader | DeltaFrameHeader payload | DeltaFrameHeader payload | ...
+//
+// A keyframe holds every tile, clan, village, queue entry, unit and explored fog word.
+// A delta holds only the ones the state's ChangeTracker marked since the previous
+// frame, so its size follows what happened in the turn, not the size of the world.
+// Each entity is stored as its bytes XORed with the same entity in the previous frame,
+// with the zero runs left out, so a village whose storehouse went up costs a few bytes.
+// Visibility and territory are not stored: they are rebuilt after loading.
+//
+// Frames are flushed as they are written, so after a crash the chain still ends at
+// the last whole turn; a torn frame at the end is ignored.
+struct DeltaChainHeader
+{
+   char magic[4];             // "CDDC"
+   uint16_t formatVersion;
+   uint16_t rulesVersion;
+   uint32_t layoutFingerprint; // saveLayoutFingerprint(), see SaveGame.h
+   uint32_t seed;
+   int32_t width, height;
+   int32_t clanCount;
+   int32_t fogWordsPerRow;
+   uint32_t keyframeInterval;
+   uint32_t reserved;
+};
+
+static_assert(sizeof(DeltaChainHeader) == 40, "DeltaChainHeader is a file layout; keep it packed and fixed");
+
+struct DeltaFrameHeader
+{
+   char magic[4];             // "CDDF"
+   uint32_t keyframe;
+   int32_t currentTurn;
+   uint32_t payloadBytes;
+   uint64_t worldHash;
+   int32_t villageCount, queueItemCount, unitCount; // Pool sizes, which only grow
+   int32_t firstFreeVillage;
+   int32_t liveVillageCount;
+   int32_t firstFreeQueueItem;
+   int32_t firstFreeUnit;
+   int32_t liveUnitCount;
+   int32_t unitSlotsUsed;
+   int32_t tileFirstUnitCount;
+};
+
+static_assert(sizeof(DeltaFrameHeader) == 64, "DeltaFrameHeader is a file layout; keep it packed and fixed");
+
+// One frame of a chain, for listing a game's history
+struct DeltaFrameInfo
+{
+   int turn = 0;
+   bool keyframe = false;
+   uint64_t offset = 0;      // Of the frame header
+   uint32_t bytes = 0;       // Header and payload
+   uint64_t worldHash = 0;
+};
+
+// The stored arrays as raw bytes: what the last frame left behind, which is what the
+// next delta is taken against
+struct DeltaArrays
+{
+   enum { MAP, TILE_FIRST_UNIT, CLANS, VILLAGES, QUEUE_ITEMS, UNITS, FOG_EXPLORED, COUNT };
+   std::vector<uint8_t> bytes[COUNT];
+};
+
+// Writes a chain while a game is played.  Call writeFrame once per turn, after
+// ++currentTurn.  While the writer is open the state's ChangeTracker is on.
+//
+// A frame is encoded on the calling thread, which needs the live state and its
+// tracker; writing and flushing it happens on a thread of the writer's own, like
+// Autosaver's.  Frames are never dropped: one encoded while the last is still being
+// written is queued behind it.  A write error shows up on the next writeFrame.
+class DeltaWriter
+{
+public:
+   DeltaWriter() = default;
+   ~DeltaWriter();
+
+   DeltaWriter(const DeltaWriter&) = delete;
+   DeltaWriter& operator=(const DeltaWriter&) = delete;
+
+   // Starts a new chain at path with a keyframe of state
+   bool open(const std::string& path, GameState& state, std::string& error, int keyframeInterval = DELTA_KEYFRAME_INTERVAL);
+   bool writeFrame(GameState& state, std::string& error); // Clears the tracked changes
+   void close(GameState& state); // Waits for the queued frames to be written
+
+   bool isOpen() const { return m_file != nullptr; }
+   uint32_t lastFrameBytes() const { return m_lastFrameBytes; }
+   bool lastFrameWasKeyframe() const { return m_framesSinceKeyframe == 0; }
+   double lastEncodeMs() const { return m_lastEncodeMs; } // Calling thread
+   double writeMsMax() const; // Writer thread, worst frame since open
+
+private:
+   bool write(GameState& state, bool keyframe, std::string& error);
+   void writerLoop();
+   void stopWriter(); // Drains the queue and joins the thread
+
+   FILE* m_file = nullptr;
+   std::string m_path;
+   DeltaArrays m_previous;
+   std::vector<uint8_t> m_frame; // Header, then payload, of the frame being encoded
+   std::vector<int> m_sorted;
+   int m_keyframeInterval = DELTA_KEYFRAME_INTERVAL;
+   int m_framesSinceKeyframe = 0;
+   uint32_t m_lastFrameBytes = 0;
+   double m_lastEncodeMs = 0.0;
+
+   // Shared with the writer thread
+   mutable std::mutex m_mutex;
+   std::condition_variable m_wake;
+   std::thread m_thread;
+   std::vector<uint8_t> m_queued;  // Frames waiting for the writer
+   std::vector<uint8_t> m_writing; // Frames being written
+   bool m_quit = false;
+   bool m_failed = false;
+   double m_writeMsMax = 0.0;
+};
+
+// The whole frames of a chain, in order
+bool readDeltaChainIndex(const std::string& path, std::vector<DeltaFrameInfo>& frames, std::string& error);
+
+// Replaces state with the game as of turn: the last frame at or before it, or the
+// last frame of all for -1.  Plays forward from the keyframe before it.  Fails,
+// leaving state alone, on a damaged chain or another format, rules version or layout.
+bool loadDeltaChain(GameState& state, const std::string& path, int turn, std::string& error);
+
+#endif
@@ -0,0 +1,160 @@
+#include "FlowFields.h"
+#include <algorithm>
+
+bool FlowField::nextStep(int width, int x, int y, PathStep& out) const
+{
+   const uint8_t dir = step[y * width + x];
+   if (dir == FLOW_NO_STEP) return false;
+
+   out.x = x + NEIGHBOR_DX[dir];
+   out.y = y + NEIGHBOR_DY[dir];
+   return true;
+}
+
+void FlowFieldCache::init(int width, int height, int slots)
+{
+   m_width = width;
+   m_height = height;
+   m_clock = 0;
+   m_builds = 0;
+
+   const int cells = width * height;
+   m_fields.assign(slots < 1 ? 1 : slots, FlowField());
+   for (auto& field : m_fields)
+   {
+      field.distance.resize(cells);
+      field.step.resize(cells);
+   }
+   for (auto& bucket : m_buckets)
+      bucket.reserve(cells);
+}
+
+const FlowField* FlowFieldCache::get(const MovementCostGrid& grid, int targetX, int targetY, MovementClass movement)
+{
+   if (targetX < 0 || targetX >= m_width || targetY < 0 || targetY >= m_height) return nullptr;
+
+   const int target = targetY * m_width + targetX;
+   FlowField* victim = &m_fields[0];
+   for (auto& field : m_fields)
+   {
+      if (field.valid && field.targetIdx == target && field.movement == movement)
+      {
+         field.lastUsed = ++m_clock;
+         return &field;
+      }
+      // Empty slots first, then the one untouched the longest
+      if (!field.valid && victim->valid) victim = &field;
+      else if (field.valid == victim->valid && field.lastUsed < victim->lastUsed) victim = &field;
+   }
+
+   victim->targetIdx = target;
+   victim->movement = movement;
+   build(grid, *victim);
+   victim->valid = true;
+   victim->lastUsed = ++m_clock;
+   return victim;
+}
+
+const FlowField* FlowFieldCache::find(int targetX, int targetY, MovementClass movement)
+{
+   if (targetX < 0 || targetX >= m_width || targetY < 0 || targetY >= m_height) return nullptr;
+
+   const int target = targetY * m_width + targetX;
+   for (auto& field : m_fields)
+   {
+      if (field.valid && field.targetIdx == target && field.movement == movement)
+      {
+         field.lastUsed = ++m_clock;
+         return &field;
+      }
+   }
+   return nullptr;
+}
+
+void FlowFieldCache::build(const MovementCostGrid& grid, FlowField& field)
+{
+   ++m_builds;
+   std::fill(field.distance.begin(), field.distance.end(), FLOW_UNREACHABLE);
+   std::fill(field.step.begin(), field.step.end(), FLOW_NO_STEP);
+
+   const int target = field.targetIdx;
+   if (grid.cost(field.movement, target) == 0) return;
+
+   for (auto& bucket : m_buckets)
+      bucket.clear();
+
+   // Runs backwards from the target: moving from a to its neighbour b costs b's entry
+   // cost, so every tile popped pays its own cost to each neighbour that reaches it.
+   field.distance[target] = 0;
+   m_buckets[0].push_back(target);
+   int pending = 1;
+
+   for (int d = 0; pending > 0; ++d)
+   {
+      std::vector<int>& bucket = m_buckets[d & 3];
+      // New entries land in other buckets (d + 1..3), so this one only shrinks
+      for (size_t i = 0; i < bucket.size(); ++i)
+      {
+         const int b = bucket[i];
+         --pending;
+         if (field.distance[b] != d) continue; // Stale, reached more cheaply since
+
+         const int enterCost = grid.cost(field.movement, b);
+         const int bx = b % m_width;
+         const int by = b / m_width;
+         for (int n = 0; n < 8; ++n)
+         {
+            const int ax = bx - NEIGHBOR_DX[n];
+            const int ay = by - NEIGHBOR_DY[n];
+            if (ax < 0 || ax >= m_width || ay < 0 || ay >= m_height) continue;
+
+            const int a = ay * m_width + ax;
+            if (grid.cost(field.movement, a) == 0) continue;
+
+            const int candidate = d + enterCost;
+            if (candidate < field.distance[a])
+            {
+               field.distance[a] = candidate;
+               field.step[a] = static_cast<uint8_t>(n);
+               m_buckets[candidate & 3].push_back(a);
+               ++pending;
+            }
+         }
+      }
+      bucket.clear();
+   }
+}
+
+void FlowFieldCache::onTileChanged(int idx)
+{
+   const int x = idx % m_width;
+   const int y = idx / m_width;
+   for (auto& field : m_fields)
+   {
+      if (!field.valid) continue;
+
+      // The tile's own distance depends on its cost, and a tile that just became
+      // passable can only open a route if a neighbour was already reachable.
+      bool touched = field.distance[idx] != FLOW_UNREACHABLE;
+      for (int n = 0; n < 8 && !touched; ++n)
+      {
+         const int nx = x + NEIGHBOR_DX[n];
+         const int ny = y + NEIGHBOR_DY[n];
+         if (nx < 0 || nx >= m_width || ny < 0 || ny >= m_height) continue;
+         touched = field.distance[ny * m_width + nx] != FLOW_UNREACHABLE;
+      }
+      if (touched) field.valid = false;
+   }
+}
+
+void FlowFieldCache::release(int targetIdx)
+{
+   for (auto& field : m_fields)
+      if (field.targetIdx == targetIdx) field.valid = false;
+}
+
+void FlowFieldCache::invalidateAll()
+{
+   for (auto& field : m_fields)
+      field.valid = false;
+}
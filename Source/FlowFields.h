@@ -0,0 +1,68 @@
+#ifndef FLOWFIELDS_H
+#define FLOWFIELDS_H
+
+#include "Pathfinding.h"
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+const int FLOW_UNREACHABLE = INT_MAX;
+const uint8_t FLOW_NO_STEP = 0xFF;
+const int DEFAULT_FLOW_FIELD_SLOTS = 16;
+
+// Cost-to-target for every tile, plus the neighbour to step to next.  Any number of
+// units heading for the same tile share one field instead of each running A*.
+struct FlowField
+{
+   int targetIdx = -1;
+   MovementClass movement = MovementClass::LAND;
+   bool valid = false;
+   unsigned int lastUsed = 0;
+
+   std::vector<int> distance;  // Summed entry cost to the target, FLOW_UNREACHABLE if none
+   std::vector<uint8_t> step;  // Index into NEIGHBOR_DX/DY, FLOW_NO_STEP at the target or if unreachable
+
+   int distanceAt(int idx) const { return distance[idx]; }
+
+   // Fills in the next tile to move to from (x, y); false at the target or if unreachable
+   bool nextStep(int width, int x, int y, PathStep& out) const;
+};
+
+// A fixed number of flow fields, keyed by (target tile, movement class) and reused
+// least-recently-used first.  Fields are built on demand by a Dijkstra outwards from
+// the target; once every slot has been sized for the map, building one allocates
+// nothing.  A terrain change only throws away the fields it could affect.
+//
+// Pointers returned by get() stay valid until the next get() or onTileChanged().
+// Not thread-safe.
+class FlowFieldCache
+{
+public:
+   void init(int width, int height, int slots = DEFAULT_FLOW_FIELD_SLOTS);
+
+   const FlowField* get(const MovementCostGrid& grid, int targetX, int targetY, MovementClass movement);
+
+   // Like get, but only returns a field that is already built
+   const FlowField* find(int targetX, int targetY, MovementClass movement);
+
+   // Call after the grid has been updated for the tile
+   void onTileChanged(int idx);
+
+   // Drops the fields aimed at the tile, for a target that is no longer wanted
+   void release(int targetIdx);
+   void invalidateAll();
+
+   int builds() const { return m_builds; }
+
+private:
+   void build(const MovementCostGrid& grid, FlowField& field);
+
+   int m_width = 0;
+   int m_height = 0;
+   unsigned int m_clock = 0;
+   int m_builds = 0;
+   std::vector<FlowField> m_fields;
+   std::vector<int> m_buckets[4]; // Dial's algorithm: entry costs are 1..3, so four buckets suffice
+};
+
+#endif
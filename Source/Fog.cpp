@@ -0,0 +1,119 @@
+#include "Fog.h"
+#include "GameState.h"
+#include "LineOfSight.h"
+#include "Units.h"
+#include <algorithm>
+
+static size_t rowOffset(const GameState& state, int clanIdx, int y)
+{
+   return (static_cast<size_t>(clanIdx) * state.height + y) * state.fogWordsPerRow;
+}
+
+// Marks bits of one row word visible, and explored; only newly explored words are recorded as changed
+static void see(GameState& state, size_t word, uint64_t bits)
+{
+   state.fogVisible[word] |= bits;
+   if ((bits & ~state.fogExplored[word]) == 0) return;
+   state.fogExplored[word] |= bits;
+   state.markChanged(ChangeKind::FOG_WORD, static_cast<int>(word));
+}
+
+void initFog(GameState& state)
+{
+   const int clanCount = static_cast<int>(state.clans.size());
+   state.fogWordsPerRow = (state.width + 63) / 64;
+   state.fogExplored.assign(static_cast<size_t>(clanCount) * state.height * state.fogWordsPerRow, 0);
+   state.fogVisible.assign(state.fogExplored.size(), 0);
+   state.fogVisionCount.assign(static_cast<size_t>(clanCount) * state.width * state.height, 0);
+}
+
+void rebuildFog(GameState& state)
+{
+   std::fill(state.fogVisible.begin(), state.fogVisible.end(), 0);
+   std::fill(state.fogVisionCount.begin(), state.fogVisionCount.end(), 0);
+
+   for (const auto& village : state.villages)
+      if (village.alive)
+         addVision(state, village.clanIdx, village.x, village.y, VILLAGE_VISION_RADIUS);
+
+   for (const auto& unit : state.units)
+   {
+      if (unit.alive)
+         addVision(state, unit.clanIdx, unit.x, unit.y, unitTypeInfo(unit.type).visionRadius);
+   }
+}
+
+void addVision(GameState& state, int clanIdx, int x, int y, int radius)
+{
+   if (state.fogWordsPerRow == 0 || clanIdx < 0 || clanIdx >= (int)state.clans.size()) return;
+
+   const VisionMask& mask = threadVisionCache().get(state, x, y, radius);
+   uint16_t* counts = &state.fogVisionCount[static_cast<size_t>(clanIdx) * state.width * state.height];
+   for (int dy = -mask.radius; dy <= mask.radius; ++dy)
+   {
+      const uint32_t seen = mask.rows[dy + mask.radius];
+      if (seen == 0) continue;
+
+      const int row = y + dy;
+      uint16_t* rowCounts = counts + row * state.width;
+      for (uint32_t bits = seen; bits != 0; bits &= bits - 1)
+         ++rowCounts[x - mask.radius + lowestSetBit(bits)];
+
+      // Newly seen tiles only ever gain bits, so the row is or'ed in a word at a time.
+      // The mask is at most 17 bits wide, so it straddles at most two words.
+      const int left = x - mask.radius; // May be negative; those bits are never set
+      const size_t offset = rowOffset(state, clanIdx, row);
+      const uint64_t wide = static_cast<uint64_t>(seen);
+      const int firstWord = left < 0 ? 0 : left / 64;
+      const uint64_t low = left < 0 ? wide >> -left : wide << (left % 64);
+      see(state, offset + firstWord, low);
+      if (left >= 0 && left % 64 != 0 && firstWord + 1 < state.fogWordsPerRow)
+         see(state, offset + firstWord + 1, wide >> (64 - left % 64));
+   }
+}
+
+void removeVision(GameState& state, int clanIdx, int x, int y, int radius)
+{
+   if (state.fogWordsPerRow == 0 || clanIdx < 0 || clanIdx >= (int)state.clans.size()) return;
+
+   const VisionMask& mask = threadVisionCache().get(state, x, y, radius);
+   uint16_t* counts = &state.fogVisionCount[static_cast<size_t>(clanIdx) * state.width * state.height];
+   for (int dy = -mask.radius; dy <= mask.radius; ++dy)
+   {
+      // Rows off the map have empty masks; skip them before indexing anything
+      const uint32_t seen = mask.rows[dy + mask.radius];
+      if (seen == 0) continue;
+
+      const int row = y + dy;
+      uint16_t* rowCounts = counts + row * state.width;
+      uint64_t* visible = &state.fogVisible[rowOffset(state, clanIdx, row)];
+      for (uint32_t bits = seen; bits != 0; bits &= bits - 1)
+      {
+         const int tx = x - mask.radius + lowestSetBit(bits);
+         if (rowCounts[tx] > 0 && --rowCounts[tx] == 0)
+            visible[tx / 64] &= ~(1ull << (tx % 64));
+      }
+   }
+}
+
+bool isTileExplored(const GameState& state, int clanIdx, int x, int y)
+{
+   if (state.fogWordsPerRow == 0) return true;
+   return (exploredRow(state, clanIdx, y)[x / 64] >> (x % 64)) & 1;
+}
+
+bool isTileVisible(const GameState& state, int clanIdx, int x, int y)
+{
+   if (state.fogWordsPerRow == 0) return true;
+   return (visibleRow(state, clanIdx, y)[x / 64] >> (x % 64)) & 1;
+}
+
+const uint64_t* exploredRow(const GameState& state, int clanIdx, int y)
+{
+   return &state.fogExplored[rowOffset(state, clanIdx, y)];
+}
+
+const uint64_t* visibleRow(const GameState& state, int clanIdx, int y)
+{
+   return &state.fogVisible[rowOffset(state, clanIdx, y)];
+}
@@ -0,0 +1,53 @@
+#ifndef FOG_H
+#define FOG_H
+
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+struct GameState;
+
+// Per-clan fog of war.  Each clan has an explored and a visible layer, one bit per
+// tile; rows are padded to whole 64-bit words so renderers can test 64 tiles at once
+// and skip fully unexplored runs.  Visibility is reference counted per tile (how many
+// of the clan's units and villages see it), so moving a unit only removes its old
+// vision stamp and adds the new one instead of recomputing the map.  Stamps are line
+// of sight masks from threadVisionCache() (see LineOfSight.h); after terrain changes,
+// call VisionCache::onTerrainChanged and then rebuildFog, since old stamps no longer
+// match what would be removed.
+//
+// The layers live in GameState: fogExplored and fogVisible hold fogWordsPerRow words
+// per row for every clan, fogVisionCount one counter per tile per clan.
+
+// Sizes the layers for the current map and clans; everything starts unexplored
+void initFog(GameState& state);
+
+// Recounts visibility from every live unit and village.  Explored tiles stay explored.
+void rebuildFog(GameState& state);
+
+// Adds or removes one vision source.  Every addVision must be matched by a
+// removeVision with the same arguments.
+void addVision(GameState& state, int clanIdx, int x, int y, int radius);
+void removeVision(GameState& state, int clanIdx, int x, int y, int radius);
+
+bool isTileExplored(const GameState& state, int clanIdx, int x, int y);
+bool isTileVisible(const GameState& state, int clanIdx, int x, int y);
+
+// The words covering row y; bit (x % 64) of word (x / 64) is tile x
+const uint64_t* exploredRow(const GameState& state, int clanIdx, int y);
+const uint64_t* visibleRow(const GameState& state, int clanIdx, int y);
+
+// Index of the lowest set bit, for walking the set tiles of a row word; bits must not be 0
+inline int lowestSetBit(uint64_t bits)
+{
+#ifdef _MSC_VER
+   unsigned long index;
+   _BitScanForward64(&index, bits);
+   return static_cast<int>(index);
+#else
+   return __builtin_ctzll(bits);
+#endif
+}
+
+#endif
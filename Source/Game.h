@@ -16,6 +16,31 @@ enum class SpecialAbility
    BUILD_VILLAGE, FLY, CAST_SPELL, BUFF_STACK
 };
 
+// Units store their abilities as a bitmask of these
+constexpr unsigned int abilityBit(SpecialAbility ability) { return 1u << static_cast<int>(ability); }
+
+// Unit types a village can train
+enum class UnitType
+{
+   SETTLER, SPEARMAN, ARCHER, SWORDSMAN, SHAMAN
+};
+const int UNIT_TYPE_COUNT = 5;
+
+// Building types
+enum class BuildingType
+{
+   FARM, LOGGING_CAMP, MINE, WORSHIP_SITE, LIBRARY
+};
+const int BUILDING_TYPE_COUNT = 5;
+
+// Resources produced by villages (food and production stay in the village, the rest go to the clan).
+// Prefixed because raylib #defines GOLD as a color.
+enum class ResourceType
+{
+   RES_FOOD, RES_PRODUCTION, RES_GOLD, RES_KNOWLEDGE, RES_WORSHIP
+};
+const int RESOURCE_TYPE_COUNT = 5;
+
 // Constants
 const int GRID_WIDTH = 74;
 const int GRID_HEIGHT = 46;
@@ -35,7 +60,14 @@ const int CLAN_PANEL_X = MINIMAP_OFFSET_X;
 const int CLAN_PANEL_Y = MINIMAP_OFFSET_Y + GRID_HEIGHT * MINIMAP_CELL_SIZE + 4;
 
 const int MAX_VILLAGE_POPULATION = 8;
+const int MAX_VILLAGE_BUILDINGS = 8; // One per adjacent tile
+const int MAX_BUILD_QUEUE = 8;       // Entries a village can have waiting in its build queue
+const int MAX_NAME_LENGTH = 32;      // Clan and village names, including the terminator
+const int DEFAULT_UNIT_CAPACITY = 4096; // Unit pool slots allocated when a map is generated
 const int FOOD_PER_POP_GROWTH = 10; // Food needed per population point to grow
+const int VILLAGE_VISION_RADIUS = 2; // Tiles a village reveals around itself
+const int MIN_VILLAGE_SPACING = 3;   // Steps from the nearest village needed to found a new one
+const int PLAYER_CLAN = 0;           // The clan the local player controls; fog is drawn from its view
 
 // Base production per village per turn (before buildings)
 const int BASE_FOOD = 1;
@@ -44,4 +76,14 @@ const int BASE_GOLD = 1;
 const int BASE_KNOWLEDGE = 1;
 const int BASE_WORSHIP = 1;
 
+// Bump whenever a rules change would make old replays and saves play out differently
+const unsigned short RULES_VERSION = 1;
+
+// The game autosaves in the background every this many turns, see Autosave.h.
+// history.cdd already keeps every turn; the autosave is the quick way back in.
+const int AUTOSAVE_INTERVAL = 10;
+
+// A clan stockpile crossing a multiple of this raises a RESOURCE_THRESHOLD turn event
+const int RESOURCE_THRESHOLD_STEP = 50;
+
 #endif
\ No newline at end of file
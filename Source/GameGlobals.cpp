@@ -4,9 +4,7 @@
 #include "../Geist/Source/Globals.h"
 #include "../Geist/Source/InputSystem.h"
 
-std::vector<Clan> g_Clans;
-std::vector<SquareTile> g_Map;
-std::vector<Village> g_Villages;
+GameState g_GameState;
 Texture2D g_Tileset{};
 Font g_GameFont{};
 Font g_LargeFont{};
@@ -14,8 +12,13 @@ int g_ViewX = GRID_WIDTH / 2;
 int g_ViewY = GRID_HEIGHT / 2;
 float g_WaterAnimTime = 0.0f;
 int g_WaterFrame = 0;
-int g_CurrentTurn = 1;
-int g_SelectedVillageIdx = -1;
+VillageHandle g_SelectedVillage;
+TurnEventLog g_TurnEvents;
+TurnProfiler g_TurnProfiler;
+ClanAI g_ClanAI;
+ReplayRecorder g_Replay;
+Autosaver g_Autosave;
+DeltaWriter g_History;
 
 float GetRenderMouseX()
 {
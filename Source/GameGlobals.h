@@ -1,8 +1,16 @@
 #ifndef _GAMEGLOBALS_H_
 #define _GAMEGLOBALS_H_
 
+#include "Autosave.h"
 #include "Clan.h"
+#include "ClanAI.h"
+#include "DeltaSave.h"
+#include "GameState.h"
 #include "Map.h"
+#include "Replay.h"
+#include "TurnEvents.h"
+#include "TurnProfiler.h"
+#include "Villages.h"
 
 #include <vector>
 
@@ -12,9 +20,7 @@ enum GameStates
     STATE_LASTSTATE
 };
 
-extern std::vector<Clan> g_Clans;
-extern std::vector<SquareTile> g_Map;
-extern std::vector<Village> g_Villages;
+extern GameState g_GameState;
 extern Texture2D g_Tileset;
 extern Font g_GameFont;
 extern Font g_LargeFont;
@@ -22,8 +28,13 @@ extern int g_ViewX;
 extern int g_ViewY;
 extern float g_WaterAnimTime;
 extern int g_WaterFrame;
-extern int g_CurrentTurn;
-extern int g_SelectedVillageIdx;
+extern VillageHandle g_SelectedVillage;
+extern TurnEventLog g_TurnEvents;
+extern TurnProfiler g_TurnProfiler;
+extern ClanAI g_ClanAI;
+extern ReplayRecorder g_Replay; // The game in progress, saved with F5
+extern Autosaver g_Autosave;
+extern DeltaWriter g_History; // Every turn of the game in progress, in history.cdd
 
 float GetRenderMouseX();
 float GetRenderMouseY();
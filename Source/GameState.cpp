@@ -0,0 +1,92 @@
+#include "GameState.h"
+
+// assign() on a trivially copyable element type is a single memmove, and only
+// allocates when this state's arena is smaller than the source's.
+template <typename T>
+static void copyArena(std::vector<T>& dest, const std::vector<T>& src)
+{
+   dest.assign(src.begin(), src.end());
+}
+
+void GameState::copyFrom(const GameState& other, bool withVisibility)
+{
+   if (this == &other) return;
+
+   width = other.width;
+   height = other.height;
+   currentTurn = other.currentTurn;
+   seed = other.seed;
+   worldHash = other.worldHash;
+   terrainStamp = other.terrainStamp;
+
+   copyArena(map, other.map);
+   copyArena(clans, other.clans);
+   copyArena(villages, other.villages);
+   firstFreeVillage = other.firstFreeVillage;
+   liveVillageCount = other.liveVillageCount;
+   copyArena(queueItems, other.queueItems);
+   firstFreeQueueItem = other.firstFreeQueueItem;
+   copyArena(units, other.units);
+   copyArena(tileFirstUnit, other.tileFirstUnit);
+   firstFreeUnit = other.firstFreeUnit;
+   liveUnitCount = other.liveUnitCount;
+   unitSlotsUsed = other.unitSlotsUsed;
+
+   fogWordsPerRow = other.fogWordsPerRow;
+   copyArena(fogExplored, other.fogExplored);
+   if (withVisibility)
+   {
+      copyArena(fogVisible, other.fogVisible);
+      copyArena(fogVisionCount, other.fogVisionCount);
+   }
+   else
+   {
+      fogVisible.clear();
+      fogVisionCount.clear();
+   }
+   copyArena(territoryOwner, other.territoryOwner);
+   copyArena(territoryDistance, other.territoryDistance);
+}
+
+void GameState::reserve(int tiles, int clanCount, int villageCount)
+{
+   map.reserve(tiles);
+   clans.reserve(clanCount);
+   villages.reserve(villageCount);
+}
+
+void ChangeTracker::clear()
+{
+   for (int k = 0; k < CHANGE_KIND_COUNT; ++k)
+   {
+      for (int idx : indices[k])
+         flags[k][idx] = 0;
+      indices[k].clear();
+   }
+}
+
+void GameState::clear()
+{
+   changes.clear();
+   currentTurn = 1;
+   worldHash = 0;
+   terrainStamp = 0;
+   map.clear();
+   clans.clear();
+   villages.clear();
+   firstFreeVillage = -1;
+   liveVillageCount = 0;
+   queueItems.clear();
+   firstFreeQueueItem = -1;
+   units.clear();
+   tileFirstUnit.clear();
+   firstFreeUnit = -1;
+   liveUnitCount = 0;
+   unitSlotsUsed = 0;
+   fogWordsPerRow = 0;
+   fogExplored.clear();
+   fogVisible.clear();
+   fogVisionCount.clear();
+   territoryOwner.clear();
+   territoryDistance.clear();
+}
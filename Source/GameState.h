@@ -0,0 +1,116 @@
+#ifndef GAMESTATE_H
+#define GAMESTATE_H
+
+#include "Game.h"
+#include "Map.h"
+#include "Clan.h"
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+class TurnEventLog;
+
+// What a ChangeTracker follows.  A TILE covers the tile and its tileFirstUnit entry;
+// a FOG_WORD is one word of fogExplored.
+enum class ChangeKind
+{
+   TILE, CLAN, VILLAGE, QUEUE_ITEM, UNIT, FOG_WORD, COUNT
+};
+
+const int CHANGE_KIND_COUNT = static_cast<int>(ChangeKind::COUNT);
+
+// The entities changed since the tracker was last cleared, for delta saves (see
+// DeltaSave.h).  Each kind keeps a flag per index and the list of flagged indices, so
+// marking is O(1) and clearing costs only what changed.  Mutations mark what they
+// touch next to where they update the world hash, including the pool and list links
+// the hash leaves out.
+struct ChangeTracker
+{
+   bool enabled = false;
+   std::vector<uint8_t> flags[CHANGE_KIND_COUNT];
+   std::vector<int> indices[CHANGE_KIND_COUNT];
+
+   void mark(ChangeKind kind, int idx)
+   {
+      std::vector<uint8_t>& kindFlags = flags[static_cast<int>(kind)];
+      if (idx >= (int)kindFlags.size()) kindFlags.resize(idx + 1, 0);
+      if (kindFlags[idx]) return;
+      kindFlags[idx] = 1;
+      indices[static_cast<int>(kind)].push_back(idx);
+   }
+
+   void clear();
+};
+
+// Everything the simulation needs to play a turn, in one place.  Every element type
+// is trivially copyable, so each vector is a contiguous POD arena and a full copy is
+// one memmove per arena.  copyFrom into a state that already has the capacity (for
+// example a reused AI lookahead or autosave buffer) performs no allocations at all.
+//
+// UI state (view position, selection, fonts) does not belong here.
+struct GameState
+{
+   int width = GRID_WIDTH;
+   int height = GRID_HEIGHT;
+   int currentTurn = 1;
+   unsigned int seed = 0;
+   uint64_t worldHash = 0; // Maintained incrementally, see StateHash.h
+   uint32_t terrainStamp = 0; // Identifies the terrain for cached line of sight, see LineOfSight.h
+
+   std::vector<SquareTile> map;
+   std::vector<Clan> clans;
+   std::vector<Village> villages;  // A pool: razed slots are reused, see Villages.h
+   int firstFreeVillage = -1;
+   int liveVillageCount = 0;
+
+   // Build queue entries for all villages, see BuildQueues.h
+   std::vector<QueueItem> queueItems;
+   int firstFreeQueueItem = -1;
+
+   // Unit pool and per-tile occupancy, see Units.h
+   std::vector<Unit> units;
+   std::vector<int> tileFirstUnit;
+   int firstFreeUnit = -1;
+   int liveUnitCount = 0;
+   int unitSlotsUsed = 0; // Slots from here on have never held a unit, so pool walks can stop here
+
+   // Per-clan fog of war, see Fog.h
+   int fogWordsPerRow = 0;
+   std::vector<uint64_t> fogExplored;
+   std::vector<uint64_t> fogVisible;
+   std::vector<uint16_t> fogVisionCount;
+
+   // Nearest village per tile, see Territory.h
+   std::vector<int> territoryOwner;
+   std::vector<uint16_t> territoryDistance;
+
+   // Off unless a DeltaWriter is recording; copyFrom leaves it alone, so clones never track
+   ChangeTracker changes;
+
+   void markChanged(ChangeKind kind, int idx)
+   {
+      if (changes.enabled) changes.mark(kind, idx);
+   }
+
+   // Where village and territory changes are reported, if anywhere.  Like changes,
+   // copyFrom and clear leave it alone, so AI rollouts and snapshots stay silent.
+   TurnEventLog* events = nullptr;
+
+   int tileIndex(int x, int y) const { return y * width + x; }
+   bool inBounds(int x, int y) const { return x >= 0 && x < width && y >= 0 && y < height; }
+
+   // Without visibility, fogVisible and fogVisionCount are left empty.  They are the
+   // bulk of a large world and can be rebuilt from the units and villages, see
+   // rebuildFog; fogExplored is history and is always copied.
+   void copyFrom(const GameState& other, bool withVisibility = true);
+   void reserve(int tiles, int clanCount, int villageCount);
+   void clear();
+};
+
+static_assert(std::is_trivially_copyable<SquareTile>::value, "SquareTile must stay POD for GameState snapshots");
+static_assert(std::is_trivially_copyable<Clan>::value, "Clan must stay POD for GameState snapshots");
+static_assert(std::is_trivially_copyable<Village>::value, "Village must stay POD for GameState snapshots");
+static_assert(std::is_trivially_copyable<QueueItem>::value, "QueueItem must stay POD for GameState snapshots");
+static_assert(std::is_trivially_copyable<Unit>::value, "Unit must stay POD for GameState snapshots");
+
+#endif
@@ -0,0 +1,540 @@
+#include "HierarchicalPath.h"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+
+// Sides in neighbor() order
+enum { SIDE_LEFT, SIDE_RIGHT, SIDE_TOP, SIDE_BOTTOM };
+
+static int chebyshev(int ax, int ay, int bx, int by)
+{
+   return std::max(std::abs(ax - bx), std::abs(ay - by));
+}
+
+void ClusterSearch::resize(int clusterSize)
+{
+   m_dist.resize(clusterSize * clusterSize);
+   for (auto& bucket : m_buckets)
+      bucket.reserve(clusterSize * clusterSize);
+}
+
+int ClusterSearch::distance(int tileIdx) const
+{
+   const int x = tileIdx % m_mapWidth - m_x0;
+   const int y = tileIdx / m_mapWidth - m_y0;
+   if (x < 0 || x >= m_w || y < 0 || y >= m_h) return FLOW_UNREACHABLE;
+   return m_dist[y * m_w + x];
+}
+
+void ClusterSearch::run(const MovementCostGrid& grid, MovementClass movement, const Cluster& cluster, int sourceIdx, bool backward)
+{
+   m_mapWidth = grid.width();
+   m_x0 = cluster.x0;
+   m_y0 = cluster.y0;
+   m_w = cluster.x1 - cluster.x0;
+   m_h = cluster.y1 - cluster.y0;
+   std::fill(m_dist.begin(), m_dist.begin() + m_w * m_h, FLOW_UNREACHABLE);
+   for (auto& bucket : m_buckets)
+      bucket.clear();
+
+   const int sx = sourceIdx % m_mapWidth - m_x0;
+   const int sy = sourceIdx / m_mapWidth - m_y0;
+   if (backward && grid.cost(movement, sourceIdx) == 0) return;
+
+   // Same bucket queue as FlowFieldCache::build; entry costs are 1..3
+   m_dist[sy * m_w + sx] = 0;
+   m_buckets[0].push_back(sy * m_w + sx);
+   int pending = 1;
+
+   for (int d = 0; pending > 0; ++d)
+   {
+      std::vector<int>& bucket = m_buckets[d & 3];
+      for (size_t i = 0; i < bucket.size(); ++i)
+      {
+         const int local = bucket[i];
+         --pending;
+         if (m_dist[local] != d) continue;
+
+         const int lx = local % m_w;
+         const int ly = local / m_w;
+         const int enterCost = backward ? grid.cost(movement, (ly + m_y0) * m_mapWidth + lx + m_x0) : 0;
+         for (int n = 0; n < 8; ++n)
+         {
+            const int nx = lx + NEIGHBOR_DX[n];
+            const int ny = ly + NEIGHBOR_DY[n];
+            if (nx < 0 || nx >= m_w || ny < 0 || ny >= m_h) continue;
+
+            const int stepCost = grid.cost(movement, (ny + m_y0) * m_mapWidth + nx + m_x0);
+            if (stepCost == 0) continue;
+
+            const int candidate = d + (backward ? enterCost : stepCost);
+            const int next = ny * m_w + nx;
+            if (candidate < m_dist[next])
+            {
+               m_dist[next] = candidate;
+               m_buckets[candidate & 3].push_back(next);
+               ++pending;
+            }
+         }
+      }
+      bucket.clear();
+   }
+}
+
+void ClusterGraph::build(const MovementCostGrid& grid, int clusterSize)
+{
+   m_width = grid.width();
+   m_height = grid.height();
+   m_clusterSize = clusterSize;
+   m_clustersX = (m_width + clusterSize - 1) / clusterSize;
+   m_clustersY = (m_height + clusterSize - 1) / clusterSize;
+   m_search.resize(clusterSize);
+
+   for (int m = 0; m < MOVEMENT_CLASS_COUNT; ++m)
+   {
+      const MovementClass movement = static_cast<MovementClass>(m);
+      std::vector<Cluster>& clusters = m_clusters[m];
+      clusters.assign(clusterCount(), Cluster());
+      for (int cy = 0; cy < m_clustersY; ++cy)
+      {
+         for (int cx = 0; cx < m_clustersX; ++cx)
+         {
+            Cluster& cluster = clusters[cy * m_clustersX + cx];
+            cluster.x0 = cx * clusterSize;
+            cluster.y0 = cy * clusterSize;
+            cluster.x1 = std::min(cluster.x0 + clusterSize, m_width);
+            cluster.y1 = std::min(cluster.y0 + clusterSize, m_height);
+         }
+      }
+
+      for (int c = 0; c < clusterCount(); ++c)
+         rebuildNodes(grid, movement, c);
+      for (int c = 0; c < clusterCount(); ++c)
+      {
+         relink(grid, movement, c);
+         rebuildDistances(grid, movement, c);
+      }
+   }
+}
+
+void ClusterGraph::onTileChanged(const MovementCostGrid& grid, int idx)
+{
+   const int c = clusterAt(idx % m_width, idx / m_width);
+
+   for (int m = 0; m < MOVEMENT_CLASS_COUNT; ++m)
+   {
+      const MovementClass movement = static_cast<MovementClass>(m);
+
+      // A tile only affects the borders of its own cluster, but those borders also
+      // hold the neighbours' entrances.
+      int touched[5] = { c, -1, -1, -1, -1 };
+      for (int side = 0; side < 4; ++side)
+         touched[side + 1] = neighbor(c, side);
+
+      for (int t : touched)
+         if (t >= 0) rebuildNodes(grid, movement, t);
+
+      // Rebuilt clusters renumbered their nodes, so the clusters around them need
+      // their partner links redone too.
+      for (int t : touched)
+      {
+         if (t < 0) continue;
+         relink(grid, movement, t);
+         for (int side = 0; side < 4; ++side)
+         {
+            const int outer = neighbor(t, side);
+            if (outer >= 0) relink(grid, movement, outer);
+         }
+      }
+
+      for (int t : touched)
+         if (t >= 0) rebuildDistances(grid, movement, t);
+   }
+}
+
+void ClusterGraph::addLandmark(const MovementCostGrid& grid, int idx)
+{
+   const int c = clusterAt(idx % m_width, idx / m_width);
+   for (int m = 0; m < MOVEMENT_CLASS_COUNT; ++m)
+   {
+      Cluster& cluster = m_clusters[m][c];
+      if (std::find(cluster.landmarks.begin(), cluster.landmarks.end(), idx) != cluster.landmarks.end()) return;
+
+      cluster.landmarks.push_back(idx);
+      cluster.landmarkDist.resize(cluster.landmarks.size() * cluster.nodes.size());
+      rebuildLandmark(grid, static_cast<MovementClass>(m), c, static_cast<int>(cluster.landmarks.size()) - 1);
+   }
+}
+
+void ClusterGraph::removeLandmark(int idx)
+{
+   const int c = clusterAt(idx % m_width, idx / m_width);
+   for (int m = 0; m < MOVEMENT_CLASS_COUNT; ++m)
+   {
+      Cluster& cluster = m_clusters[m][c];
+      const auto found = std::find(cluster.landmarks.begin(), cluster.landmarks.end(), idx);
+      if (found == cluster.landmarks.end()) return;
+
+      // Move the last landmark (and its row of distances) into the gap
+      const int l = static_cast<int>(found - cluster.landmarks.begin());
+      const int last = static_cast<int>(cluster.landmarks.size()) - 1;
+      const size_t count = cluster.nodes.size();
+      cluster.landmarks[l] = cluster.landmarks[last];
+      std::copy(cluster.landmarkDist.begin() + last * count, cluster.landmarkDist.begin() + (last + 1) * count,
+         cluster.landmarkDist.begin() + l * count);
+      cluster.landmarks.pop_back();
+      cluster.landmarkDist.resize(cluster.landmarks.size() * count);
+   }
+}
+
+int ClusterGraph::neighbor(int c, int side) const
+{
+   const int cx = c % m_clustersX;
+   const int cy = c / m_clustersX;
+   switch (side)
+   {
+   case SIDE_LEFT:   return cx > 0 ? c - 1 : -1;
+   case SIDE_RIGHT:  return cx + 1 < m_clustersX ? c + 1 : -1;
+   case SIDE_TOP:    return cy > 0 ? c - m_clustersX : -1;
+   case SIDE_BOTTOM: return cy + 1 < m_clustersY ? c + m_clustersX : -1;
+   }
+   return -1;
+}
+
+void ClusterGraph::rebuildNodes(const MovementCostGrid& grid, MovementClass movement, int c)
+{
+   m_clusters[static_cast<int>(movement)][c].nodes.clear();
+   for (int side = 0; side < 4; ++side)
+   {
+      const int other = neighbor(c, side);
+      if (other >= 0) addBorder(grid, movement, c, other);
+   }
+}
+
+void ClusterGraph::addBorder(const MovementCostGrid& grid, MovementClass movement, int c, int other)
+{
+   std::vector<Cluster>& clusters = m_clusters[static_cast<int>(movement)];
+   Cluster& cluster = clusters[c];
+
+   // Walk the border from the left/top cluster's point of view so both sides agree
+   // on where the entrances go.
+   const bool ownFirst = other > c;
+   const Cluster& first = ownFirst ? cluster : clusters[other];
+   const bool vertical = first.x1 == (ownFirst ? clusters[other] : cluster).x0;
+   const int length = vertical ? first.y1 - first.y0 : first.x1 - first.x0;
+
+   auto tileA = [&](int i) { return vertical ? (first.y0 + i) * m_width + first.x1 - 1 : (first.y1 - 1) * m_width + first.x0 + i; };
+   auto tileB = [&](int i) { return vertical ? (first.y0 + i) * m_width + first.x1 : first.y1 * m_width + first.x0 + i; };
+
+   auto addEntrance = [&](int i)
+   {
+      ClusterNode node;
+      node.tile = ownFirst ? tileA(i) : tileB(i);
+      node.partnerTile = ownFirst ? tileB(i) : tileA(i);
+      node.partnerCluster = other;
+      node.partnerNode = -1;
+      node.crossCost = grid.cost(movement, node.partnerTile);
+      if ((int)cluster.nodes.size() < maxNodesPerCluster()) cluster.nodes.push_back(node);
+   };
+
+   int runStart = -1;
+   for (int i = 0; i <= length; ++i)
+   {
+      const bool open = i < length && grid.cost(movement, tileA(i)) != 0 && grid.cost(movement, tileB(i)) != 0;
+      if (open && runStart < 0)
+      {
+         runStart = i;
+      }
+      else if (!open && runStart >= 0)
+      {
+         const int runLength = i - runStart;
+         if (runLength < ENTRANCE_SPLIT_LENGTH)
+         {
+            addEntrance(runStart + runLength / 2);
+         }
+         else
+         {
+            addEntrance(runStart);
+            addEntrance(i - 1);
+         }
+         runStart = -1;
+      }
+   }
+}
+
+void ClusterGraph::relink(const MovementCostGrid& grid, MovementClass movement, int c)
+{
+   std::vector<Cluster>& clusters = m_clusters[static_cast<int>(movement)];
+   for (auto& node : clusters[c].nodes)
+   {
+      const std::vector<ClusterNode>& others = clusters[node.partnerCluster].nodes;
+      node.partnerNode = -1;
+      for (int j = 0; j < (int)others.size(); ++j)
+      {
+         if (others[j].tile == node.partnerTile && others[j].partnerTile == node.tile)
+         {
+            node.partnerNode = j;
+            break;
+         }
+      }
+      node.crossCost = grid.cost(movement, node.partnerTile);
+   }
+}
+
+void ClusterGraph::rebuildDistances(const MovementCostGrid& grid, MovementClass movement, int c)
+{
+   Cluster& cluster = m_clusters[static_cast<int>(movement)][c];
+   const int count = static_cast<int>(cluster.nodes.size());
+   cluster.dist.resize(count * count);
+   for (int i = 0; i < count; ++i)
+   {
+      m_search.run(grid, movement, cluster, cluster.nodes[i].tile, false);
+      for (int j = 0; j < count; ++j)
+         cluster.dist[i * count + j] = m_search.distance(cluster.nodes[j].tile);
+   }
+
+   cluster.landmarkDist.resize(cluster.landmarks.size() * count);
+   for (int l = 0; l < (int)cluster.landmarks.size(); ++l)
+      rebuildLandmark(grid, movement, c, l);
+}
+
+void ClusterGraph::rebuildLandmark(const MovementCostGrid& grid, MovementClass movement, int c, int l)
+{
+   // One backward search from the landmark reaches every entrance, as when planPath
+   // attaches a goal
+   Cluster& cluster = m_clusters[static_cast<int>(movement)][c];
+   const int count = static_cast<int>(cluster.nodes.size());
+   m_search.run(grid, movement, cluster, cluster.landmarks[l], true);
+   for (int i = 0; i < count; ++i)
+      cluster.landmarkDist[l * count + i] = m_search.distance(cluster.nodes[i].tile);
+}
+
+void HierarchicalPathfinder::resize(const ClusterGraph& graph, int width, int height)
+{
+   m_nodesPerCluster = graph.maxNodesPerCluster();
+   const int ids = graph.clusterCount() * m_nodesPerCluster + 2;
+   m_startId = ids - 2;
+   m_goalId = ids - 1;
+
+   m_g.assign(ids, 0);
+   m_parent.assign(ids, -1);
+   m_stamp.assign(ids, 0);
+   m_closed.assign(ids, 0);
+   m_open.clear();
+   m_open.reserve(ids);
+   m_goalDist.assign(m_nodesPerCluster, FLOW_UNREACHABLE);
+   m_waypoints.resize(ids);
+   m_search = 0;
+
+   m_local.resize(graph.clusterSize());
+   m_refiner.resize(width, height);
+}
+
+void HierarchicalPathfinder::relax(int id, int g, int h, int parent)
+{
+   if (m_stamp[id] != m_search)
+   {
+      m_stamp[id] = m_search;
+      m_closed[id] = 0;
+   }
+   else if (m_closed[id] || g >= m_g[id])
+   {
+      return;
+   }
+   m_g[id] = g;
+   m_parent[id] = parent;
+   m_open.emplace_back(g + h, id);
+   std::push_heap(m_open.begin(), m_open.end(), std::greater<std::pair<int, int>>());
+}
+
+int HierarchicalPathfinder::planPath(const ClusterGraph& graph, const MovementCostGrid& grid, MovementClass movement,
+   int startX, int startY, int goalX, int goalY, PathStep* out, int maxWaypoints, int* totalCost)
+{
+   m_expanded = 0;
+   if (totalCost) *totalCost = 0;
+   const int width = grid.width();
+   if (startX < 0 || startX >= width || startY < 0 || startY >= grid.height()) return -1;
+   if (goalX < 0 || goalX >= width || goalY < 0 || goalY >= grid.height()) return -1;
+   if (startX == goalX && startY == goalY) return 0;
+
+   const int start = startY * width + startX;
+   const int goal = goalY * width + goalX;
+   if (grid.cost(movement, goal) == 0) return -1;
+
+   const int startCluster = graph.clusterAt(startX, startY);
+   const int goalCluster = graph.clusterAt(goalX, goalY);
+   const Cluster& first = graph.cluster(movement, startCluster);
+   const Cluster& last = graph.cluster(movement, goalCluster);
+
+   // Short hops inside one cluster never touch the abstract graph
+   if (startCluster == goalCluster)
+   {
+      m_local.run(grid, movement, first, start, false);
+      const int direct = m_local.distance(goal);
+      if (direct != FLOW_UNREACHABLE && maxWaypoints >= 1)
+      {
+         out[0].x = goalX;
+         out[0].y = goalY;
+         if (totalCost) *totalCost = direct;
+         return 1;
+      }
+   }
+
+   if (++m_search == 0)
+   {
+      std::fill(m_stamp.begin(), m_stamp.end(), 0);
+      m_search = 1;
+   }
+   m_open.clear();
+
+   // Attach the goal: cost from each of its cluster's entrances to the goal tile,
+   // already known if the goal is a landmark
+   const int goalCount = static_cast<int>(last.nodes.size());
+   const auto landmark = std::find(last.landmarks.begin(), last.landmarks.end(), goal);
+   if (landmark != last.landmarks.end())
+   {
+      const int l = static_cast<int>(landmark - last.landmarks.begin());
+      std::copy(last.landmarkDist.begin() + l * goalCount, last.landmarkDist.begin() + (l + 1) * goalCount, m_goalDist.begin());
+   }
+   else
+   {
+      m_local.run(grid, movement, last, goal, true);
+      for (int j = 0; j < goalCount; ++j)
+         m_goalDist[j] = m_local.distance(last.nodes[j].tile);
+   }
+
+   // Attach the start and seed the open list with its cluster's entrances
+   m_stamp[m_startId] = m_search;
+   m_g[m_startId] = 0;
+   m_closed[m_startId] = 1;
+   m_local.run(grid, movement, first, start, false);
+   for (int i = 0; i < (int)first.nodes.size(); ++i)
+   {
+      const int d = m_local.distance(first.nodes[i].tile);
+      if (d == FLOW_UNREACHABLE) continue;
+      const ClusterNode& node = first.nodes[i];
+      relax(startCluster * m_nodesPerCluster + i, d, chebyshev(node.tile % width, node.tile / width, goalX, goalY), m_startId);
+   }
+
+   bool found = false;
+   while (!m_open.empty())
+   {
+      std::pop_heap(m_open.begin(), m_open.end(), std::greater<std::pair<int, int>>());
+      const int id = m_open.back().second;
+      m_open.pop_back();
+      if (m_closed[id]) continue;
+      m_closed[id] = 1;
+      if (id == m_goalId)
+      {
+         found = true;
+         break;
+      }
+      ++m_expanded;
+
+      const int c = id / m_nodesPerCluster;
+      const int i = id % m_nodesPerCluster;
+      const Cluster& cluster = graph.cluster(movement, c);
+      const int count = static_cast<int>(cluster.nodes.size());
+      const ClusterNode& node = cluster.nodes[i];
+      const int g = m_g[id];
+
+      for (int j = 0; j < count; ++j)
+      {
+         const int d = cluster.dist[i * count + j];
+         if (j == i || d == FLOW_UNREACHABLE) continue;
+         const int tile = cluster.nodes[j].tile;
+         relax(c * m_nodesPerCluster + j, g + d, chebyshev(tile % width, tile / width, goalX, goalY), id);
+      }
+
+      if (node.partnerNode >= 0 && node.crossCost != 0)
+      {
+         relax(node.partnerCluster * m_nodesPerCluster + node.partnerNode, g + node.crossCost,
+            chebyshev(node.partnerTile % width, node.partnerTile / width, goalX, goalY), id);
+      }
+
+      if (c == goalCluster && m_goalDist[i] != FLOW_UNREACHABLE)
+         relax(m_goalId, g + m_goalDist[i], 0, id);
+   }
+
+   if (!found) return -1;
+
+   // Walk back to the start twice: once to count, once to fill out back to front.
+   // Entrances that sit on the previous tile add nothing and are dropped.
+   auto nodeTile = [&](int id)
+   {
+      return id == m_goalId ? goal : graph.cluster(movement, id / m_nodesPerCluster).nodes[id % m_nodesPerCluster].tile;
+   };
+
+   int count = 0;
+   int previousTile = -1;
+   for (int id = m_goalId; id != m_startId; id = m_parent[id])
+   {
+      const int tile = nodeTile(id);
+      if (tile == previousTile || tile == start) continue;
+      ++count;
+      previousTile = tile;
+   }
+   if (count > maxWaypoints) return -1;
+
+   int pos = count;
+   previousTile = -1;
+   for (int id = m_goalId; id != m_startId; id = m_parent[id])
+   {
+      const int tile = nodeTile(id);
+      if (tile == previousTile || tile == start) continue;
+      --pos;
+      out[pos].x = tile % width;
+      out[pos].y = tile / width;
+      previousTile = tile;
+   }
+   if (totalCost) *totalCost = m_g[m_goalId];
+   return count;
+}
+
+int HierarchicalPathfinder::refineSegment(const ClusterGraph& graph, const MovementCostGrid& grid, MovementClass movement,
+   int fromX, int fromY, int toX, int toY, PathStep* out, int maxSteps, int* cost)
+{
+   const int fromCluster = graph.clusterAt(fromX, fromY);
+   if (fromCluster != graph.clusterAt(toX, toY))
+   {
+      // A border crossing: the two entrance tiles are adjacent
+      if (maxSteps < 1) return -1;
+      out[0].x = toX;
+      out[0].y = toY;
+      if (cost) *cost = grid.cost(movement, toY * grid.width() + toX);
+      return 1;
+   }
+
+   const Cluster& cluster = graph.cluster(movement, fromCluster);
+   m_refiner.setBounds(cluster.x0, cluster.y0, cluster.x1, cluster.y1);
+   const int steps = m_refiner.findPath(grid, movement, fromX, fromY, toX, toY, out, maxSteps, cost);
+   m_refiner.clearBounds();
+   return steps;
+}
+
+int HierarchicalPathfinder::findPath(const ClusterGraph& graph, const MovementCostGrid& grid, MovementClass movement,
+   int startX, int startY, int goalX, int goalY, PathStep* out, int maxSteps, int* totalCost)
+{
+   if (totalCost) *totalCost = 0;
+   const int waypoints = planPath(graph, grid, movement, startX, startY, goalX, goalY,
+      m_waypoints.data(), static_cast<int>(m_waypoints.size()), nullptr);
+   if (waypoints < 0) return -1;
+
+   int length = 0;
+   int cost = 0;
+   int x = startX;
+   int y = startY;
+   for (int w = 0; w < waypoints; ++w)
+   {
+      int legCost = 0;
+      const PathStep to = m_waypoints[w];
+      const int steps = refineSegment(graph, grid, movement, x, y, to.x, to.y, out + length, maxSteps - length, &legCost);
+      if (steps < 0) return -1;
+      length += steps;
+      cost += legCost;
+      x = to.x;
+      y = to.y;
+   }
+   if (totalCost) *totalCost = cost;
+   return length;
+}
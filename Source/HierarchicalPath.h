@@ -0,0 +1,143 @@
+#ifndef HIERARCHICALPATH_H
+#define HIERARCHICALPATH_H
+
+#include "FlowFields.h"
+#include "Pathfinding.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+const int DEFAULT_CLUSTER_SIZE = 32;
+const int ENTRANCE_SPLIT_LENGTH = 6; // Border openings this long get an entrance at each end instead of one in the middle
+
+// One side of a border crossing.  The partner is the matching node in the
+// neighbouring cluster; stepping onto it costs crossCost.
+struct ClusterNode
+{
+   int tile;
+   int partnerTile;
+   int partnerCluster;
+   int partnerNode;
+   int crossCost;
+};
+
+// A square map sector and its entrances.  dist[i * nodes.size() + j] is the cheapest
+// cost from node i to node j without leaving the cluster, or FLOW_UNREACHABLE.
+// Landmarks are goal tiles worth attaching ahead of time (villages):
+// landmarkDist[l * nodes.size() + i] is the cost from node i to landmark l.
+struct Cluster
+{
+   int x0, y0, x1, y1; // Inclusive min, exclusive max
+   std::vector<ClusterNode> nodes;
+   std::vector<int> dist;
+   std::vector<int> landmarks;
+   std::vector<int> landmarkDist;
+};
+
+// Dijkstra confined to one cluster rectangle, used for entrance distances and to
+// attach a query's start and goal to the abstract graph.
+class ClusterSearch
+{
+public:
+   void resize(int clusterSize);
+
+   // Forward: cost from the source to each tile.  Backward: cost from each tile to the source.
+   void run(const MovementCostGrid& grid, MovementClass movement, const Cluster& cluster, int sourceIdx, bool backward);
+   int distance(int tileIdx) const;
+
+private:
+   int m_mapWidth = 0;
+   int m_x0 = 0, m_y0 = 0, m_w = 0, m_h = 0;
+   std::vector<int> m_dist;
+   std::vector<int> m_buckets[4];
+};
+
+// The abstract graph for HPA*: the map is cut into fixed-size clusters, entrances
+// are placed along the open stretches of every border, and the distances between a
+// cluster's entrances are precomputed.  There is one graph per movement class.  A
+// terrain change rebuilds only the cluster holding the tile and its four neighbours;
+// adding or removing a landmark only redoes that landmark's distances.
+class ClusterGraph
+{
+public:
+   // Drops every landmark
+   void build(const MovementCostGrid& grid, int clusterSize = DEFAULT_CLUSTER_SIZE);
+
+   // Call after the grid has been updated for the tile
+   void onTileChanged(const MovementCostGrid& grid, int idx);
+
+   // Paths to a landmark skip the search that attaches the goal to the graph
+   void addLandmark(const MovementCostGrid& grid, int idx);
+   void removeLandmark(int idx);
+
+   int clusterSize() const { return m_clusterSize; }
+   int clusterCount() const { return m_clustersX * m_clustersY; }
+   int maxNodesPerCluster() const { return m_clusterSize * 4; }
+   int clusterAt(int x, int y) const { return (y / m_clusterSize) * m_clustersX + x / m_clusterSize; }
+   const Cluster& cluster(MovementClass movement, int c) const { return m_clusters[static_cast<int>(movement)][c]; }
+
+private:
+   void rebuildNodes(const MovementCostGrid& grid, MovementClass movement, int c);
+   void addBorder(const MovementCostGrid& grid, MovementClass movement, int c, int other);
+   void rebuildDistances(const MovementCostGrid& grid, MovementClass movement, int c);
+   void relink(const MovementCostGrid& grid, MovementClass movement, int c);
+   void rebuildLandmark(const MovementCostGrid& grid, MovementClass movement, int c, int l);
+   int neighbor(int c, int side) const;
+
+   int m_width = 0;
+   int m_height = 0;
+   int m_clusterSize = DEFAULT_CLUSTER_SIZE;
+   int m_clustersX = 0;
+   int m_clustersY = 0;
+   std::vector<Cluster> m_clusters[MOVEMENT_CLASS_COUNT];
+   ClusterSearch m_search;
+};
+
+// Plans long paths on a ClusterGraph and refines them one cluster at a time.  A plan
+// is a list of waypoints (entrances and the goal); refineSegment turns the leg to the
+// next waypoint into tile steps with a Pathfinder bounded to that cluster, so a unit
+// only pays for the part of the route it is about to walk.  Scratch memory is sized
+// by resize() and reused.  Not thread-safe: give each thread its own.
+class HierarchicalPathfinder
+{
+public:
+   void resize(const ClusterGraph& graph, int width, int height);
+
+   // Writes the waypoints after the start into out.  Returns the count, or -1 if
+   // there is no path or it does not fit.  totalCost is the cost of the refined path.
+   int planPath(const ClusterGraph& graph, const MovementCostGrid& grid, MovementClass movement,
+      int startX, int startY, int goalX, int goalY, PathStep* out, int maxWaypoints, int* totalCost = nullptr);
+
+   // Tile steps from one waypoint (or the start) to the next; same contract as Pathfinder::findPath
+   int refineSegment(const ClusterGraph& graph, const MovementCostGrid& grid, MovementClass movement,
+      int fromX, int fromY, int toX, int toY, PathStep* out, int maxSteps, int* cost = nullptr);
+
+   // planPath followed by refining every segment
+   int findPath(const ClusterGraph& graph, const MovementCostGrid& grid, MovementClass movement,
+      int startX, int startY, int goalX, int goalY, PathStep* out, int maxSteps, int* totalCost = nullptr);
+
+   // Abstract nodes expanded by the last planPath, for profiling
+   int lastExpanded() const { return m_expanded; }
+
+private:
+   void relax(int id, int g, int h, int parent);
+
+   int m_nodesPerCluster = 0;
+   int m_startId = 0;
+   int m_goalId = 0;
+
+   std::vector<int> m_g;
+   std::vector<int> m_parent;
+   std::vector<uint32_t> m_stamp;
+   std::vector<uint8_t> m_closed;
+   std::vector<std::pair<int, int>> m_open; // (f, node id), a lazy min-heap
+   std::vector<int> m_goalDist;
+   std::vector<PathStep> m_waypoints; // findPath's plan
+   uint32_t m_search = 0;
+   int m_expanded = 0;
+
+   ClusterSearch m_local;
+   Pathfinder m_refiner;
+};
+
+#endif
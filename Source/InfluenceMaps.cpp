@@ -0,0 +1,214 @@
+#include "InfluenceMaps.h"
+#include "GameState.h"
+#include "WorkerPool.h"
+#include <algorithm>
+
+// Building sites a tile offers: farms and libraries on grassland, logging camps in
+// forest, mines and worship sites on hills
+static float siteValue(Terrain terrain)
+{
+   switch (terrain)
+   {
+   case Terrain::GRASSLAND: return 2.0f;
+   case Terrain::FOREST:    return 1.0f;
+   case Terrain::HILLS:     return 2.0f;
+   default:                 return 0.0f;
+   }
+}
+
+void InfluenceMaps::resize(int width, int height, int clanCount, int workers)
+{
+   m_width = width;
+   m_height = height;
+   m_clanCount = clanCount;
+   const size_t tiles = static_cast<size_t>(width) * height;
+
+   m_strengthSources.resize(clanCount);
+   m_yieldSources.resize(clanCount);
+   m_threat.assign(clanCount, std::vector<float>());
+   m_opportunity.assign(clanCount, std::vector<float>());
+   m_totalStrength.assign(tiles, 0.0f);
+   m_totalYield.assign(tiles, 0.0f);
+   m_resources.assign(tiles, 0.0f);
+   m_hasResources = false;
+
+   // After the grid: one row of running column sums, then one zero-padded source row
+   const int scratchCount = workers < 1 ? 1 : workers;
+   m_scratch.assign(scratchCount, std::vector<float>(tiles + width + width + 2 * INFLUENCE_RADIUS + 1, 0.0f));
+   m_strength.assign(scratchCount, std::vector<float>(tiles, 0.0f));
+   m_yield.assign(scratchCount, std::vector<float>(tiles, 0.0f));
+}
+
+const float* InfluenceMaps::layer(InfluenceLayer layer, int clanIdx) const
+{
+   switch (layer)
+   {
+   case InfluenceLayer::THREAT:      return m_threat[clanIdx].data();
+   case InfluenceLayer::OPPORTUNITY: return m_opportunity[clanIdx].data();
+   case InfluenceLayer::RESOURCES:   return m_resources.data();
+   }
+   return m_resources.data();
+}
+
+void InfluenceMaps::blur(std::vector<float>& grid, int worker)
+{
+   const int w = m_width;
+   const int h = m_height;
+   const int r = INFLUENCE_RADIUS;
+   float* rows = m_scratch[worker].data();
+   float* acc = rows + static_cast<size_t>(w) * h;
+   float* padded = acc + w; // r zeros, the row, r + 1 zeros
+
+   for (int pass = 0; pass < INFLUENCE_BLUR_PASSES; ++pass)
+   {
+      // Row pass, grid -> scratch: a running sum over [x - r, x + r].  Copying the row
+      // between zero pads keeps the edge handling out of the loop.
+      for (int y = 0; y < h; ++y)
+      {
+         std::copy_n(&grid[static_cast<size_t>(y) * w], w, padded + r);
+         float* dst = rows + static_cast<size_t>(y) * w;
+         float sum = 0.0f;
+         for (int x = 0; x < 2 * r; ++x)
+            sum += padded[x];
+         for (int x = 0; x < w; ++x)
+         {
+            sum += padded[x + 2 * r];
+            dst[x] = sum;
+            sum -= padded[x];
+         }
+      }
+
+      // Column pass, scratch -> grid: the same running sum, but a whole row of sums
+      // moves at once, so every inner loop is a straight run over contiguous floats
+      std::fill(acc, acc + w, 0.0f);
+      for (int y = 0; y <= r && y < h; ++y)
+      {
+         const float* src = rows + static_cast<size_t>(y) * w;
+         for (int x = 0; x < w; ++x)
+            acc[x] += src[x];
+      }
+      for (int y = 0; y < h; ++y)
+      {
+         float* dst = &grid[static_cast<size_t>(y) * w];
+         for (int x = 0; x < w; ++x)
+            dst[x] = acc[x];
+         if (y + r + 1 < h)
+         {
+            const float* add = rows + static_cast<size_t>(y + r + 1) * w;
+            for (int x = 0; x < w; ++x)
+               acc[x] += add[x];
+         }
+         if (y - r >= 0)
+         {
+            const float* sub = rows + static_cast<size_t>(y - r) * w;
+            for (int x = 0; x < w; ++x)
+               acc[x] -= sub[x];
+         }
+      }
+   }
+}
+
+void InfluenceMaps::update(const GameState& state, WorkerPool* pool)
+{
+   updateShared(state, pool);
+
+   auto clanJob = [&](int c, int worker) { updateClan(c, worker); };
+   if (pool && pool->workerCount() <= (int)m_scratch.size())
+      pool->parallelFor(m_clanCount, clanJob);
+   else
+      for (int c = 0; c < m_clanCount; ++c)
+         clanJob(c, 0);
+}
+
+void InfluenceMaps::updateShared(const GameState& state, WorkerPool* pool)
+{
+   const int clanCount = static_cast<int>(state.clans.size());
+   if (state.width != m_width || state.height != m_height || clanCount != m_clanCount)
+      resize(state.width, state.height, clanCount, static_cast<int>(m_scratch.size()));
+
+   // Gather the raw inputs: straight into the totals, and into short per-clan lists
+   // that updateClan scatters, so this pass costs the same however many clans there are
+   for (int c = 0; c < clanCount; ++c)
+   {
+      m_strengthSources[c].clear();
+      m_yieldSources[c].clear();
+   }
+   std::fill(m_totalStrength.begin(), m_totalStrength.end(), 0.0f);
+   std::fill(m_totalYield.begin(), m_totalYield.end(), 0.0f);
+
+   for (int slot = 0; slot < state.unitSlotsUsed; ++slot)
+   {
+      const Unit& unit = state.units[slot];
+      if (!unit.alive || unit.clanIdx < 0 || unit.clanIdx >= clanCount) continue;
+      const int idx = state.tileIndex(unit.x, unit.y);
+      const float strength = static_cast<float>(unit.attackStrength + unit.defenseStrength);
+      m_totalStrength[idx] += strength;
+      m_strengthSources[unit.clanIdx].push_back({ idx, strength });
+   }
+
+   for (const auto& village : state.villages)
+   {
+      if (village.clanIdx < 0 || village.clanIdx >= clanCount) continue;
+      const int idx = state.tileIndex(village.x, village.y);
+      const float yield = static_cast<float>(village.foodProduction + village.productionOutput + village.goldOutput
+         + village.knowledgeOutput + village.worshipOutput);
+      m_totalYield[idx] += yield;
+      m_yieldSources[village.clanIdx].push_back({ idx, yield });
+   }
+
+   const bool resources = !m_hasResources || m_resourcesStamp != state.terrainStamp;
+   if (resources)
+   {
+      const size_t tiles = m_resources.size();
+      for (size_t i = 0; i < tiles; ++i)
+         m_resources[i] = siteValue(state.map[i].terrain);
+      m_resourcesStamp = state.terrainStamp;
+      m_hasResources = true;
+   }
+
+   auto blurJob = [&](int item, int worker)
+   {
+      if (item == 0) blur(m_totalStrength, worker);
+      else if (item == 1) blur(m_totalYield, worker);
+      else blur(m_resources, worker);
+   };
+   const int blurs = resources ? 3 : 2;
+   if (pool && pool->workerCount() <= (int)m_scratch.size())
+      pool->parallelFor(blurs, blurJob);
+   else
+      for (int i = 0; i < blurs; ++i)
+         blurJob(i, 0);
+}
+
+void InfluenceMaps::updateClan(int clanIdx, int worker)
+{
+   std::vector<float>& strength = m_strength[worker];
+   std::vector<float>& yield = m_yield[worker];
+   std::fill(strength.begin(), strength.end(), 0.0f);
+   std::fill(yield.begin(), yield.end(), 0.0f);
+   for (const Source& source : m_strengthSources[clanIdx])
+      strength[source.idx] += source.value;
+   for (const Source& source : m_yieldSources[clanIdx])
+      yield[source.idx] += source.value;
+
+   // Blurring is linear, so "everyone but me" is blur(total) - blur(mine): one blur per
+   // input instead of one per clan pair
+   blur(strength, worker);
+   blur(yield, worker);
+
+   const size_t tiles = strength.size();
+   m_threat[clanIdx].resize(tiles);
+   m_opportunity[clanIdx].resize(tiles);
+   const float* total = m_totalStrength.data();
+   const float* own = strength.data();
+   const float* totalYield = m_totalYield.data();
+   const float* ownYield = yield.data();
+   float* threat = m_threat[clanIdx].data();
+   float* opportunity = m_opportunity[clanIdx].data();
+   for (size_t i = 0; i < tiles; ++i)
+   {
+      // Running sums leave rounding crumbs around zero, so clamp
+      threat[i] = std::max(total[i] - own[i], 0.0f);
+      opportunity[i] = std::max(totalYield[i] - ownYield[i] - threat[i], 0.0f);
+   }
+}
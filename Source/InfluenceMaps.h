@@ -0,0 +1,81 @@
+#ifndef INFLUENCEMAPS_H
+#define INFLUENCEMAPS_H
+
+#include <cstdint>
+#include <vector>
+
+struct GameState;
+class WorkerPool;
+
+const int INFLUENCE_RADIUS = 4;      // Box radius of each blur pass
+const int INFLUENCE_BLUR_PASSES = 2; // Two box passes give a tent falloff, close enough to a Gaussian here
+
+// What the AI reads per clan:
+//   THREAT      enemy unit strength (attack + defense) spread over the area it can reach
+//   OPPORTUNITY enemy village yields nearby, less the threat guarding them (never below 0)
+//   RESOURCES   building-site density (farmland, forest, hills); the same for every clan
+enum class InfluenceLayer
+{
+   THREAT, OPPORTUNITY, RESOURCES
+};
+const int INFLUENCE_LAYER_COUNT = 3;
+
+// Strategic layers rebuilt once per turn, so AI code can sample any tile in O(1)
+// instead of scanning every enemy unit for every candidate tile.  Each input grid is
+// blurred with separable box passes built on running sums, so the cost does not grow
+// with the radius, and the column pass works on whole rows at a time so the compiler
+// vectorizes it.  The blurs are independent and are spread over a WorkerPool.
+//
+// update() builds every clan's layers.  A caller that may not get to every clan (the
+// AI under a deadline) calls updateShared() once, whose cost does not depend on the
+// number of clans, then updateClan() for each clan it is about to use; updateClan
+// calls for different clans may run at once on different workers.  A clan's layers
+// are allocated by its first updateClan, so check hasClanLayers before sampling them.
+// The resources layer is only rebuilt when the terrain changes (GameState::terrainStamp).
+class InfluenceMaps
+{
+public:
+   void resize(int width, int height, int clanCount, int workers);
+   void update(const GameState& state, WorkerPool* pool = nullptr);
+   void updateShared(const GameState& state, WorkerPool* pool = nullptr);
+   void updateClan(int clanIdx, int worker);
+
+   float sample(InfluenceLayer layer, int clanIdx, int x, int y) const { return this->layer(layer, clanIdx)[y * m_width + x]; }
+   const float* layer(InfluenceLayer layer, int clanIdx) const;
+   bool hasClanLayers(int clanIdx) const { return !m_threat[clanIdx].empty(); }
+
+   int width() const { return m_width; }
+   int height() const { return m_height; }
+
+private:
+   struct Source
+   {
+      int idx;
+      float value;
+   };
+
+   void blur(std::vector<float>& grid, int worker);
+
+   int m_width = 0;
+   int m_height = 0;
+   int m_clanCount = 0;
+
+   // Inputs, blurred in place: per-clan unit strength and village yield (scattered
+   // from the source lists into a worker's grids, which only live through updateClan),
+   // their totals over all clans, and the building-site grid
+   std::vector<std::vector<Source>> m_strengthSources;
+   std::vector<std::vector<Source>> m_yieldSources;
+   std::vector<std::vector<float>> m_strength; // One per worker
+   std::vector<std::vector<float>> m_yield;    // One per worker
+   std::vector<float> m_totalStrength;
+   std::vector<float> m_totalYield;
+   std::vector<float> m_resources;
+   uint32_t m_resourcesStamp = 0;
+   bool m_hasResources = false;
+
+   std::vector<std::vector<float>> m_threat;
+   std::vector<std::vector<float>> m_opportunity;
+   std::vector<std::vector<float>> m_scratch; // One per worker
+};
+
+#endif
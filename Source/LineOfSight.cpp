@@ -0,0 +1,192 @@
+#include "LineOfSight.h"
+#include "GameState.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+// (col, depth) -> (dx, dy) for each octant: dx = col * xx + depth * xy, dy = col * yx + depth * yy
+static const int OCTANTS[8][4] =
+{
+   { 1, 0, 0, 1 }, { 0, 1, 1, 0 }, { 0, -1, 1, 0 }, { -1, 0, 0, 1 },
+   { -1, 0, 0, -1 }, { 0, -1, -1, 0 }, { 0, 1, -1, 0 }, { 1, 0, 0, -1 },
+};
+
+// Widest column in each row of an octant that lies inside the vision disk, per radius.
+// Same disk as the fog stamps used before line of sight: dx*dx + dy*dy <= r*r + r.
+struct RadiusMasks
+{
+   int maxCol[MAX_VISION_RADIUS + 1][MAX_VISION_RADIUS + 1];
+
+   RadiusMasks()
+   {
+      for (int r = 0; r <= MAX_VISION_RADIUS; ++r)
+      {
+         for (int depth = 0; depth <= MAX_VISION_RADIUS; ++depth)
+         {
+            int col = -1;
+            while (col < depth && (col + 1) * (col + 1) + depth * depth <= r * r + r) ++col;
+            maxCol[r][depth] = col;
+         }
+      }
+   }
+};
+
+static const RadiusMasks& radiusMasks()
+{
+   static const RadiusMasks masks;
+   return masks;
+}
+
+// A row of an octant still being scanned, with the visible slope range as fractions
+struct ShadowRow
+{
+   int depth;
+   int startNum, startDen;
+   int endNum, endDen;
+};
+
+// Most rows the stack can hold.  A row at depth d spans at most d + 1 columns, so it
+// pushes at most d / 2 + 1 rows (one per run of floor); the stack holds at most the
+// children of one row per depth on the way down.  28 for a radius of 8.
+static constexpr int shadowStackSize(int radius)
+{
+   int rows = 1;
+   for (int depth = 1; depth <= radius; ++depth)
+      rows += depth / 2 + 1;
+   return rows;
+}
+
+const int SHADOW_STACK_SIZE = shadowStackSize(MAX_VISION_RADIUS);
+
+bool blocksSight(Terrain terrain)
+{
+   return terrain == Terrain::HILLS || terrain == Terrain::MOUNTAIN;
+}
+
+void computeVision(const GameState& state, int x, int y, int radius, VisionMask& out)
+{
+   radius = std::min(std::max(radius, 0), MAX_VISION_RADIUS);
+   out.radius = radius;
+   std::fill(std::begin(out.rows), std::end(out.rows), 0u);
+   if (!state.inBounds(x, y)) return;
+
+   out.rows[radius] |= 1u << radius;
+
+   const RadiusMasks& masks = radiusMasks();
+   ShadowRow stack[SHADOW_STACK_SIZE];
+
+   for (const auto& octant : OCTANTS)
+   {
+      int top = 0;
+      stack[top++] = { 1, 0, 1, 1, 1 };
+
+      while (top > 0)
+      {
+         const ShadowRow row = stack[--top];
+         const int depth = row.depth;
+         if (depth > radius) continue;
+
+         // Columns whose centres fall inside the slope range, rounding ties outwards
+         int startNum = row.startNum, startDen = row.startDen;
+         const int minCol = (2 * depth * startNum + startDen) / (2 * startDen);
+         const int endTwice = 2 * depth * row.endNum - row.endDen;
+         const int maxCol = std::min(endTwice <= 0 ? 0 : (endTwice + 2 * row.endDen - 1) / (2 * row.endDen),
+            masks.maxCol[radius][depth]);
+
+         int prevWall = -1; // -1 before the first tile of the row
+         for (int col = minCol; col <= maxCol; ++col)
+         {
+            const int dx = col * octant[0] + depth * octant[1];
+            const int dy = col * octant[2] + depth * octant[3];
+            const bool onMap = state.inBounds(x + dx, y + dy);
+            const bool wall = !onMap || blocksSight(state.map[state.tileIndex(x + dx, y + dy)].terrain);
+
+            // Walls are seen whenever scanned; floors only if their centre is in range,
+            // which is what makes the result symmetric
+            const bool centred = col * startDen >= depth * startNum && col * row.endDen <= depth * row.endNum;
+            if (onMap && (wall || centred))
+               out.rows[dy + radius] |= 1u << (dx + radius);
+
+            if (prevWall == 1 && !wall)
+            {
+               startNum = 2 * col - 1;
+               startDen = 2 * depth;
+            }
+            else if (prevWall == 0 && wall)
+            {
+               stack[top++] = { depth + 1, startNum, startDen, 2 * col - 1, 2 * depth };
+            }
+            prevWall = wall ? 1 : 0;
+         }
+
+         if (prevWall == 0)
+            stack[top++] = { depth + 1, startNum, startDen, row.endNum, row.endDen };
+      }
+   }
+}
+
+const VisionMask& VisionCache::get(const GameState& state, int x, int y, int radius)
+{
+   if (m_entries.empty())
+      m_entries.resize(VISION_CACHE_SIZE);
+
+   radius = std::min(std::max(radius, 0), MAX_VISION_RADIUS);
+
+   // A different map, or terrain changed elsewhere: nothing here can be trusted
+   if (m_terrainStamp != state.terrainStamp || m_width != state.width)
+   {
+      for (auto& entry : m_entries)
+         entry.tile = -1;
+      m_terrainStamp = state.terrainStamp;
+      m_width = state.width;
+   }
+
+   const int tile = state.tileIndex(x, y);
+   const uint32_t key = static_cast<uint32_t>(tile) * 16u + static_cast<uint32_t>(radius);
+   Entry& entry = m_entries[(key * 2654435761u >> 7) & (VISION_CACHE_SIZE - 1)];
+   if (entry.tile == tile && entry.mask.radius == radius)
+   {
+      ++m_hits;
+      return entry.mask;
+   }
+
+   ++m_misses;
+   computeVision(state, x, y, radius, entry.mask);
+   entry.tile = tile;
+   return entry.mask;
+}
+
+void VisionCache::onTerrainChanged(GameState& state, int idx)
+{
+   if (m_terrainStamp == state.terrainStamp && m_width == state.width)
+   {
+      const int x = idx % m_width;
+      const int y = idx / m_width;
+      for (auto& entry : m_entries)
+      {
+         if (entry.tile < 0) continue;
+         const int dx = std::abs(entry.tile % m_width - x);
+         const int dy = std::abs(entry.tile / m_width - y);
+         if (std::max(dx, dy) <= entry.mask.radius)
+            entry.tile = -1;
+      }
+      state.terrainStamp = nextTerrainStamp();
+      m_terrainStamp = state.terrainStamp;
+   }
+   else
+   {
+      state.terrainStamp = nextTerrainStamp();
+   }
+}
+
+VisionCache& threadVisionCache()
+{
+   thread_local VisionCache cache;
+   return cache;
+}
+
+uint32_t nextTerrainStamp()
+{
+   static std::atomic<uint32_t> counter{0};
+   return ++counter;
+}
@@ -0,0 +1,68 @@
+#ifndef LINEOFSIGHT_H
+#define LINEOFSIGHT_H
+
+#include "Game.h"
+#include <cstdint>
+#include <vector>
+
+struct GameState;
+
+const int MAX_VISION_RADIUS = 8;
+const int VISION_CACHE_SIZE = 8192; // Entries per thread, direct-mapped
+
+// Hills and mountains can be seen but not seen past
+bool blocksSight(Terrain terrain);
+
+// What a viewer at the centre can see: bit (dx + radius) of rows[dy + radius] is set
+// for every visible tile (dx, dy) relative to it.  Tiles off the map are never set.
+struct VisionMask
+{
+   int radius = 0;
+   uint32_t rows[2 * MAX_VISION_RADIUS + 1] = {};
+
+   bool sees(int dx, int dy) const { return (rows[dy + radius] >> (dx + radius)) & 1; }
+};
+
+// Symmetric shadowcasting: a floor tile is visible from the centre exactly when the
+// centre is visible from it.  The eight octant transforms and the per-radius disk
+// limits are precomputed tables, and the row stack is an array sized for the worst
+// case at MAX_VISION_RADIUS, so this never allocates or drops a row.  The viewer's
+// own tile does not block.
+void computeVision(const GameState& state, int x, int y, int radius, VisionMask& out);
+
+// Remembers computeVision results per (tile, radius).  Results only depend on
+// terrain, so the cache is keyed to GameState::terrainStamp: clones of a state share
+// their entries, and a different map or a terrain change on another thread simply
+// flushes it.  Use one per thread (see threadVisionCache).
+class VisionCache
+{
+public:
+   const VisionMask& get(const GameState& state, int x, int y, int radius);
+
+   // Terrain at idx changed: bumps the state's terrainStamp and drops only the
+   // entries whose window covered the tile.
+   void onTerrainChanged(GameState& state, int idx);
+
+   int hits() const { return m_hits; }
+   int misses() const { return m_misses; }
+
+private:
+   struct Entry
+   {
+      int tile = -1;
+      VisionMask mask;
+   };
+
+   std::vector<Entry> m_entries;
+   uint32_t m_terrainStamp = 0;
+   int m_width = 0;
+   int m_hits = 0;
+   int m_misses = 0;
+};
+
+VisionCache& threadVisionCache();
+
+// A fresh stamp for terrain that has just been generated or changed
+uint32_t nextTerrainStamp();
+
+#endif
@@ -2,10 +2,49 @@
 
 #include "GameGlobals.h"
 #include "Render.h"
+#include "SaveGame.h"
+#include "StateHash.h"
+#include "TechTree.h"
+#include "WorkerPool.h"
 
 #include "../Geist/Source/Engine.h"
 #include "../Geist/Source/Globals.h"
 #include "../Geist/Source/InputSystem.h"
+#include "../Geist/Source/Logging.h"
+#include "../Geist/Source/ScriptingSystem.h"
+
+#include <ctime>
+
+// Lua: events, nextCursor = GetTurnEvents(cursor)
+// Each script keeps its own cursor; pass 0 to read everything still in the log.
+static int LuaGetTurnEvents(lua_State* L)
+{
+    TurnEventCursor cursor;
+    cursor.next = static_cast<uint64_t>(luaL_optinteger(L, 1, 0));
+
+    lua_newtable(L);
+    TurnEvent e;
+    int n = 0;
+    while (g_TurnEvents.read(cursor, e))
+    {
+        lua_createtable(L, 0, 6);
+        lua_pushstring(L, turnEventName(e.type));
+        lua_setfield(L, -2, "type");
+        lua_pushinteger(L, e.turn);
+        lua_setfield(L, -2, "turn");
+        lua_pushinteger(L, e.clanIdx);
+        lua_setfield(L, -2, "clan");
+        lua_pushinteger(L, e.villageIdx);
+        lua_setfield(L, -2, "village");
+        lua_pushinteger(L, e.value);
+        lua_setfield(L, -2, "value");
+        lua_pushinteger(L, e.detail);
+        lua_setfield(L, -2, "detail");
+        lua_rawseti(L, -2, ++n);
+    }
+    lua_pushinteger(L, static_cast<lua_Integer>(cursor.next));
+    return 2;
+}
 
 void MainState::Init(const std::string&)
 {
@@ -28,31 +67,37 @@ void MainState::Init(const std::string&)
     }
 
     g_Tileset = LoadTexture("Images/tiles.png");
-    generateMap(g_Map, g_Villages, g_Clans);
 
-    for (size_t i = 0; i < g_Villages.size(); ++i)
-    {
-        if (g_Villages[i].clanIdx >= 0 && g_Villages[i].clanIdx < static_cast<int>(g_Clans.size()))
-        {
-            VillageProduction production = calculateVillageProduction(g_Villages[i], g_Clans[g_Villages[i].clanIdx]);
-            g_Villages[i].foodProduction = production.food;
-            g_Villages[i].productionOutput = production.production;
-            g_Villages[i].goldOutput = production.gold;
-            g_Villages[i].knowledgeOutput = production.knowledge;
-            g_Villages[i].worshipOutput = production.worship;
-        }
-    }
+    // Without the tech data the game still runs; nothing can be researched
+    std::string techError;
+    if (!sharedTechTree().loadFromFile("Data/techs.json", techError))
+        TraceLog(LOG_WARNING, "Tech tree not loaded: %s", techError.c_str());
+
+    g_GameState.clear();
+    g_GameState.seed = static_cast<unsigned int>(std::time(nullptr));
+    generateMap(g_GameState);
+    g_Replay.start(g_GameState);
+    openHistory();
 
     g_ViewX = GRID_WIDTH / 2;
     g_ViewY = GRID_HEIGHT / 2;
     g_WaterAnimTime = 0.0f;
     g_WaterFrame = 0;
-    g_CurrentTurn = 1;
-    g_SelectedVillageIdx = -1;
+    g_SelectedVillage = VillageHandle();
+
+    g_TurnEvents.clear();
+    g_GameState.events = &g_TurnEvents;
+    m_logCursor = g_TurnEvents.cursorAtHead();
+    m_minimap.reset(g_TurnEvents);
+    if (g_ScriptingSystem)
+        g_ScriptingSystem->RegisterScriptFunction("GetTurnEvents", LuaGetTurnEvents);
 }
 
 void MainState::Shutdown()
 {
+    g_Autosave.wait();
+    g_History.close(g_GameState);
+    m_minimap.unload();
     if (g_LargeFont.texture.id != 0)
         UnloadFont(g_LargeFont);
     if (g_GameFont.texture.id != 0)
@@ -98,8 +143,37 @@ void MainState::Update()
         renderMouseX >= buttonX && renderMouseX < buttonX + buttonW &&
         renderMouseY >= buttonY && renderMouseY < buttonY + buttonH)
     {
-        processEndOfTurn(g_Clans, g_Villages);
-        ++g_CurrentTurn;
+        g_TurnEvents.beginTurn(g_GameState.currentTurn);
+        g_TurnProfiler.beginTurn(g_GameState.currentTurn);
+        g_Replay.endTurn(g_GameState);
+        processEndOfTurn(g_GameState, &g_TurnEvents, &g_TurnProfiler);
+        {
+            ScopedPhaseTimer timer(&g_TurnProfiler, TurnPhase::AI);
+            g_ClanAI.playTurn(g_GameState, DEFAULT_AI_BUDGET_MS, PLAYER_CLAN, &sharedWorkerPool(), &g_Replay);
+        }
+        g_TurnProfiler.endTurn();
+#ifdef DEBUG_MODE
+        const uint64_t fullHash = computeWorldHash(g_GameState);
+        if (fullHash != g_GameState.worldHash)
+        {
+            Log("World hash mismatch after turn " + std::to_string(g_GameState.currentTurn) + ": incremental " +
+                std::to_string(g_GameState.worldHash) + ", recomputed " + std::to_string(fullHash));
+            g_GameState.worldHash = fullHash;
+        }
+#endif
+        ++g_GameState.currentTurn;
+        logTurnEvents();
+
+        std::string historyError;
+        if (g_History.isOpen() && !g_History.writeFrame(g_GameState, historyError))
+        {
+            Log("History stopped: " + historyError);
+            g_History.close(g_GameState);
+        }
+
+        // Only the snapshot happens here; the save is written on the autosave thread
+        if (g_GameState.currentTurn % AUTOSAVE_INTERVAL == 0)
+            g_Autosave.request(g_GameState, "autosave.sav");
     }
 
     const int mainViewX = VIEW_OFFSET_X;
@@ -120,8 +194,53 @@ void MainState::Update()
         if (mapX >= 0 && mapX < GRID_WIDTH && mapY >= 0 && mapY < GRID_HEIGHT)
         {
             const int idx = mapY * GRID_WIDTH + mapX;
-            if (g_Map[idx].hasVillage)
-                g_SelectedVillageIdx = g_Map[idx].villageIdx;
+            if (g_GameState.map[idx].hasVillage)
+                g_SelectedVillage = villageHandle(g_GameState, g_GameState.map[idx].villageIdx);
+        }
+    }
+
+    // Saves the game so far as a replay, for bug reports; ClanDestinySim --replay plays it back
+    if (g_InputSystem->WasKeyPressed(KEY_F5))
+    {
+        ReplayRecorder snapshot = g_Replay;
+        snapshot.finish(g_GameState);
+        std::string replayError;
+        if (snapshot.replay().save("last_game.replay", replayError))
+            Log("Saved last_game.replay (" + std::to_string(snapshot.replay().header.turns) + " turns)");
+        else
+            Log("Could not save the replay: " + replayError);
+    }
+
+    AutosaveResult autosave;
+    if (g_Autosave.poll(autosave) && !autosave.ok)
+        Log("Autosave for turn " + std::to_string(autosave.turn) + " failed: " + autosave.error);
+
+    // Quick save and quick load.  A loaded game is not recorded: replays start from a generated world.
+    if (g_InputSystem->WasKeyPressed(KEY_F6))
+    {
+        std::string saveError;
+        if (saveGame(g_GameState, "quicksave.sav", saveError))
+            Log("Saved quicksave.sav (turn " + std::to_string(g_GameState.currentTurn) + ")");
+        else
+            Log("Could not save the game: " + saveError);
+    }
+    if (g_InputSystem->WasKeyPressed(KEY_F7))
+    {
+        GameState loaded;
+        std::string loadError;
+        if (!loadGame(loaded, "quicksave.sav", loadError))
+            Log("Could not load the game: " + loadError);
+        else if (loaded.width != GRID_WIDTH || loaded.height != GRID_HEIGHT)
+            Log("Could not load the game: quicksave.sav is not a " + std::to_string(GRID_WIDTH) + "x" +
+                std::to_string(GRID_HEIGHT) + " map");
+        else
+        {
+            g_GameState.copyFrom(loaded);
+            g_Replay = ReplayRecorder();
+            openHistory();
+            g_SelectedVillage = VillageHandle();
+            m_minimap.reset(g_TurnEvents);
+            Log("Loaded quicksave.sav (turn " + std::to_string(g_GameState.currentTurn) + ")");
         }
     }
 
@@ -129,8 +248,40 @@ void MainState::Update()
         g_Engine->m_Done = true;
 }
 
+// Starts history.cdd over from the current state
+void MainState::openHistory()
+{
+    std::string historyError;
+    if (!g_History.open("history.cdd", g_GameState, historyError))
+        Log("History not recorded: " + historyError);
+}
+
+// Every event goes to the log while debug drawing is on; otherwise the cursor just keeps up
+void MainState::logTurnEvents()
+{
+    if (!g_Engine || !g_Engine->m_debugDrawing)
+    {
+        m_logCursor = g_TurnEvents.cursorAtHead();
+        return;
+    }
+
+    TurnEvent e;
+    while (g_TurnEvents.read(m_logCursor, e))
+    {
+        if (e.type == TurnEventType::TURN_ENDED)
+            continue;
+        Log(std::string("Turn ") + std::to_string(e.turn) + " " + turnEventName(e.type) +
+            " clan=" + std::to_string(e.clanIdx) + " village=" + std::to_string(e.villageIdx) +
+            " value=" + std::to_string(e.value) + " detail=" + std::to_string(e.detail));
+    }
+}
+
 void MainState::Draw()
 {
-    drawView(g_Map, g_Tileset, g_ViewX, g_ViewY, g_WaterAnimTime, g_WaterFrame,
-        g_Clans, g_Villages, g_GameFont, g_LargeFont, g_SelectedVillageIdx, g_CurrentTurn);
+    m_minimap.update(g_GameState, g_TurnEvents);
+    drawView(g_GameState, m_minimap, g_Tileset, g_ViewX, g_ViewY, g_WaterAnimTime, g_WaterFrame,
+        g_GameFont, g_LargeFont, g_SelectedVillage);
+
+    if (g_Engine && g_Engine->m_debugDrawing)
+        drawTurnProfiler(g_TurnProfiler, g_GameFont);
 }
\ No newline at end of file
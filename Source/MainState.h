@@ -2,6 +2,8 @@
 #define _MAINSTATE_H_
 
 #include "../Geist/Source/State.h"
+#include "Render.h"
+#include "TurnEvents.h"
 
 class MainState : public State
 {
@@ -16,6 +18,13 @@ public:
 
     void OnEnter() override;
     void OnExit() override;
+
+private:
+    void logTurnEvents();
+    void openHistory();
+
+    TurnEventCursor m_logCursor;
+    Minimap m_minimap;
 };
 
 #endif
\ No newline at end of file
@@ -1,10 +1,18 @@
 #include "Map.h"
 #include "Clan.h"
+#include "Fog.h"
+#include "GameState.h"
+#include "LineOfSight.h"
+#include "Production.h"
+#include "StateHash.h"
+#include "TechTree.h"
+#include "Territory.h"
+#include "Units.h"
+#include "Villages.h"
 #include <cstdlib>
-#include <ctime>
 #include <cmath>
 
-int countLandNeighbors(const std::vector<int>& grid, int x, int y)
+int countLandNeighbors(const std::vector<int>& grid, int width, int height, int x, int y)
 {
    int count = 0;
    for (int dy = -1; dy <= 1; ++dy)
@@ -14,24 +22,58 @@ int countLandNeighbors(const std::vector<int>& grid, int x, int y)
          if (dx == 0 && dy == 0) continue;
          int nx = x + dx;
          int ny = y + dy;
-         if (nx >= 0 && nx < GRID_WIDTH && ny >= 0 && ny < GRID_HEIGHT)
+         if (nx >= 0 && nx < width && ny >= 0 && ny < height)
          {
-            count += grid[ny * GRID_WIDTH + nx];
+            count += grid[ny * width + nx];
          }
       }
    }
    return count;
 }
 
-void generateMap(std::vector<SquareTile>& map, std::vector<Village>& villages, std::vector<Clan>& clans)
+static Clan makeClan(const char* name, Color color, Rectangle villageTile, uint32_t traits = 0)
 {
-   std::srand(static_cast<unsigned>(std::time(nullptr)));
-   std::vector<int> grid(GRID_WIDTH * GRID_HEIGHT, 0);
+   Clan clan;
+   setName(clan.name, name);
+   clan.color = color;
+   clan.villageTile = villageTile;
+   clan.traits = traits;
+   compileProduction(clan, sharedTechTree());
+   return clan;
+}
 
-   // Seed ~50% land (~1702 cells)
-   for (int i = 0; i < TOTAL_CELLS / 2; ++i)
+// Villages always sit on grassland; the terrain is forced before the world hash is computed
+static void placeVillage(GameState& state, int x, int y, int clanIdx)
+{
+   state.map[state.tileIndex(x, y)].terrain = Terrain::GRASSLAND;
+   foundVillage(state, x, y, clanIdx);
+}
+
+void generateTerrain(GameState& state)
+{
+   const int width = state.width;
+   const int height = state.height;
+   const int totalCells = width * height;
+
+   std::vector<SquareTile>& map = state.map;
+   map.clear();
+   state.villages.clear();
+   state.firstFreeVillage = -1;
+   state.liveVillageCount = 0;
+   state.queueItems.clear();
+   state.firstFreeQueueItem = -1;
+   // Fog and territory describe the old world until they are rebuilt for this one
+   state.fogWordsPerRow = 0;
+   state.territoryOwner.clear();
+   state.territoryDistance.clear();
+
+   std::srand(state.seed);
+   std::vector<int> grid(totalCells, 0);
+
+   // Seed ~50% land
+   for (int i = 0; i < totalCells / 2; ++i)
    {
-      int idx = std::rand() % TOTAL_CELLS;
+      int idx = std::rand() % totalCells;
       grid[idx] = 1;
    }
 
@@ -39,12 +81,12 @@ void generateMap(std::vector<SquareTile>& map, std::vector<Village>& villages, s
    for (int iter = 0; iter < 5; ++iter)
    {
       std::vector<int> newGrid = grid;
-      for (int y = 0; y < GRID_HEIGHT; ++y)
+      for (int y = 0; y < height; ++y)
       {
-         for (int x = 0; x < GRID_WIDTH; ++x)
+         for (int x = 0; x < width; ++x)
          {
-            int idx = y * GRID_WIDTH + x;
-            int landNeighbors = countLandNeighbors(grid, x, y);
+            int idx = y * width + x;
+            int landNeighbors = countLandNeighbors(grid, width, height, x, y);
             if (landNeighbors >= 4) newGrid[idx] = 1;
             else if (landNeighbors <= 3) newGrid[idx] = 0;
          }
@@ -53,12 +95,12 @@ void generateMap(std::vector<SquareTile>& map, std::vector<Village>& villages, s
    }
 
    // Assign terrain types
-   map.resize(GRID_WIDTH * GRID_HEIGHT);
-   for (int y = 0; y < GRID_HEIGHT; ++y)
+   map.resize(totalCells);
+   for (int y = 0; y < height; ++y)
    {
-      for (int x = 0; x < GRID_WIDTH; ++x)
+      for (int x = 0; x < width; ++x)
       {
-         int idx = y * GRID_WIDTH + x;
+         int idx = y * width + x;
          SquareTile& tile = map[idx];
          tile.x = x;
          tile.y = y;
@@ -72,7 +114,7 @@ void generateMap(std::vector<SquareTile>& map, std::vector<Village>& villages, s
          }
          else // Land
          {
-            int neighbors = countLandNeighbors(grid, x, y);
+            int neighbors = countLandNeighbors(grid, width, height, x, y);
             float rand = static_cast<float>(std::rand()) / RAND_MAX;
             bool nearWater = false;
             for (int dy = -1; dy <= 1 && !nearWater; ++dy)
@@ -81,8 +123,8 @@ void generateMap(std::vector<SquareTile>& map, std::vector<Village>& villages, s
                {
                   int nx = x + dx;
                   int ny = y + dy;
-                  if (nx >= 0 && nx < GRID_WIDTH && ny >= 0 && ny < GRID_HEIGHT &&
-                     grid[ny * GRID_WIDTH + nx] == 0)
+                  if (nx >= 0 && nx < width && ny >= 0 && ny < height &&
+                     grid[ny * width + nx] == 0)
                   {
                      nearWater = true;
                   }
@@ -111,12 +153,27 @@ void generateMap(std::vector<SquareTile>& map, std::vector<Village>& villages, s
       }
    }
 
+   state.terrainStamp = nextTerrainStamp();
+}
+
+void generateMap(GameState& state)
+{
+   const int width = state.width;
+   const int height = state.height;
+
+   generateTerrain(state);
+   initUnitPool(state, DEFAULT_UNIT_CAPACITY);
+
+   std::vector<SquareTile>& map = state.map;
+   std::vector<Village>& villages = state.villages;
+   std::vector<Clan>& clans = state.clans;
+
    // Define clans with village tiles
    clans.clear();
-   clans.push_back({ "Red Claw", {255, 128, 128, 255}, 0, 0, 0, {}, {0 * 16.0f, 44 * 16.0f, 16, 16} });
-   clans.push_back({ "Glendwellers", {128, 255, 128, 255}, 0, 0, 0, {}, {1 * 16.0f, 6 * 16.0f, 16, 16} });
-   clans.push_back({ "Gilded", {255, 255, 128, 255}, 0, 0, 0, {}, {0 * 16.0f, 6 * 16.0f, 16, 16} });
-   clans.push_back({ "Xenth", {0, 243, 192, 255}, 0, 0, 0, {}, {1 * 16.0f, 44 * 16.0f, 16, 16} });
+   clans.push_back(makeClan("Red Claw", {255, 128, 128, 255}, {0 * 16.0f, 44 * 16.0f, 16, 16}));
+   clans.push_back(makeClan("Glendwellers", {128, 255, 128, 255}, {1 * 16.0f, 6 * 16.0f, 16, 16}, traitBit(ClanTrait::GREEN_THUMBS)));
+   clans.push_back(makeClan("Gilded", {255, 255, 128, 255}, {0 * 16.0f, 6 * 16.0f, 16, 16}, traitBit(ClanTrait::PROSPECTORS)));
+   clans.push_back(makeClan("Xenth", {0, 243, 192, 255}, {1 * 16.0f, 44 * 16.0f, 16, 16}));
 
    // Place 3 villages per clan
    for (size_t c = 0; c < clans.size(); ++c)
@@ -125,11 +182,11 @@ void generateMap(std::vector<SquareTile>& map, std::vector<Village>& villages, s
       int centerX, centerY;
       while (!centerPlaced)
       {
-         centerX = std::rand() % GRID_WIDTH;
-         centerY = std::rand() % GRID_HEIGHT;
-         int idx = centerY * GRID_WIDTH + centerX;
+         centerX = std::rand() % width;
+         centerY = std::rand() % height;
+         int idx = centerY * width + centerX;
 
-         if (grid[idx] == 1 && !map[idx].hasVillage)
+         if (map[idx].terrain != Terrain::WATER && !map[idx].hasVillage)
          {
             bool tooClose = false;
             for (const auto& v : villages)
@@ -144,18 +201,7 @@ void generateMap(std::vector<SquareTile>& map, std::vector<Village>& villages, s
             }
             if (!tooClose)
             {
-               map[idx].hasVillage = true;
-               map[idx].villageIdx = villages.size();
-               map[idx].terrain = Terrain::GRASSLAND;
-               Village centerVillage;
-               centerVillage.x = centerX;
-               centerVillage.y = centerY;
-               centerVillage.name = clans[c].name + " Village " + std::to_string(villages.size() + 1);
-               centerVillage.clanIdx = c;
-               centerVillage.population = 1; // Start with 1 (per design)
-               centerVillage.workers.resize(MAX_VILLAGE_POPULATION, false);
-               villages.push_back(centerVillage);
-               clans[c].villages.push_back(villages.size() - 1);
+               placeVillage(state, centerX, centerY, (int)c);
                centerPlaced = true;
             }
          }
@@ -171,10 +217,10 @@ void generateMap(std::vector<SquareTile>& map, std::vector<Village>& villages, s
          int x = centerX + dx;
          int y = centerY + dy;
 
-         if (x >= 0 && x < GRID_WIDTH && y >= 0 && y < GRID_HEIGHT)
+         if (x >= 0 && x < width && y >= 0 && y < height)
          {
-            int idx = y * GRID_WIDTH + x;
-            if (grid[idx] == 1 && !map[idx].hasVillage)
+            int idx = y * width + x;
+            if (map[idx].terrain != Terrain::WATER && !map[idx].hasVillage)
             {
                bool tooClose = false;
                for (const auto& v : villages)
@@ -189,22 +235,17 @@ void generateMap(std::vector<SquareTile>& map, std::vector<Village>& villages, s
                }
                if (!tooClose)
                {
-                  map[idx].hasVillage = true;
-                  map[idx].villageIdx = villages.size();
-                  map[idx].terrain = Terrain::GRASSLAND;
-                  Village newVillage;
-                  newVillage.x = x;
-                  newVillage.y = y;
-                  newVillage.name = clans[c].name + " Village " + std::to_string(villages.size() + 1);
-                  newVillage.clanIdx = c;
-                  newVillage.population = 1; // Start with 1 (per design)
-                  newVillage.workers.resize(MAX_VILLAGE_POPULATION, false);
-                  villages.push_back(newVillage);
-                  clans[c].villages.push_back(villages.size() - 1);
+                  placeVillage(state, x, y, (int)c);
                   placedCount++;
                }
             }
          }
       }
    }
-}
\ No newline at end of file
+
+   initFog(state);
+   rebuildFog(state);
+   rebuildTerritory(state);
+
+   state.worldHash = computeWorldHash(state);
+}
@@ -14,6 +14,11 @@ struct SquareTile
    int villageIdx = -1; // Index in villages vector (-1 if no village)
 };
 
-void generateMap(std::vector<SquareTile>& map, std::vector<struct Village>& villages, std::vector<struct Clan>& clans);
+// Clears the world and builds only its terrain for state.width x state.height, seeded
+// from state.seed.  Shared by generateMap and the stress scenarios in Scenario.h.
+void generateTerrain(struct GameState& state);
+
+// Builds terrain, clans and villages for state.width x state.height, seeded from state.seed
+void generateMap(struct GameState& state);
 
 #endif
\ No newline at end of file
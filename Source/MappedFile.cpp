@@ -0,0 +1,115 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path)
+{
+   close();
+   HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+   if (file == INVALID_HANDLE_VALUE) return false;
+
+   LARGE_INTEGER size;
+   if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+   {
+      CloseHandle(file);
+      return false;
+   }
+   HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+   const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+   if (!view)
+   {
+      if (mapping) CloseHandle(mapping);
+      CloseHandle(file);
+      return false;
+   }
+
+   m_file = file;
+   m_mapping = mapping;
+   m_data = static_cast<const uint8_t*>(view);
+   m_size = static_cast<size_t>(size.QuadPart);
+   return true;
+}
+
+void MappedFile::close()
+{
+   if (m_data) UnmapViewOfFile(m_data);
+   if (m_mapping) CloseHandle(m_mapping);
+   if (m_file) CloseHandle(m_file);
+   m_data = nullptr;
+   m_size = 0;
+   m_mapping = nullptr;
+   m_file = nullptr;
+}
+
+bool syncFile(FILE* file)
+{
+   return std::fflush(file) == 0 && _commit(_fileno(file)) == 0;
+}
+
+bool replaceFile(const std::string& from, const std::string& to)
+{
+   return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path)
+{
+   close();
+   const int fd = ::open(path.c_str(), O_RDONLY);
+   if (fd < 0) return false;
+
+   struct stat info;
+   if (fstat(fd, &info) != 0 || info.st_size == 0)
+   {
+      ::close(fd);
+      return false;
+   }
+   void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+   ::close(fd); // The mapping keeps the file open
+   if (view == MAP_FAILED) return false;
+
+   m_data = static_cast<const uint8_t*>(view);
+   m_size = static_cast<size_t>(info.st_size);
+   return true;
+}
+
+void MappedFile::close()
+{
+   if (m_data) munmap(const_cast<uint8_t*>(m_data), m_size);
+   m_data = nullptr;
+   m_size = 0;
+}
+
+bool syncFile(FILE* file)
+{
+   return std::fflush(file) == 0 && fsync(fileno(file)) == 0;
+}
+
+bool replaceFile(const std::string& from, const std::string& to)
+{
+   if (std::rename(from.c_str(), to.c_str()) != 0) return false;
+
+   // The new name is only on disk once the directory holding it is
+   const size_t slash = to.find_last_of('/');
+   const std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : to.substr(0, slash);
+   const int fd = ::open(directory.c_str(), O_RDONLY);
+   if (fd < 0) return true;
+   fsync(fd);
+   ::close(fd);
+   return true;
+}
+
+#endif
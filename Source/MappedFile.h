@@ -0,0 +1,44 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// A read-only memory mapping of a whole file.  Pages are read in by the OS as they
+// are touched, so opening costs nothing per byte.  Kept apart from the game headers
+// because the platform headers it needs clash with raylib's names.
+class MappedFile
+{
+public:
+   MappedFile() = default;
+   ~MappedFile() { close(); }
+
+   MappedFile(const MappedFile&) = delete;
+   MappedFile& operator=(const MappedFile&) = delete;
+
+   bool open(const std::string& path);
+   void close();
+
+   bool isOpen() const { return m_data != nullptr; }
+   const uint8_t* data() const { return m_data; }
+   size_t size() const { return m_size; }
+
+private:
+   const uint8_t* m_data = nullptr;
+   size_t m_size = 0;
+#ifdef _WIN32
+   void* m_file = nullptr;
+   void* m_mapping = nullptr;
+#endif
+};
+
+// Flushes a written file's data through to the disk
+bool syncFile(FILE* file);
+
+// Renames from over to in one step, so a reader finds either the old file or the new
+// one and never half of either, then makes the rename itself durable
+bool replaceFile(const std::string& from, const std::string& to);
+
+#endif
@@ -0,0 +1,360 @@
+#include "Mcts.h"
+#include "Clan.h"
+#include "Pathfinding.h"
+#include "Replay.h"
+#include "TechTree.h"
+#include "Units.h"
+#include "Villages.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+
+const char* clanPostureName(ClanPosture posture)
+{
+   switch (posture)
+   {
+   case ClanPosture::EXPAND:   return "Expand";
+   case ClanPosture::ECONOMY:  return "Economy";
+   case ClanPosture::MILITARY: return "Military";
+   case ClanPosture::DEFEND:   return "Defend";
+   }
+   return "Unknown";
+}
+
+uint32_t MctsRandom::next()
+{
+   state ^= state >> 12;
+   state ^= state << 25;
+   state ^= state >> 27;
+   return static_cast<uint32_t>((state * 0x2545f4914f6cdd1dULL) >> 32);
+}
+
+// The passable neighbour that brings (x, y) closest to the target; ties go to a
+// random one.  Returns false if no neighbour is closer.
+static bool stepTowards(const GameState& state, const Unit& unit, int targetX, int targetY, MctsRandom& random, int& outX, int& outY)
+{
+   const MovementClass movement = movementClassFor(unit.abilities);
+   int bestDistance = std::max(std::abs(targetX - unit.x), std::abs(targetY - unit.y));
+   bool found = false;
+   const int first = random.below(8);
+   for (int i = 0; i < 8; ++i)
+   {
+      const int n = (first + i) & 7;
+      const int nx = unit.x + NEIGHBOR_DX[n];
+      const int ny = unit.y + NEIGHBOR_DY[n];
+      if (!state.inBounds(nx, ny) || terrainMoveCost(state.map[state.tileIndex(nx, ny)].terrain, movement) == 0) continue;
+
+      const int distance = std::max(std::abs(targetX - nx), std::abs(targetY - ny));
+      if (distance < bestDistance)
+      {
+         bestDistance = distance;
+         outX = nx;
+         outY = ny;
+         found = true;
+      }
+   }
+   return found;
+}
+
+// Nearest village (Chebyshev distance) owned by the clan, or not owned by it
+static int nearestVillage(const GameState& state, int x, int y, int clanIdx, bool own)
+{
+   int best = -1;
+   int bestDistance = INT_MAX;
+   for (int v = 0; v < (int)state.villages.size(); ++v)
+   {
+      const Village& village = state.villages[v];
+      if (!village.alive || (village.clanIdx == clanIdx) != own) continue;
+      const int distance = std::max(std::abs(village.x - x), std::abs(village.y - y));
+      if (distance < bestDistance)
+      {
+         best = v;
+         bestDistance = distance;
+      }
+   }
+   return best;
+}
+
+int planPosture(const GameState& state, int clanIdx, ClanPosture posture, MctsRandom& random,
+   Command* out, int maxCommands)
+{
+   int count = 0;
+   const Clan& clan = state.clans[clanIdx];
+   int gold = clan.gold;
+
+   // Research never competes with the posture, so every one takes the cheapest tech
+   // it can pay for, as ClanAI does
+   const int research = sharedTechTree().cheapestAffordable(clan.researched, clan.knowledge, clan.worship);
+   if (research >= 0 && count < maxCommands)
+   {
+      Command& command = out[count++];
+      command = Command();
+      command.type = CommandType::RESEARCH;
+      command.detail = static_cast<uint8_t>(research);
+      command.clanIdx = clanIdx;
+   }
+
+   for (int v = clan.firstVillage; v >= 0 && count < maxCommands; v = state.villages[v].nextInClan)
+   {
+      const Village& village = state.villages[v];
+      if (village.queueLength > 0) continue;
+
+      // Any building that fits, starting from a random type so rollouts differ
+      const int first = random.below(BUILDING_TYPE_COUNT);
+      for (int i = 0; i < BUILDING_TYPE_COUNT; ++i)
+      {
+         const int type = (first + i) % BUILDING_TYPE_COUNT;
+         int tileX, tileY;
+         if (!canBuild(state, village, static_cast<BuildingType>(type), tileX, tileY)) continue;
+
+         Command& build = out[count++];
+         build = Command();
+         build.type = CommandType::BUILD;
+         build.detail = static_cast<uint8_t>(type);
+         build.clanIdx = clanIdx;
+         build.village = villageHandle(state, v);
+         break;
+      }
+
+      if (posture == ClanPosture::ECONOMY || count >= maxCommands) continue;
+      const UnitType train = posture == ClanPosture::EXPAND ? UnitType::SETTLER : UnitType::SPEARMAN;
+      const int cost = unitTypeInfo(train).goldCost;
+      if (gold < cost) continue;
+
+      gold -= cost;
+      Command& command = out[count++];
+      command = Command();
+      command.type = CommandType::TRAIN;
+      command.detail = static_cast<uint8_t>(train);
+      command.clanIdx = clanIdx;
+      command.village = villageHandle(state, v);
+   }
+
+   for (int slot = 0; slot < state.unitSlotsUsed && count < maxCommands; ++slot)
+   {
+      const Unit& unit = state.units[slot];
+      if (!unit.alive || unit.clanIdx != clanIdx) continue;
+
+      Command command;
+      command.clanIdx = clanIdx;
+      command.unit = unitHandle(state, slot);
+
+      if (unit.hasAbility(SpecialAbility::BUILD_VILLAGE))
+      {
+         if (canFoundVillage(state, unit.x, unit.y))
+         {
+            command.type = CommandType::FOUND_VILLAGE;
+            out[count++] = command;
+            continue;
+         }
+
+         // Walk away from the nearest village until there is room for a new one
+         const int home = nearestVillage(state, unit.x, unit.y, clanIdx, true);
+         if (home < 0) continue;
+         const int awayX = unit.x + (unit.x - state.villages[home].x) * MIN_VILLAGE_SPACING;
+         const int awayY = unit.y + (unit.y - state.villages[home].y) * MIN_VILLAGE_SPACING;
+         if (!stepTowards(state, unit, awayX + random.below(3) - 1, awayY + random.below(3) - 1, random, command.x, command.y)) continue;
+      }
+      else
+      {
+         if (posture != ClanPosture::MILITARY && posture != ClanPosture::DEFEND) continue;
+         const int target = nearestVillage(state, unit.x, unit.y, clanIdx, posture == ClanPosture::DEFEND);
+         if (target < 0) continue;
+         if (!stepTowards(state, unit, state.villages[target].x, state.villages[target].y, random, command.x, command.y)) continue;
+      }
+
+      command.type = CommandType::MOVE;
+      out[count++] = command;
+   }
+   return count;
+}
+
+static float clanStrength(const GameState& state, int clanIdx)
+{
+   const Clan& clan = state.clans[clanIdx];
+   float strength = 10.0f * static_cast<float>(clan.villageCount) + 0.1f * static_cast<float>(clan.gold);
+   for (int v = clan.firstVillage; v >= 0; v = state.villages[v].nextInClan)
+      strength += static_cast<float>(state.villages[v].population + state.villages[v].buildingCount);
+   return strength;
+}
+
+float evaluateClan(const GameState& state, int clanIdx)
+{
+   float total = 0.0f;
+   float own = 0.0f;
+   for (int c = 0; c < (int)state.clans.size(); ++c)
+   {
+      const float strength = clanStrength(state, c);
+      total += strength;
+      if (c == clanIdx) own = strength;
+   }
+   for (int slot = 0; slot < state.unitSlotsUsed; ++slot)
+   {
+      const Unit& unit = state.units[slot];
+      if (!unit.alive) continue;
+      const float strength = static_cast<float>(unit.attackStrength + unit.defenseStrength);
+      total += strength;
+      if (unit.clanIdx == clanIdx) own += strength;
+   }
+   return total > 0.0f ? own / total : 0.0f;
+}
+
+void MctsPlanner::resize(const GameState& state, int trees)
+{
+   if ((int)m_trees.size() != trees)
+      m_trees.resize(trees);
+
+   // Room for the villages rollouts found and their queues, so copies never have to grow them
+   const size_t villageRoom = state.villages.size() * 4 + 64;
+   for (Tree& tree : m_trees)
+   {
+      if (tree.nodes.empty())
+      {
+         tree.nodes.resize(MCTS_MAX_NODES);
+         tree.commands.resize(MCTS_MAX_COMMANDS);
+      }
+      tree.state.copyFrom(state);
+      if (tree.state.villages.capacity() < villageRoom)
+         tree.state.villages.reserve(villageRoom);
+      if (tree.state.queueItems.capacity() < villageRoom * 2)
+         tree.state.queueItems.reserve(villageRoom * 2);
+   }
+}
+
+void MctsPlanner::playSimulatedTurn(Tree& tree, int clanIdx, ClanPosture posture)
+{
+   GameState& state = tree.state;
+   for (int c = 0; c < (int)state.clans.size(); ++c)
+   {
+      const ClanPosture played = c == clanIdx ? posture : static_cast<ClanPosture>(tree.random.below(CLAN_POSTURE_COUNT));
+      const int count = planPosture(state, c, played, tree.random, tree.commands.data(), MCTS_MAX_COMMANDS);
+      for (int i = 0; i < count; ++i)
+         applyCommand(state, tree.commands[i]);
+   }
+   processEndOfTurn(state);
+   ++state.currentTurn;
+}
+
+void MctsPlanner::grow(Tree& tree, const GameState& root, int clanIdx, Clock::time_point deadline)
+{
+   std::vector<Node>& nodes = tree.nodes;
+   while (Clock::now() < deadline)
+   {
+      tree.state.copyFrom(root);
+
+      // Selection: UCT down the tree, playing each chosen posture as we go
+      int node = 0;
+      int depth = 0;
+      while (nodes[node].firstChild >= 0)
+      {
+         const float logVisits = std::log(static_cast<float>(nodes[node].visits + 1));
+         int best = nodes[node].firstChild;
+         float bestScore = -FLT_MAX;
+         for (int child = nodes[node].firstChild; child < nodes[node].firstChild + CLAN_POSTURE_COUNT; ++child)
+         {
+            const Node& candidate = nodes[child];
+            const float score = candidate.visits == 0 ? FLT_MAX
+               : candidate.value / candidate.visits + MCTS_EXPLORATION * std::sqrt(logVisits / candidate.visits);
+            if (score > bestScore)
+            {
+               best = child;
+               bestScore = score;
+            }
+         }
+         node = best;
+         playSimulatedTurn(tree, clanIdx, nodes[node].posture);
+         ++depth;
+      }
+
+      // Expansion: a leaf visited before gets its children, and the walk goes one deeper
+      if (nodes[node].visits > 0 && depth < MCTS_ROLLOUT_TURNS && tree.nodeCount + CLAN_POSTURE_COUNT <= MCTS_MAX_NODES)
+      {
+         nodes[node].firstChild = tree.nodeCount;
+         for (int p = 0; p < CLAN_POSTURE_COUNT; ++p)
+            nodes[tree.nodeCount++] = { node, -1, 0, 0.0f, static_cast<ClanPosture>(p) };
+         node = nodes[node].firstChild + tree.random.below(CLAN_POSTURE_COUNT);
+         playSimulatedTurn(tree, clanIdx, nodes[node].posture);
+         ++depth;
+      }
+
+      // Rollout to the horizon with random postures, then score
+      for (; depth < MCTS_ROLLOUT_TURNS; ++depth)
+         playSimulatedTurn(tree, clanIdx, static_cast<ClanPosture>(tree.random.below(CLAN_POSTURE_COUNT)));
+      const float value = evaluateClan(tree.state, clanIdx);
+
+      for (int n = node; n >= 0; n = nodes[n].parent)
+      {
+         ++nodes[n].visits;
+         nodes[n].value += value;
+      }
+      ++tree.rollouts;
+   }
+}
+
+ClanPosture MctsPlanner::search(const GameState& state, int clanIdx, double budgetMs, WorkerPool* pool)
+{
+   const Clock::time_point start = Clock::now();
+   const Clock::time_point deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(budgetMs));
+
+   const int trees = pool ? pool->workerCount() : 1;
+   resize(state, trees);
+   ++m_searches;
+   for (int t = 0; t < trees; ++t)
+   {
+      Tree& tree = m_trees[t];
+      tree.nodes[0] = { -1, -1, 0, 0.0f, ClanPosture::ECONOMY };
+      tree.nodeCount = 1;
+      tree.rollouts = 0;
+      tree.random.state = state.worldHash ^ (m_searches * 0x9e3779b97f4a7c15ULL) ^ (static_cast<uint64_t>(t + 1) << 32);
+      if (tree.random.state == 0) tree.random.state = 1;
+   }
+
+   auto job = [&](int item, int) { grow(m_trees[item], state, clanIdx, deadline); };
+   if (pool)
+      pool->parallelFor(trees, job);
+   else
+      job(0, 0);
+
+   // Root parallelism: add up the root children of every tree and take the most visited
+   int visits[CLAN_POSTURE_COUNT] = {};
+   float values[CLAN_POSTURE_COUNT] = {};
+   m_stats = MctsStats();
+   for (const Tree& tree : m_trees)
+   {
+      m_stats.rollouts += tree.rollouts;
+      m_stats.nodes += tree.nodeCount;
+      const int firstChild = tree.nodes[0].firstChild;
+      if (firstChild < 0) continue;
+      for (int p = 0; p < CLAN_POSTURE_COUNT; ++p)
+      {
+         visits[p] += tree.nodes[firstChild + p].visits;
+         values[p] += tree.nodes[firstChild + p].value;
+      }
+   }
+
+   int best = static_cast<int>(ClanPosture::ECONOMY);
+   for (int p = 0; p < CLAN_POSTURE_COUNT; ++p)
+      if (visits[p] > visits[best]) best = p;
+
+   m_stats.ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+   m_stats.rolloutsPerSecond = m_stats.ms > 0.0 ? m_stats.rollouts * 1000.0 / m_stats.ms : 0.0;
+   m_stats.best = static_cast<ClanPosture>(best);
+   m_stats.bestValue = visits[best] > 0 ? values[best] / visits[best] : 0.0f;
+   return m_stats.best;
+}
+
+void MctsPlanner::playTurn(GameState& state, int clanIdx, double budgetMs, WorkerPool* pool, ReplayRecorder* recorder)
+{
+   const ClanPosture posture = search(state, clanIdx, budgetMs, pool);
+
+   Tree& tree = m_trees[0];
+   const int count = planPosture(state, clanIdx, posture, tree.random, tree.commands.data(), MCTS_MAX_COMMANDS);
+   for (int i = 0; i < count; ++i)
+   {
+      if (recorder) recorder->apply(state, tree.commands[i]);
+      else applyCommand(state, tree.commands[i]);
+   }
+}
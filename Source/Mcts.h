@@ -0,0 +1,108 @@
+#ifndef MCTS_H
+#define MCTS_H
+
+#include "Commands.h"
+#include "GameState.h"
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+class ReplayRecorder;
+class WorkerPool;
+
+// What a clan concentrates on for one turn.  These are the actions the tree search
+// chooses between; planPosture turns one into concrete commands.
+enum class ClanPosture : uint8_t
+{
+   EXPAND,   // Train settlers and found villages
+   ECONOMY,  // Build, and save the gold
+   MILITARY, // Train soldiers and march on the nearest enemy village
+   DEFEND    // Train soldiers and keep them at home
+};
+const int CLAN_POSTURE_COUNT = 4;
+
+const char* clanPostureName(ClanPosture posture);
+
+const double DEFAULT_MCTS_BUDGET_MS = 20.0;
+const int MCTS_ROLLOUT_TURNS = 8;      // Turns played past the root before a position is scored
+const int MCTS_MAX_NODES = 1 << 14;    // Per tree; once full, leaves are rolled out without expanding
+const int MCTS_MAX_COMMANDS = 512;     // Per clan per simulated turn
+const float MCTS_EXPLORATION = 1.4f;   // UCT exploration constant, for values in [0, 1]
+
+// xorshift64*; each tree has its own so rollouts need no locking
+struct MctsRandom
+{
+   uint64_t state;
+   uint32_t next();
+   int below(int n) { return static_cast<int>(next() % static_cast<uint32_t>(n)); }
+};
+
+// A cheap, randomised stand-in for ClanAI used inside rollouts: a few checks per
+// village and unit, no influence maps or path searches.  Writes at most maxCommands
+// commands and returns how many.
+int planPosture(const GameState& state, int clanIdx, ClanPosture posture, MctsRandom& random,
+   Command* out, int maxCommands);
+
+// Share of the total strength (villages, population, units, gold) held by a clan, in [0, 1]
+float evaluateClan(const GameState& state, int clanIdx);
+
+struct MctsStats
+{
+   int rollouts = 0;
+   int nodes = 0;          // Summed over every tree
+   double ms = 0.0;
+   double rolloutsPerSecond = 0.0;
+   ClanPosture best = ClanPosture::ECONOMY;
+   float bestValue = 0.0f; // Mean rollout value of the chosen posture
+};
+
+// Monte Carlo tree search over a clan's postures for the coming turns, within a wall
+// time budget.  The tree is open loop: nodes hold only statistics, and every iteration
+// replays its path from a fresh copy of the root state, with the other clans playing
+// random postures.  Each worker grows its own tree (root parallelism) from its own
+// state copy, and the root visit counts are summed to pick the posture.
+//
+// The trees and states are sized on the first search, so from then on an iteration
+// (state copy, descent, rollout through processEndOfTurn) allocates nothing.
+class MctsPlanner
+{
+public:
+   ClanPosture search(const GameState& state, int clanIdx, double budgetMs, WorkerPool* pool = nullptr);
+
+   // Searches, then plays the chosen posture on the real state (through recorder if given)
+   void playTurn(GameState& state, int clanIdx, double budgetMs, WorkerPool* pool = nullptr, ReplayRecorder* recorder = nullptr);
+
+   const MctsStats& lastStats() const { return m_stats; }
+
+private:
+   struct Node
+   {
+      int parent;
+      int firstChild;  // Children are CLAN_POSTURE_COUNT consecutive nodes, -1 until expanded
+      int visits;
+      float value;     // Sum of rollout values
+      ClanPosture posture;
+   };
+
+   struct Tree
+   {
+      std::vector<Node> nodes;
+      int nodeCount = 0;
+      int rollouts = 0;
+      GameState state;
+      std::vector<Command> commands;
+      MctsRandom random;
+   };
+
+   using Clock = std::chrono::steady_clock;
+
+   void resize(const GameState& state, int trees);
+   void grow(Tree& tree, const GameState& root, int clanIdx, Clock::time_point deadline);
+   void playSimulatedTurn(Tree& tree, int clanIdx, ClanPosture posture);
+
+   std::vector<Tree> m_trees;
+   MctsStats m_stats;
+   uint64_t m_searches = 0;
+};
+
+#endif
@@ -0,0 +1,266 @@
+#include "Pathfinding.h"
+#include "GameState.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cstdlib>
+
+MovementClass movementClassFor(unsigned int abilities)
+{
+   return (abilities & abilityBit(SpecialAbility::FLY)) ? MovementClass::FLYING : MovementClass::LAND;
+}
+
+int terrainMoveCost(Terrain terrain, MovementClass movement)
+{
+   if (movement == MovementClass::FLYING) return 1;
+
+   switch (terrain)
+   {
+   case Terrain::WATER:     return 0;
+   case Terrain::DESERT:    return 1;
+   case Terrain::GRASSLAND: return 1;
+   case Terrain::FOREST:    return 2;
+   case Terrain::SWAMP:     return 2;
+   case Terrain::HILLS:     return 2;
+   case Terrain::MOUNTAIN:  return 3;
+   }
+   return 1;
+}
+
+void MovementCostGrid::rebuild(const GameState& state)
+{
+   m_width = state.width;
+   m_height = state.height;
+   const int cells = m_width * m_height;
+   for (int m = 0; m < MOVEMENT_CLASS_COUNT; ++m)
+   {
+      m_cost[m].resize(cells);
+      for (int i = 0; i < cells; ++i)
+         m_cost[m][i] = static_cast<uint8_t>(terrainMoveCost(state.map[i].terrain, static_cast<MovementClass>(m)));
+   }
+}
+
+void MovementCostGrid::updateTile(const GameState& state, int idx)
+{
+   for (int m = 0; m < MOVEMENT_CLASS_COUNT; ++m)
+      m_cost[m][idx] = static_cast<uint8_t>(terrainMoveCost(state.map[idx].terrain, static_cast<MovementClass>(m)));
+}
+
+void Pathfinder::resize(int width, int height)
+{
+   m_width = width;
+   m_height = height;
+   const int cells = width * height;
+   m_g.assign(cells, 0);
+   m_f.assign(cells, 0);
+   m_parent.assign(cells, -1);
+   m_stamp.assign(cells, 0);
+   m_closed.assign(cells, 0);
+   m_heap.assign(cells, 0);
+   m_heapPos.assign(cells, -1);
+   m_heapSize = 0;
+   m_search = 0;
+   clearBounds();
+}
+
+void Pathfinder::setBounds(int minX, int minY, int maxX, int maxY)
+{
+   m_minX = minX < 0 ? 0 : minX;
+   m_minY = minY < 0 ? 0 : minY;
+   m_maxX = maxX > m_width ? m_width : maxX;
+   m_maxY = maxY > m_height ? m_height : maxY;
+}
+
+void Pathfinder::clearBounds()
+{
+   setBounds(0, 0, m_width, m_height);
+}
+
+void Pathfinder::siftUp(int pos)
+{
+   const int idx = m_heap[pos];
+   while (pos > 0)
+   {
+      const int parent = (pos - 1) / 2;
+      if (m_f[m_heap[parent]] <= m_f[idx]) break;
+      m_heap[pos] = m_heap[parent];
+      m_heapPos[m_heap[pos]] = pos;
+      pos = parent;
+   }
+   m_heap[pos] = idx;
+   m_heapPos[idx] = pos;
+}
+
+void Pathfinder::siftDown(int pos)
+{
+   const int idx = m_heap[pos];
+   for (;;)
+   {
+      int child = pos * 2 + 1;
+      if (child >= m_heapSize) break;
+      if (child + 1 < m_heapSize && m_f[m_heap[child + 1]] < m_f[m_heap[child]]) ++child;
+      if (m_f[m_heap[child]] >= m_f[idx]) break;
+      m_heap[pos] = m_heap[child];
+      m_heapPos[m_heap[pos]] = pos;
+      pos = child;
+   }
+   m_heap[pos] = idx;
+   m_heapPos[idx] = pos;
+}
+
+void Pathfinder::heapPush(int idx)
+{
+   m_heap[m_heapSize] = idx;
+   siftUp(m_heapSize++);
+}
+
+int Pathfinder::heapPop()
+{
+   const int top = m_heap[0];
+   m_heapPos[top] = -1;
+   if (--m_heapSize > 0)
+   {
+      m_heap[0] = m_heap[m_heapSize];
+      siftDown(0);
+   }
+   return top;
+}
+
+void Pathfinder::heapDecrease(int idx)
+{
+   siftUp(m_heapPos[idx]);
+}
+
+int Pathfinder::findPath(const MovementCostGrid& grid, MovementClass movement, int startX, int startY,
+   int goalX, int goalY, PathStep* out, int maxSteps, int* totalCost)
+{
+   m_expanded = 0;
+   if (totalCost) *totalCost = 0;
+   if (startX < m_minX || startX >= m_maxX || startY < m_minY || startY >= m_maxY) return -1;
+   if (goalX < m_minX || goalX >= m_maxX || goalY < m_minY || goalY >= m_maxY) return -1;
+   if (startX == goalX && startY == goalY) return 0;
+
+   const int goal = goalY * m_width + goalX;
+   if (grid.cost(movement, goal) == 0) return -1;
+
+   // Wrapping the stamp would make stale entries look current, so start over
+   if (++m_search == 0)
+   {
+      std::fill(m_stamp.begin(), m_stamp.end(), 0);
+      m_search = 1;
+   }
+   m_heapSize = 0;
+
+   const int start = startY * m_width + startX;
+   m_stamp[start] = m_search;
+   m_g[start] = 0;
+   m_f[start] = std::max(std::abs(goalX - startX), std::abs(goalY - startY));
+   m_parent[start] = -1;
+   m_closed[start] = 0;
+   heapPush(start);
+
+   bool found = false;
+   while (m_heapSize > 0)
+   {
+      const int current = heapPop();
+      if (current == goal)
+      {
+         found = true;
+         break;
+      }
+      m_closed[current] = 1;
+      ++m_expanded;
+
+      const int cx = current % m_width;
+      const int cy = current / m_width;
+      for (int n = 0; n < 8; ++n)
+      {
+         const int nx = cx + NEIGHBOR_DX[n];
+         const int ny = cy + NEIGHBOR_DY[n];
+         if (nx < m_minX || nx >= m_maxX || ny < m_minY || ny >= m_maxY) continue;
+
+         const int next = ny * m_width + nx;
+         const int stepCost = grid.cost(movement, next);
+         if (stepCost == 0) continue;
+
+         const int g = m_g[current] + stepCost;
+         if (m_stamp[next] != m_search)
+         {
+            m_stamp[next] = m_search;
+            m_closed[next] = 0;
+            m_g[next] = g;
+            // Chebyshev distance: every step costs at least 1 and diagonals are allowed
+            m_f[next] = g + std::max(std::abs(goalX - nx), std::abs(goalY - ny));
+            m_parent[next] = current;
+            heapPush(next);
+         }
+         else if (!m_closed[next] && g < m_g[next])
+         {
+            m_f[next] -= m_g[next] - g;
+            m_g[next] = g;
+            m_parent[next] = current;
+            heapDecrease(next);
+         }
+      }
+   }
+
+   if (!found) return -1;
+
+   int length = 0;
+   for (int idx = goal; idx != start; idx = m_parent[idx])
+      ++length;
+   if (length > maxSteps) return -1;
+
+   int pos = length;
+   for (int idx = goal; idx != start; idx = m_parent[idx])
+   {
+      --pos;
+      out[pos].x = idx % m_width;
+      out[pos].y = idx / m_width;
+   }
+   if (totalCost) *totalCost = m_g[goal];
+   return length;
+}
+
+void PathService::init(const GameState& state, int workers)
+{
+   m_grid.rebuild(state);
+   m_finders.resize(workers < 1 ? 1 : workers);
+   for (auto& finder : m_finders)
+      finder.resize(state.width, state.height);
+}
+
+void PathService::solve(const PathRequest* requests, int count, PathResult* results,
+   PathStep* steps, int maxStepsPerPath, WorkerPool* pool)
+{
+   // Every worker needs a finder of its own
+   if (pool && pool->workerCount() > (int)m_finders.size())
+   {
+      const size_t have = m_finders.size();
+      m_finders.resize(pool->workerCount());
+      for (size_t f = have; f < m_finders.size(); ++f)
+         m_finders[f].resize(m_grid.width(), m_grid.height());
+   }
+
+   auto solveOne = [&](int i, int worker)
+   {
+      const PathRequest& req = requests[i];
+      PathResult& result = results[i];
+      Pathfinder& finder = m_finders[worker];
+      if (req.window > 0)
+         finder.setBounds(req.startX - req.window, req.startY - req.window, req.startX + req.window + 1, req.startY + req.window + 1);
+      else
+         finder.clearBounds();
+      result.length = finder.findPath(m_grid, req.movement, req.startX, req.startY,
+         req.goalX, req.goalY, steps + static_cast<size_t>(i) * maxStepsPerPath, maxStepsPerPath, &result.cost);
+   };
+
+   if (pool)
+   {
+      pool->parallelFor(count, solveOne);
+   }
+   else
+   {
+      for (int i = 0; i < count; ++i)
+         solveOne(i, 0);
+   }
+}
@@ -0,0 +1,131 @@
+#ifndef PATHFINDING_H
+#define PATHFINDING_H
+
+#include "Game.h"
+#include <cstdint>
+#include <vector>
+
+struct GameState;
+class WorkerPool;
+
+// How a unit crosses terrain.  FLY units ignore terrain and water.
+enum class MovementClass : uint8_t
+{
+   LAND, FLYING
+};
+const int MOVEMENT_CLASS_COUNT = 2;
+
+MovementClass movementClassFor(unsigned int abilities);
+
+// Cost to enter a tile of the given terrain; 0 means impassable
+int terrainMoveCost(Terrain terrain, MovementClass movement);
+
+// Per-tile entry costs for every movement class, flattened from the map once so that
+// searches read one byte per tile.  Rebuild after generation; update single tiles
+// when terrain changes.
+class MovementCostGrid
+{
+public:
+   void rebuild(const GameState& state);
+   void updateTile(const GameState& state, int idx);
+
+   int width() const { return m_width; }
+   int height() const { return m_height; }
+   uint8_t cost(MovementClass movement, int idx) const { return m_cost[static_cast<int>(movement)][idx]; }
+
+private:
+   int m_width = 0;
+   int m_height = 0;
+   std::vector<uint8_t> m_cost[MOVEMENT_CLASS_COUNT];
+};
+
+// Units move to any of the 8 neighbours; these are in the order the searches try them
+const int NEIGHBOR_DX[8] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+const int NEIGHBOR_DY[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+
+struct PathStep
+{
+   int x, y;
+};
+
+// A* over the tile grid.  All scratch memory (costs, parents, the indexed binary heap)
+// is sized once by resize() and reused; a per-search stamp marks which entries are
+// current, so nothing is cleared or allocated per query.  Not thread-safe: give each
+// thread its own Pathfinder.
+class Pathfinder
+{
+public:
+   void resize(int width, int height);
+
+   // Writes the path from start (exclusive) to goal (inclusive) into out.  Returns the
+   // number of steps, or -1 if the goal is unreachable or the path is longer than
+   // maxSteps.  If totalCost is given it receives the summed entry cost.
+   int findPath(const MovementCostGrid& grid, MovementClass movement, int startX, int startY,
+      int goalX, int goalY, PathStep* out, int maxSteps, int* totalCost = nullptr);
+
+   // Nodes expanded by the last findPath, for profiling
+   int lastExpanded() const { return m_expanded; }
+
+   // Limits searches to a rectangle (inclusive min, exclusive max); used for local refinement
+   void setBounds(int minX, int minY, int maxX, int maxY);
+   void clearBounds();
+
+private:
+   void heapPush(int idx);
+   int heapPop();
+   void heapDecrease(int idx);
+   void siftUp(int pos);
+   void siftDown(int pos);
+
+   int m_width = 0;
+   int m_height = 0;
+   int m_minX = 0, m_minY = 0, m_maxX = 0, m_maxY = 0;
+
+   std::vector<int> m_g;          // Cost from start
+   std::vector<int> m_f;          // g + heuristic
+   std::vector<int> m_parent;
+   std::vector<uint32_t> m_stamp; // == m_search when the entries above belong to this search
+   std::vector<uint8_t> m_closed;
+   std::vector<int> m_heap;       // Tile indices ordered by m_f
+   std::vector<int> m_heapPos;    // Position of a tile in m_heap, -1 if not in it
+   int m_heapSize = 0;
+   uint32_t m_search = 0;
+   int m_expanded = 0;
+};
+
+struct PathRequest
+{
+   int startX, startY;
+   int goalX, goalY;
+   MovementClass movement;
+   int window; // If > 0 the search stays within this many tiles of the start, so an unreachable goal cannot flood the map
+};
+
+struct PathResult
+{
+   int length;  // Steps written, or -1 if no path
+   int cost;
+};
+
+// Answers batches of path requests, optionally spread over a WorkerPool.  Request i
+// writes its steps to steps[i * maxStepsPerPath]; the caller owns both arrays, so a
+// batch allocates nothing once the service has been sized for the map and the pool.
+class PathService
+{
+public:
+   // Rebuilds the grid from the map and sizes one Pathfinder per worker.  solve adds
+   // finders if it is handed a pool with more workers.
+   void init(const GameState& state, int workers);
+   void onTileChanged(const GameState& state, int idx) { m_grid.updateTile(state, idx); }
+
+   const MovementCostGrid& grid() const { return m_grid; }
+
+   void solve(const PathRequest* requests, int count, PathResult* results,
+      PathStep* steps, int maxStepsPerPath, WorkerPool* pool = nullptr);
+
+private:
+   MovementCostGrid m_grid;
+   std::vector<Pathfinder> m_finders; // One per worker
+};
+
+#endif
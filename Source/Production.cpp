@@ -0,0 +1,80 @@
+#include "Production.h"
+#include "Clan.h"
+#include "TechTree.h"
+#include <cstring>
+
+static ProductionModifier modifier(int building, ResourceType resource, int add, int percent = 0)
+{
+   ProductionModifier m;
+   m.building = static_cast<int8_t>(building);
+   m.resource = static_cast<uint8_t>(resource);
+   m.add = static_cast<int16_t>(add);
+   m.percent = static_cast<int16_t>(percent);
+   return m;
+}
+
+static int buildingIdx(BuildingType type)
+{
+   return static_cast<int>(type);
+}
+
+// What every village makes before traits and techs
+static const ProductionModifier BASE_MODIFIERS[] =
+{
+   modifier(PRODUCTION_VILLAGE, ResourceType::RES_FOOD, BASE_FOOD),
+   modifier(PRODUCTION_VILLAGE, ResourceType::RES_PRODUCTION, BASE_PRODUCTION),
+   modifier(PRODUCTION_VILLAGE, ResourceType::RES_GOLD, BASE_GOLD),
+   modifier(PRODUCTION_VILLAGE, ResourceType::RES_KNOWLEDGE, BASE_KNOWLEDGE),
+   modifier(PRODUCTION_VILLAGE, ResourceType::RES_WORSHIP, BASE_WORSHIP),
+   modifier(buildingIdx(BuildingType::FARM), ResourceType::RES_FOOD, 1),
+   modifier(buildingIdx(BuildingType::LOGGING_CAMP), ResourceType::RES_PRODUCTION, 1),
+   modifier(buildingIdx(BuildingType::MINE), ResourceType::RES_GOLD, 1),
+   modifier(buildingIdx(BuildingType::WORSHIP_SITE), ResourceType::RES_WORSHIP, 1),
+   modifier(buildingIdx(BuildingType::LIBRARY), ResourceType::RES_KNOWLEDGE, 1),
+};
+
+static const ProductionModifier GREEN_THUMBS_MODIFIERS[] =
+{
+   modifier(buildingIdx(BuildingType::FARM), ResourceType::RES_FOOD, 1),
+};
+
+static const ProductionModifier PROSPECTORS_MODIFIERS[] =
+{
+   modifier(buildingIdx(BuildingType::MINE), ResourceType::RES_GOLD, 1),
+};
+
+void applyModifiers(ProductionTable& table, const ProductionModifier* modifiers, int count)
+{
+   for (int i = 0; i < count; ++i)
+   {
+      const ProductionModifier& m = modifiers[i];
+      int16_t& add = m.building == PRODUCTION_VILLAGE ? table.base[m.resource] : table.perBuilding[m.building][m.resource];
+      add = static_cast<int16_t>(add + m.add);
+      table.percent[m.resource] = static_cast<int16_t>(table.percent[m.resource] + m.percent);
+   }
+}
+
+template <size_t N>
+static void applyModifiers(ProductionTable& table, const ProductionModifier (&modifiers)[N])
+{
+   applyModifiers(table, modifiers, static_cast<int>(N));
+}
+
+void compileProduction(Clan& clan, const TechTree& tree)
+{
+   ProductionTable& table = clan.production;
+   std::memset(&table, 0, sizeof(table));
+   for (int r = 0; r < RESOURCE_TYPE_COUNT; ++r)
+      table.percent[r] = 100;
+
+   applyModifiers(table, BASE_MODIFIERS);
+   if (clan.traits & traitBit(ClanTrait::GREEN_THUMBS)) applyModifiers(table, GREEN_THUMBS_MODIFIERS);
+   if (clan.traits & traitBit(ClanTrait::PROSPECTORS)) applyModifiers(table, PROSPECTORS_MODIFIERS);
+
+   for (int t = 0; t < tree.count(); ++t)
+   {
+      const std::vector<ProductionModifier>& effects = tree.tech(t).effects;
+      if (clan.researched.test(t) && !effects.empty())
+         applyModifiers(table, effects.data(), (int)effects.size());
+   }
+}
@@ -0,0 +1,54 @@
+#ifndef PRODUCTION_H
+#define PRODUCTION_H
+
+#include "Game.h"
+#include <cstdint>
+
+struct Clan;
+class TechTree;
+
+// Clan traits, stored as a bitmask in Clan::traits
+enum class ClanTrait
+{
+   GREEN_THUMBS,   // Farms yield an extra food
+   PROSPECTORS     // Mines yield an extra gold
+};
+
+constexpr uint32_t traitBit(ClanTrait trait) { return 1u << static_cast<int>(trait); }
+
+const int PRODUCTION_VILLAGE = -1; // Modifier target: the village itself rather than its buildings
+
+// One entry in a clan's production stack: a flat amount added to a resource per
+// building of a type (or once per village), or a percentage added to the resource's
+// final multiplier.  Buildings, traits and techs all contribute these.
+struct ProductionModifier
+{
+   int8_t building = PRODUCTION_VILLAGE; // A BuildingType, or PRODUCTION_VILLAGE
+   uint8_t resource = 0;                 // A ResourceType
+   int16_t add = 0;
+   int16_t percent = 0;
+};
+
+// A clan's modifier stack compiled into flat coefficients.  A village yields, per
+// resource,
+//
+//    (base + sum over building types of count * perBuilding) * percent / 100
+//
+// so production costs the same however many modifiers are stacked.  Compiled data is
+// derived from the traits and techs, so it is not part of the world hash.
+struct ProductionTable
+{
+   int16_t base[RESOURCE_TYPE_COUNT];
+   int16_t perBuilding[BUILDING_TYPE_COUNT][RESOURCE_TYPE_COUNT];
+   int16_t percent[RESOURCE_TYPE_COUNT];
+};
+
+// Folds modifiers into a table.  Adds and percentages both sum, so the order they
+// are applied in does not matter.
+void applyModifiers(ProductionTable& table, const ProductionModifier* modifiers, int count);
+
+// Recompiles clan.production from the base yields, the clan's traits and the techs it
+// has researched.  Call whenever any of those change.
+void compileProduction(Clan& clan, const TechTree& tree);
+
+#endif
@@ -1,10 +1,187 @@
 #include "Render.h"
+#include "Fog.h"
+#include "Territory.h"
+#include "Units.h"
+#include <algorithm>
 
-void drawView(const std::vector<SquareTile>& map, Texture2D& tileset,
+// Unexplored tiles stay clear, so the background shows through as black.  villageClan
+// and landClan are as the player last saw them, TERRITORY_NONE for none.
+static Color minimapColor(const GameState& state, int idx, bool explored, bool visible, int villageClan, int landClan)
+{
+   if (!explored) return BLANK;
+
+   const SquareTile& tile = state.map[idx];
+   Color color;
+   if (villageClan != TERRITORY_NONE)
+      color = state.clans[villageClan].color;
+   else if (tile.terrain == Terrain::WATER)
+      color = { 37, 70, 184, 255 };
+   else
+      color = { 33, 122, 0, 255 };
+
+   // Claimed land takes on a tint of its clan's color
+   if (landClan != TERRITORY_NONE && villageClan == TERRITORY_NONE && tile.terrain != Terrain::WATER)
+   {
+      const Color& tint = state.clans[landClan].color;
+      color = { (unsigned char)((color.r + tint.r) / 2), (unsigned char)((color.g + tint.g) / 2),
+                (unsigned char)((color.b + tint.b) / 2), 255 };
+   }
+
+   // Explored but out of sight: dimmed
+   if (!visible)
+      color = { (unsigned char)(color.r / 2), (unsigned char)(color.g / 2), (unsigned char)(color.b / 2), 255 };
+   return color;
+}
+
+void Minimap::reset(const TurnEventLog& events)
+{
+   m_cursor = events.cursorAtHead();
+   m_redrawAll = true;
+   m_seenVillageClan.clear();
+   m_seenLandClan.clear();
+}
+
+int Minimap::seenVillageClan(const GameState& state, int idx) const
+{
+   const int clan = idx < (int)m_seenVillageClan.size() ? m_seenVillageClan[idx] : SEEN_UNKNOWN;
+   if (clan != SEEN_UNKNOWN) return clan;
+   return state.map[idx].hasVillage ? state.villages[state.map[idx].villageIdx].clanIdx : TERRITORY_NONE;
+}
+
+void Minimap::invalidate(int idx)
+{
+   if (m_dirty[idx]) return;
+   m_dirty[idx] = 1;
+   m_dirtyCells.push_back(idx);
+}
+
+void Minimap::invalidateArea(const GameState& state, int tileIdx, int reach)
+{
+   if (reach >= TERRITORY_REACH_MAX)
+   {
+      m_redrawAll = true;
+      return;
+   }
+   const int cx = tileIdx % state.width;
+   const int cy = tileIdx / state.width;
+   for (int y = std::max(cy - reach, 0); y <= std::min(cy + reach, state.height - 1); ++y)
+      for (int x = std::max(cx - reach, 0); x <= std::min(cx + reach, state.width - 1); ++x)
+         invalidate(state.tileIndex(x, y));
+}
+
+void Minimap::update(const GameState& state, const TurnEventLog& events)
+{
+   const int words = state.height * state.fogWordsPerRow;
+   if (m_width != state.width || m_height != state.height || m_terrainStamp != state.terrainStamp)
+      m_redrawAll = true;
+
+   // Only the events that can recolour land matter here; falling behind means anything may have
+   TurnEvent e;
+   const uint64_t dropped = m_cursor.dropped;
+   while (!m_redrawAll && events.read(m_cursor, e))
+   {
+      switch (e.type)
+      {
+      case TurnEventType::VILLAGE_FOUNDED:
+      case TurnEventType::VILLAGE_CAPTURED:
+      case TurnEventType::VILLAGE_DESTROYED:
+         invalidate(e.value);
+         break;
+      case TurnEventType::TERRITORY_CHANGED:
+         invalidateArea(state, e.value, e.detail);
+         break;
+      default:
+         break;
+      }
+   }
+   if (m_cursor.dropped != dropped)
+      m_redrawAll = true;
+
+   if (m_redrawAll)
+   {
+      m_cursor = events.cursorAtHead();
+      m_width = state.width;
+      m_height = state.height;
+      m_terrainStamp = state.terrainStamp;
+      m_pixels.assign(static_cast<size_t>(m_width) * m_height, BLANK);
+      m_dirty.assign(m_pixels.size(), 0);
+      m_dirtyCells.clear();
+      m_explored.assign(words, 0);
+      m_visible.assign(words, 0);
+      // What the player remembers outlives a redraw, but not a new map
+      if (m_seenVillageClan.size() != m_pixels.size())
+      {
+         m_seenVillageClan.assign(m_pixels.size(), SEEN_UNKNOWN);
+         m_seenLandClan.assign(m_pixels.size(), SEEN_UNKNOWN);
+      }
+      for (int idx = 0; idx < (int)m_pixels.size(); ++idx)
+         invalidate(idx);
+      if (m_texture.id != 0)
+         UnloadTexture(m_texture);
+      Image image = { m_pixels.data(), m_width, m_height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+      m_texture = LoadTextureFromImage(image);
+      m_redrawAll = false;
+   }
+
+   // A word of fog covers 64 tiles, so an unchanged stretch costs one compare
+   for (int y = 0; y < state.height; ++y)
+   {
+      const uint64_t* explored = exploredRow(state, PLAYER_CLAN, y);
+      const uint64_t* visible = visibleRow(state, PLAYER_CLAN, y);
+      for (int word = 0; word < state.fogWordsPerRow; ++word)
+      {
+         const int cached = y * state.fogWordsPerRow + word;
+         for (uint64_t bits = (explored[word] ^ m_explored[cached]) | (visible[word] ^ m_visible[cached]); bits != 0; bits &= bits - 1)
+            invalidate(state.tileIndex(word * 64 + lowestSetBit(bits), y));
+         m_explored[cached] = explored[word];
+         m_visible[cached] = visible[word];
+      }
+   }
+
+   if (m_dirtyCells.empty()) return;
+   for (int idx : m_dirtyCells)
+   {
+      const int x = idx % state.width;
+      const int y = idx / state.width;
+      const bool visible = isTileVisible(state, PLAYER_CLAN, x, y);
+      // A change in sight dirties the cell, so the memory of it is current when sight is lost
+      if (visible || m_seenVillageClan[idx] == SEEN_UNKNOWN)
+      {
+         m_seenVillageClan[idx] = state.map[idx].hasVillage ? state.villages[state.map[idx].villageIdx].clanIdx : TERRITORY_NONE;
+         m_seenLandClan[idx] = territoryClan(state, idx);
+      }
+      m_pixels[idx] = minimapColor(state, idx, isTileExplored(state, PLAYER_CLAN, x, y), visible,
+         m_seenVillageClan[idx], m_seenLandClan[idx]);
+      m_dirty[idx] = 0;
+   }
+   m_dirtyCells.clear();
+   UpdateTexture(m_texture, m_pixels.data());
+}
+
+void Minimap::draw() const
+{
+   if (m_texture.id == 0) return;
+   Rectangle src = { 0, 0, float(m_width), float(m_height) };
+   Rectangle dest = { MINIMAP_OFFSET_X, MINIMAP_OFFSET_Y, float(m_width * MINIMAP_CELL_SIZE), float(m_height * MINIMAP_CELL_SIZE) };
+   DrawTexturePro(m_texture, src, dest, { 0, 0 }, 0.0f, WHITE);
+}
+
+void Minimap::unload()
+{
+   if (m_texture.id != 0)
+      UnloadTexture(m_texture);
+   m_texture = {};
+   m_redrawAll = true;
+}
+
+void drawView(const GameState& state, const Minimap& minimap, Texture2D& tileset,
    int viewX, int viewY, float& waterAnimTime, int& waterFrame,
-   const std::vector<Clan>& clans, const std::vector<Village>& villages, Font& gameFont, Font& largeFont,
-   int selectedVillageIdx, int currentTurn)
+   Font& gameFont, Font& largeFont, VillageHandle selectedVillage)
 {
+   const std::vector<SquareTile>& map = state.map;
+   const std::vector<Clan>& clans = state.clans;
+   const std::vector<Village>& villages = state.villages;
+
    waterAnimTime += GetFrameTime();
    if (waterAnimTime >= WATER_ANIM_SPEED)
    {
@@ -12,23 +189,7 @@ void drawView(const std::vector<SquareTile>& map, Texture2D& tileset,
       waterAnimTime -= WATER_ANIM_SPEED;
    }
 
-   // Minimap
-   for (int y = 0; y < GRID_HEIGHT; ++y)
-   {
-      for (int x = 0; x < GRID_WIDTH; ++x)
-      {
-         int idx = y * GRID_WIDTH + x;
-         Rectangle miniDest = { MINIMAP_OFFSET_X + x * MINIMAP_CELL_SIZE,
-                              MINIMAP_OFFSET_Y + y * MINIMAP_CELL_SIZE,
-                              MINIMAP_CELL_SIZE, MINIMAP_CELL_SIZE };
-         if (map[idx].hasVillage)
-            DrawRectangleRec(miniDest, clans[villages[map[idx].villageIdx].clanIdx].color);
-         else if (map[idx].terrain == Terrain::WATER)
-            DrawRectangleRec(miniDest, { 37, 70, 184, 255 });
-         else
-            DrawRectangleRec(miniDest, { 33, 122, 0, 255 });
-      }
-   }
+   minimap.draw();
 
    Rectangle viewRect = { MINIMAP_OFFSET_X + (viewX - VIEW_TILES_X / 2) * MINIMAP_CELL_SIZE,
                         MINIMAP_OFFSET_Y + (viewY - VIEW_TILES_Y / 2) * MINIMAP_CELL_SIZE,
@@ -46,6 +207,10 @@ void drawView(const std::vector<SquareTile>& map, Texture2D& tileset,
          int mapY = startY + y;
          if (mapX < 0 || mapX >= GRID_WIDTH || mapY < 0 || mapY >= GRID_HEIGHT) continue;
 
+         // Never seen: leave it black
+         if (!isTileExplored(state, PLAYER_CLAN, mapX, mapY)) continue;
+         const bool inSight = isTileVisible(state, PLAYER_CLAN, mapX, mapY);
+
          int idx = mapY * GRID_WIDTH + mapX;
          const SquareTile& tile = map[idx];
          Rectangle dest = { VIEW_OFFSET_X + x * TILE_SIZE, VIEW_OFFSET_Y + y * TILE_SIZE, TILE_SIZE, TILE_SIZE };
@@ -71,23 +236,45 @@ void drawView(const std::vector<SquareTile>& map, Texture2D& tileset,
          default: break;
          }
 
-         if (tile.hasVillage)
+         // Under fog, the village as the player last saw it: captures and razings out of sight stay hidden
+         const int villageClan = inSight ? (tile.hasVillage ? villages[tile.villageIdx].clanIdx : TERRITORY_NONE)
+                                         : minimap.seenVillageClan(state, idx);
+         if (villageClan != TERRITORY_NONE)
          {
-            src = clans[villages[tile.villageIdx].clanIdx].villageTile;
+            src = clans[villageClan].villageTile;
             DrawTexturePro(tileset, src, dest, { 0, 0 }, 0.0f, WHITE);
          }
+
+         // Remembered terrain and villages show through the fog, units do not
+         if (!inSight)
+         {
+            DrawRectangleRec(dest, { 0, 0, 0, 128 });
+            continue;
+         }
+
+         // Units: a marker in the top unit's clan color, with a count for stacks
+         const int unitSlot = firstUnitOnTile(state, mapX, mapY);
+         if (unitSlot >= 0)
+         {
+            const Unit& unit = state.units[unitSlot];
+            DrawRectangle(int(dest.x) + TILE_SIZE - 10, int(dest.y) + 2, 8, 8, clans[unit.clanIdx].color);
+            DrawRectangleLines(int(dest.x) + TILE_SIZE - 10, int(dest.y) + 2, 8, 8, BLACK);
+            const int stack = countUnitsOnTile(state, mapX, mapY);
+            if (stack > 1)
+               DrawTextEx(gameFont, std::to_string(stack).c_str(), { dest.x + 2, dest.y + 2 }, 9, 1, WHITE);
+         }
       }
    }
 
    // Clan stockpile panel
    int yPos = CLAN_PANEL_Y;
    const Clan& redFang = clans[0];
-   DrawTextEx(largeFont, redFang.name.c_str(), { float(CLAN_PANEL_X), float(yPos) }, 18, 1, WHITE);
+   DrawTextEx(largeFont, redFang.name, { float(CLAN_PANEL_X), float(yPos) }, 18, 1, WHITE);
    yPos += 20;
 
    std::string goldText = "Gold: " + std::to_string(redFang.gold);
    int goldPerTurn = 0;
-   for (const int vIdx : redFang.villages) goldPerTurn += villages[vIdx].goldOutput;
+   for (int vIdx = redFang.firstVillage; vIdx >= 0; vIdx = villages[vIdx].nextInClan) goldPerTurn += villages[vIdx].goldOutput;
    std::string goldPerTurnText = (goldPerTurn >= 0 ? "+" : "") + std::to_string(goldPerTurn);
    DrawTextEx(gameFont, goldText.c_str(), { float(CLAN_PANEL_X), float(yPos) }, 9, 1, WHITE);
    DrawTextEx(gameFont, goldPerTurnText.c_str(), { float(CLAN_PANEL_X + 80), float(yPos) }, 9, 1, goldPerTurn >= 0 ? WHITE : RED);
@@ -95,7 +282,7 @@ void drawView(const std::vector<SquareTile>& map, Texture2D& tileset,
 
    std::string knowledgeText = "Knowledge: " + std::to_string(redFang.knowledge);
    int knowledgePerTurn = 0;
-   for (const int vIdx : redFang.villages) knowledgePerTurn += villages[vIdx].knowledgeOutput;
+   for (int vIdx = redFang.firstVillage; vIdx >= 0; vIdx = villages[vIdx].nextInClan) knowledgePerTurn += villages[vIdx].knowledgeOutput;
    std::string knowledgePerTurnText = (knowledgePerTurn >= 0 ? "+" : "") + std::to_string(knowledgePerTurn);
    DrawTextEx(gameFont, knowledgeText.c_str(), { float(CLAN_PANEL_X), float(yPos) }, 9, 1, WHITE);
    DrawTextEx(gameFont, knowledgePerTurnText.c_str(), { float(CLAN_PANEL_X + 80), float(yPos) }, 9, 1, knowledgePerTurn >= 0 ? WHITE : RED);
@@ -103,19 +290,20 @@ void drawView(const std::vector<SquareTile>& map, Texture2D& tileset,
 
    std::string worshipText = "Worship: " + std::to_string(redFang.worship);
    int worshipPerTurn = 0;
-   for (const int vIdx : redFang.villages) worshipPerTurn += villages[vIdx].worshipOutput;
+   for (int vIdx = redFang.firstVillage; vIdx >= 0; vIdx = villages[vIdx].nextInClan) worshipPerTurn += villages[vIdx].worshipOutput;
    std::string worshipPerTurnText = (worshipPerTurn >= 0 ? "+" : "") + std::to_string(worshipPerTurn);
    DrawTextEx(gameFont, worshipText.c_str(), { float(CLAN_PANEL_X), float(yPos) }, 9, 1, WHITE);
    DrawTextEx(gameFont, worshipPerTurnText.c_str(), { float(CLAN_PANEL_X + 80), float(yPos) }, 9, 1, worshipPerTurn >= 0 ? WHITE : RED);
 
    // === Village Info Panel (below clan panel when a village is selected) ===
-   if (selectedVillageIdx >= 0 && selectedVillageIdx < (int)villages.size())
+   // The handle goes stale if the village is razed, which closes the panel
+   if (const Village* selected = getVillage(state, selectedVillage))
    {
-      const Village& v = villages[selectedVillageIdx];
+      const Village& v = *selected;
       int vy = yPos + 20; // start a bit below the clan worship line
 
       // Village header
-      std::string header = v.name + " (Pop: " + std::to_string(v.population) + ")";
+      std::string header = std::string(v.name) + " (Pop: " + std::to_string(v.population) + ")";
       DrawTextEx(largeFont, header.c_str(), { float(CLAN_PANEL_X), float(vy) }, 14, 1, WHITE);
       vy += 18;
 
@@ -146,9 +334,51 @@ void drawView(const std::vector<SquareTile>& map, Texture2D& tileset,
    DrawRectangle(BTN_X, BTN_Y, BTN_W, BTN_H, DARKGRAY);
    DrawRectangleLines(BTN_X, BTN_Y, BTN_W, BTN_H, WHITE);
 
-   std::string btnText = "End Turn (Turn " + std::to_string(currentTurn) + ")";
+   std::string btnText = "End Turn (Turn " + std::to_string(state.currentTurn) + ")";
    int textWidth = MeasureTextEx(gameFont, btnText.c_str(), 9, 1).x;
    DrawTextEx(gameFont, btnText.c_str(),
               { float(BTN_X + (BTN_W - textWidth) / 2), float(BTN_Y + 5) },
               9, 1, WHITE);
+}
+
+void drawTurnProfiler(const TurnProfiler& profiler, Font& font)
+{
+   const int PANEL_X = VIEW_OFFSET_X + 4;
+   const int PANEL_Y = VIEW_OFFSET_Y + 4;
+   const int PANEL_W = TURN_PROFILE_HISTORY + 8;
+   const int GRAPH_H = 24;
+   const int PANEL_H = 14 + TURN_PHASE_COUNT * 10 + GRAPH_H + 8;
+
+   DrawRectangle(PANEL_X, PANEL_Y, PANEL_W, PANEL_H, { 0, 0, 0, 192 });
+
+   if (profiler.count() == 0)
+   {
+      DrawTextEx(font, "No turns profiled yet", { float(PANEL_X + 4), float(PANEL_Y + 4) }, 9, 1, WHITE);
+      return;
+   }
+
+   const TurnTimings& last = profiler.latest();
+   std::string header = "Turn " + std::to_string(last.turn) + ": " + TextFormat("%.3f ms", last.totalMs);
+   DrawTextEx(font, header.c_str(), { float(PANEL_X + 4), float(PANEL_Y + 2) }, 9, 1, YELLOW);
+
+   int yPos = PANEL_Y + 14;
+   for (int p = 0; p < TURN_PHASE_COUNT; ++p)
+   {
+      DrawTextEx(font, turnPhaseName(static_cast<TurnPhase>(p)), { float(PANEL_X + 4), float(yPos) }, 9, 1, WHITE);
+      DrawTextEx(font, TextFormat("%.3f", last.phaseMs[p]), { float(PANEL_X + 80), float(yPos) }, 9, 1, WHITE);
+      yPos += 10;
+   }
+
+   // One column per kept turn, scaled to the slowest
+   double maxMs = 0.0;
+   for (int i = 0; i < profiler.count(); ++i)
+      if (profiler.at(i).totalMs > maxMs) maxMs = profiler.at(i).totalMs;
+
+   const int graphBottom = yPos + 4 + GRAPH_H;
+   for (int i = 0; i < profiler.count() && maxMs > 0.0; ++i)
+   {
+      int h = static_cast<int>(profiler.at(i).totalMs / maxMs * GRAPH_H);
+      if (h < 1) h = 1;
+      DrawRectangle(PANEL_X + 4 + i, graphBottom - h, 1, h, GREEN);
+   }
 }
\ No newline at end of file
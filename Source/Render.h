@@ -4,10 +4,59 @@
 #include "Game.h"
 #include "Map.h"
 #include "Clan.h"
+#include "GameState.h"
+#include "TurnEvents.h"
+#include "TurnProfiler.h"
+#include "Villages.h"
+#include <vector>
 
-void drawView(const std::vector<SquareTile>& map, Texture2D& tileset,
+const int SEEN_UNKNOWN = -2; // A Minimap tile memory not yet filled in
+
+// The player's minimap, one texel per tile.  A cell is only recoloured when a turn
+// event reports a village or territory change around it or the player's fog over it
+// changes; otherwise drawing it is a single blit.
+//
+// It also holds what the player last saw of each tile's village and territory owner,
+// which is what explored tiles out of sight show, so captures and razings in the fog
+// are not given away.  Memory only updates on a recoloured cell, and every change in
+// sight recolours one.
+class Minimap
+{
+public:
+   // Recolours every cell on the next update and reads events from the log's head on;
+   // after loading a game.  Forgets what was seen, so tiles out of sight show as they were at the load.
+   void reset(const TurnEventLog& events);
+   void update(const GameState& state, const TurnEventLog& events);
+   void draw() const;
+   void unload();
+
+   // Clan of the village the player last saw on the tile, or TERRITORY_NONE
+   int seenVillageClan(const GameState& state, int idx) const;
+
+private:
+   void invalidate(int idx);
+   void invalidateArea(const GameState& state, int tileIdx, int reach);
+
+   std::vector<Color> m_pixels;
+   std::vector<uint8_t> m_dirty;
+   std::vector<int> m_dirtyCells;
+   std::vector<uint64_t> m_explored; // The player's fog as last drawn
+   std::vector<uint64_t> m_visible;
+   std::vector<int> m_seenVillageClan; // Per tile; SEEN_UNKNOWN until first drawn
+   std::vector<int> m_seenLandClan;
+   TurnEventCursor m_cursor;
+   Texture2D m_texture = {};
+   int m_width = 0;
+   int m_height = 0;
+   uint64_t m_terrainStamp = 0;
+   bool m_redrawAll = true;
+};
+
+void drawView(const GameState& state, const Minimap& minimap, Texture2D& tileset,
    int viewX, int viewY, float& waterAnimTime, int& waterFrame,
-   const std::vector<Clan>& clans, const std::vector<Village>& villages, Font& gameFont, Font& largeFont,
-   int selectedVillageIdx, int currentTurn);
+   Font& gameFont, Font& largeFont, VillageHandle selectedVillage);
+
+// F9 debug overlay: last turn's per-phase timings plus a graph of recent turn totals
+void drawTurnProfiler(const TurnProfiler& profiler, Font& font);
 
 #endif
\ No newline at end of file
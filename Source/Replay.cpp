@@ -0,0 +1,390 @@
+#include "Replay.h"
+#include "Clan.h"
+#include "GameState.h"
+#include "Map.h"
+#include "TechTree.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+   const char REPLAY_MAGIC[4] = { 'C', 'D', 'R', 'P' };
+   const uint8_t END_OF_TURN = 7;
+   const uint8_t SAME_CLAN = 0x08;
+
+   // MOVE directions, indexed by the tag's top bits
+   const int MOVE_DX[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+   const int MOVE_DY[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+
+   static_assert(static_cast<int>(CommandType::RESEARCH) < END_OF_TURN, "Command types must fit below the end of turn tag");
+   static_assert(BUILDING_TYPE_COUNT <= 16 && UNIT_TYPE_COUNT <= 16, "BUILD and TRAIN details must fit in the tag");
+
+   void putVarint(std::vector<uint8_t>& out, uint32_t value)
+   {
+      while (value >= 0x80)
+      {
+         out.push_back(static_cast<uint8_t>(value | 0x80));
+         value >>= 7;
+      }
+      out.push_back(static_cast<uint8_t>(value));
+   }
+
+   bool getVarint(const std::vector<uint8_t>& in, size_t& pos, uint32_t& value)
+   {
+      value = 0;
+      for (int shift = 0; shift < 35 && pos < in.size(); shift += 7)
+      {
+         const uint8_t byte = in[pos++];
+         value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+         if (!(byte & 0x80)) return true;
+      }
+      return false;
+   }
+
+   // Slot differences are small and either sign, so zigzag them before the varint
+   void putDelta(std::vector<uint8_t>& out, int value, int& last)
+   {
+      const int delta = value - last;
+      last = value;
+      putVarint(out, (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31));
+   }
+
+   bool getDelta(const std::vector<uint8_t>& in, size_t& pos, int& last)
+   {
+      uint32_t zigzag;
+      if (!getVarint(in, pos, zigzag)) return false;
+      last += static_cast<int>(zigzag >> 1) ^ -static_cast<int>(zigzag & 1);
+      return true;
+   }
+
+   // Fixed-size little-endian fields for the file header
+   void putFixed(std::vector<uint8_t>& out, uint64_t value, int bytes)
+   {
+      for (int i = 0; i < bytes; ++i)
+         out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+   }
+
+   bool getFixed(const std::vector<uint8_t>& in, size_t& pos, uint64_t& value, int bytes)
+   {
+      if (pos + bytes > in.size()) return false;
+      value = 0;
+      for (int i = 0; i < bytes; ++i)
+         value |= static_cast<uint64_t>(in[pos++]) << (8 * i);
+      return true;
+   }
+
+   uint64_t fnv(uint64_t h, uint64_t value)
+   {
+      for (int i = 0; i < 8; ++i)
+      {
+         h ^= (value >> (8 * i)) & 0xff;
+         h *= 0x100000001b3ULL;
+      }
+      return h;
+   }
+}
+
+uint64_t techFingerprint()
+{
+   const TechTree& tree = sharedTechTree();
+   uint64_t h = fnv(0xcbf29ce484222325ULL, tree.count());
+   for (int t = 0; t < tree.count(); ++t)
+   {
+      const TechInfo& tech = tree.tech(t);
+      for (char c : tech.id)
+         h = fnv(h, static_cast<uint8_t>(c));
+      h = fnv(h, tech.knowledgeCost);
+      h = fnv(h, tech.worshipCost);
+      for (int w = 0; w < TECH_WORDS; ++w)
+         h = fnv(h, tech.prerequisites.words[w]);
+      for (const ProductionModifier& effect : tech.effects)
+         h = fnv(h, static_cast<uint64_t>(static_cast<uint8_t>(effect.building)) | effect.resource << 8 |
+            static_cast<uint64_t>(static_cast<uint16_t>(effect.add)) << 16 | static_cast<uint64_t>(static_cast<uint16_t>(effect.percent)) << 32);
+   }
+   return h;
+}
+
+bool Replay::save(const std::string& path, std::string& error) const
+{
+   std::vector<uint8_t> bytes(REPLAY_MAGIC, REPLAY_MAGIC + 4);
+   putFixed(bytes, header.formatVersion, 2);
+   putFixed(bytes, header.rulesVersion, 2);
+   putFixed(bytes, header.seed, 4);
+   putFixed(bytes, header.techFingerprint, 8);
+   putFixed(bytes, header.scenario ? 1 : 0, 1);
+   putFixed(bytes, static_cast<uint32_t>(header.config.width), 4);
+   putFixed(bytes, static_cast<uint32_t>(header.config.height), 4);
+   putFixed(bytes, static_cast<uint32_t>(header.config.clans), 4);
+   putFixed(bytes, static_cast<uint32_t>(header.config.villages), 4);
+   putFixed(bytes, static_cast<uint32_t>(header.config.units), 4);
+   putFixed(bytes, static_cast<uint32_t>(header.turns), 4);
+   putFixed(bytes, header.finalHash, 8);
+   putFixed(bytes, stream.size(), 4);
+   bytes.insert(bytes.end(), stream.begin(), stream.end());
+
+   FILE* file = std::fopen(path.c_str(), "wb");
+   if (!file)
+   {
+      error = "cannot open " + path;
+      return false;
+   }
+   const bool written = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+   const bool closed = std::fclose(file) == 0;
+   if (!written || !closed)
+   {
+      error = "cannot write " + path;
+      return false;
+   }
+   return true;
+}
+
+bool Replay::load(const std::string& path, std::string& error)
+{
+   FILE* file = std::fopen(path.c_str(), "rb");
+   if (!file)
+   {
+      error = "cannot open " + path;
+      return false;
+   }
+   std::vector<uint8_t> bytes;
+   uint8_t buffer[4096];
+   size_t read;
+   while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+      bytes.insert(bytes.end(), buffer, buffer + read);
+   std::fclose(file);
+
+   size_t pos = 4;
+   uint64_t fields[13];
+   static const int SIZES[13] = { 2, 2, 4, 8, 1, 4, 4, 4, 4, 4, 4, 8, 4 };
+   bool valid = bytes.size() >= 4 && std::equal(REPLAY_MAGIC, REPLAY_MAGIC + 4, bytes.begin());
+   for (int f = 0; valid && f < 13; ++f)
+      valid = getFixed(bytes, pos, fields[f], SIZES[f]);
+   if (!valid)
+   {
+      error = path + " is not a replay";
+      return false;
+   }
+   if (fields[0] != REPLAY_FORMAT_VERSION)
+   {
+      error = path + " is replay format " + std::to_string(fields[0]) + ", expected " + std::to_string(REPLAY_FORMAT_VERSION);
+      return false;
+   }
+   if (bytes.size() - pos != fields[12])
+   {
+      error = path + " is truncated";
+      return false;
+   }
+
+   header.formatVersion = static_cast<uint16_t>(fields[0]);
+   header.rulesVersion = static_cast<uint16_t>(fields[1]);
+   header.seed = static_cast<uint32_t>(fields[2]);
+   header.techFingerprint = fields[3];
+   header.scenario = fields[4] != 0;
+   header.config.width = static_cast<int>(fields[5]);
+   header.config.height = static_cast<int>(fields[6]);
+   header.config.clans = static_cast<int>(fields[7]);
+   header.config.villages = static_cast<int>(fields[8]);
+   header.config.units = static_cast<int>(fields[9]);
+   header.turns = static_cast<int>(fields[10]);
+   header.finalHash = fields[11];
+   stream.assign(bytes.begin() + pos, bytes.end());
+   return true;
+}
+
+void ReplayRecorder::start(const GameState& state, bool scenario, const ScenarioConfig& config)
+{
+   m_replay = Replay();
+   m_replay.header.seed = state.seed;
+   m_replay.header.techFingerprint = techFingerprint();
+   m_replay.header.scenario = scenario;
+   m_replay.header.config = config;
+   m_replay.header.config.width = state.width;
+   m_replay.header.config.height = state.height;
+   m_recording = true;
+   m_lastClan = -1;
+   m_lastUnit = 0;
+   m_lastVillage = 0;
+}
+
+void ReplayRecorder::endTurn(const GameState& state)
+{
+   if (!m_recording) return;
+   m_replay.stream.push_back(END_OF_TURN);
+   putFixed(m_replay.stream, static_cast<uint32_t>(state.worldHash), 4);
+   ++m_replay.header.turns;
+}
+
+bool ReplayRecorder::apply(GameState& state, const Command& command)
+{
+   // applyCommand only carries out one-tile moves, so a direction and the unit's
+   // position before the move are enough to rebuild the target
+   int moveDirection = 0;
+   if (command.type == CommandType::MOVE)
+   {
+      if (const Unit* unit = getUnit(state, command.unit))
+         for (int d = 0; d < 8; ++d)
+            if (unit->x + MOVE_DX[d] == command.x && unit->y + MOVE_DY[d] == command.y) moveDirection = d;
+   }
+
+   if (!applyCommand(state, command)) return false;
+   if (m_recording) record(command, moveDirection);
+   return true;
+}
+
+void ReplayRecorder::record(const Command& command, int moveDirection)
+{
+   std::vector<uint8_t>& out = m_replay.stream;
+   uint8_t tag = static_cast<uint8_t>(command.type);
+   if (command.clanIdx == m_lastClan) tag |= SAME_CLAN;
+   if (command.type == CommandType::BUILD || command.type == CommandType::TRAIN)
+      tag |= command.detail << 4;
+   else if (command.type == CommandType::MOVE)
+      tag |= moveDirection << 4;
+   out.push_back(tag);
+   if (command.clanIdx != m_lastClan) putVarint(out, static_cast<uint32_t>(command.clanIdx));
+   m_lastClan = command.clanIdx;
+
+   switch (command.type)
+   {
+   case CommandType::BUILD:
+   case CommandType::TRAIN:
+      putDelta(out, command.village.index, m_lastVillage);
+      break;
+   case CommandType::MOVE:
+   case CommandType::FOUND_VILLAGE:
+      putDelta(out, command.unit.index, m_lastUnit);
+      break;
+   case CommandType::RESEARCH:
+      out.push_back(command.detail);
+      break;
+   }
+}
+
+void ReplayRecorder::finish(const GameState& state)
+{
+   if (!m_recording) return;
+   m_replay.header.finalHash = state.worldHash;
+   m_recording = false;
+}
+
+bool ReplayPlayer::start(const Replay& replay, GameState& state, std::string& error)
+{
+   m_replay = nullptr;
+   if (replay.header.rulesVersion != RULES_VERSION)
+   {
+      error = "replay is for rules version " + std::to_string(replay.header.rulesVersion) + ", this build is " + std::to_string(RULES_VERSION);
+      return false;
+   }
+   if (replay.header.techFingerprint != techFingerprint())
+   {
+      error = "replay was played with different tech data";
+      return false;
+   }
+
+   state.clear();
+   state.seed = replay.header.seed;
+   if (replay.header.scenario)
+   {
+      generateScenario(state, replay.header.config);
+   }
+   else
+   {
+      state.width = replay.header.config.width;
+      state.height = replay.header.config.height;
+      generateMap(state);
+   }
+
+   m_replay = &replay;
+   m_pos = 0;
+   m_lastClan = -1;
+   m_lastUnit = 0;
+   m_lastVillage = 0;
+   m_turnsPlayed = 0;
+   m_divergedTurn = -1;
+   return true;
+}
+
+bool ReplayPlayer::playTurn(GameState& state, TurnEventLog* events, TurnProfiler* profiler)
+{
+   if (finished() || diverged()) return false;
+
+   const std::vector<uint8_t>& in = m_replay->stream;
+   bool endedTurn = false;
+   while (m_pos < in.size())
+   {
+      const uint8_t tag = in[m_pos];
+      const int type = tag & 0x07;
+
+      // A turn is its end of turn marker and the commands after it, up to the next marker
+      if (type == END_OF_TURN)
+      {
+         if (endedTurn) break;
+         ++m_pos;
+         uint64_t hash;
+         if (!getFixed(in, m_pos, hash, 4) || hash != static_cast<uint32_t>(state.worldHash))
+         {
+            m_divergedTurn = state.currentTurn;
+            return false;
+         }
+         if (events) events->beginTurn(state.currentTurn);
+         if (profiler) profiler->beginTurn(state.currentTurn);
+         processEndOfTurn(state, events, profiler);
+         endedTurn = true;
+         continue;
+      }
+
+      ++m_pos;
+      Command command;
+      command.type = static_cast<CommandType>(type);
+      bool valid = type <= static_cast<int>(CommandType::RESEARCH);
+      uint32_t clan = static_cast<uint32_t>(m_lastClan);
+      if (valid && !(tag & SAME_CLAN)) valid = getVarint(in, m_pos, clan);
+      m_lastClan = static_cast<int>(clan);
+      command.clanIdx = m_lastClan;
+
+      switch (command.type)
+      {
+      case CommandType::BUILD:
+      case CommandType::TRAIN:
+         command.detail = tag >> 4;
+         valid = valid && getDelta(in, m_pos, m_lastVillage);
+         command.village = villageHandle(state, m_lastVillage);
+         break;
+      case CommandType::MOVE:
+         valid = valid && getDelta(in, m_pos, m_lastUnit);
+         command.unit = unitHandle(state, m_lastUnit);
+         if (const Unit* unit = getUnit(state, command.unit))
+         {
+            command.x = unit->x + MOVE_DX[(tag >> 4) & 7];
+            command.y = unit->y + MOVE_DY[(tag >> 4) & 7];
+         }
+         break;
+      case CommandType::FOUND_VILLAGE:
+         valid = valid && getDelta(in, m_pos, m_lastUnit);
+         command.unit = unitHandle(state, m_lastUnit);
+         break;
+      case CommandType::RESEARCH:
+         valid = valid && m_pos < in.size();
+         if (valid) command.detail = in[m_pos++];
+         break;
+      }
+
+      // Every recorded command was carried out, so one that is refused now means the game has drifted
+      if (!valid || !applyCommand(state, command))
+      {
+         m_divergedTurn = state.currentTurn;
+         return false;
+      }
+   }
+
+   if (profiler && endedTurn) profiler->endTurn();
+   ++state.currentTurn;
+   ++m_turnsPlayed;
+
+   if (finished() && state.worldHash != m_replay->header.finalHash)
+   {
+      m_divergedTurn = state.currentTurn - 1;
+      return false;
+   }
+   return true;
+}
@@ -0,0 +1,103 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "Commands.h"
+#include "Scenario.h"
+#include "TurnEvents.h"
+#include "TurnProfiler.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct GameState;
+
+const uint16_t REPLAY_FORMAT_VERSION = 1;
+
+// Everything needed to rebuild the starting world
+struct ReplayHeader
+{
+   uint16_t formatVersion = REPLAY_FORMAT_VERSION;
+   uint16_t rulesVersion = RULES_VERSION;
+   uint32_t seed = 0;
+   uint64_t techFingerprint = 0; // techFingerprint() of the tree the game was played with
+   bool scenario = false;        // Built by generateScenario from the config below, else generateMap
+   ScenarioConfig config;
+   int turns = 0;
+   uint64_t finalHash = 0;
+};
+
+// A game as its starting world plus the stream of commands that were carried out.
+// The stream is a byte code: one tag byte per record, then a few varints.
+//
+//    tag low 3 bits   record
+//    0..4             a CommandType; bit 3 set = same clan as the last command
+//    7                end of turn, followed by the low 32 bits of the world hash
+//
+// A MOVE keeps its direction in the tag's top bits and BUILD/TRAIN their type, and
+// unit and village slots are stored as differences from the previous one, so a
+// typical command takes two or three bytes.  Generations are not stored: replaying
+// rebuilds the same pools, so the live slot is always the one that was meant.
+struct Replay
+{
+   ReplayHeader header;
+   std::vector<uint8_t> stream;
+
+   bool save(const std::string& path, std::string& error) const;
+   bool load(const std::string& path, std::string& error);
+};
+
+// Identifies the loaded tech data, so a replay is not played against different techs
+uint64_t techFingerprint();
+
+// Builds a replay while a game is played.  Call endTurn just before each
+// processEndOfTurn, and carry out every command through apply rather than
+// applyCommand; rejected commands are left out.
+class ReplayRecorder
+{
+public:
+   void start(const GameState& state, bool scenario = false, const ScenarioConfig& config = ScenarioConfig());
+   void endTurn(const GameState& state);
+   bool apply(GameState& state, const Command& command); // applyCommand, recording the command if it was carried out
+   void finish(const GameState& state);
+
+   bool recording() const { return m_recording; }
+   const Replay& replay() const { return m_replay; }
+
+private:
+   void record(const Command& command, int moveDirection);
+
+   Replay m_replay;
+   bool m_recording = false;
+   int m_lastClan = -1;
+   int m_lastUnit = 0;
+   int m_lastVillage = 0;
+};
+
+// Plays a replay back one turn at a time, so a caller can run it flat out (headless
+// regression runs) or a turn every so often (watching it in the Map View).
+class ReplayPlayer
+{
+public:
+   // Rebuilds the starting world into state.  Fails on a format, rules or tech mismatch.
+   bool start(const Replay& replay, GameState& state, std::string& error);
+
+   // Plays up to and including the next end of turn.  Returns false once the stream
+   // is used up or the replay has diverged.
+   bool playTurn(GameState& state, TurnEventLog* events = nullptr, TurnProfiler* profiler = nullptr);
+
+   bool finished() const { return m_replay == nullptr || m_pos >= m_replay->stream.size(); }
+   bool diverged() const { return m_divergedTurn >= 0; }
+   int divergedTurn() const { return m_divergedTurn; } // First turn whose hash or command did not match
+   int turnsPlayed() const { return m_turnsPlayed; }
+
+private:
+   const Replay* m_replay = nullptr;
+   size_t m_pos = 0;
+   int m_lastClan = -1;
+   int m_lastUnit = 0;
+   int m_lastVillage = 0;
+   int m_turnsPlayed = 0;
+   int m_divergedTurn = -1;
+};
+
+#endif
@@ -0,0 +1,393 @@
+#include "SaveGame.h"
+#include "LineOfSight.h"
+#include "Production.h"
+#include "TechTree.h"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+namespace
+{
+   const char SAVE_MAGIC[4] = { 'C', 'D', 'S', 'V' };
+
+   uint64_t alignUp(uint64_t offset)
+   {
+      return (offset + SAVE_SECTION_ALIGNMENT - 1) / SAVE_SECTION_ALIGNMENT * SAVE_SECTION_ALIGNMENT;
+   }
+
+   uint32_t mixFingerprint(uint32_t h, uint32_t value)
+   {
+      h ^= value;
+      h *= 16777619u;
+      return h;
+   }
+
+   // Where each arena's bytes come from when saving
+   struct SectionSource
+   {
+      const void* data;
+      uint32_t elementSize;
+      uint64_t count;
+   };
+
+   template <typename T>
+   SectionSource sourceOf(const std::vector<T>& arena)
+   {
+      return { arena.data(), static_cast<uint32_t>(sizeof(T)), static_cast<uint64_t>(arena.size()) };
+   }
+
+   void gatherSections(const GameState& state, SectionSource (&sources)[SAVE_SECTION_COUNT])
+   {
+      sources[static_cast<int>(SaveSection::MAP)]                = sourceOf(state.map);
+      sources[static_cast<int>(SaveSection::CLANS)]              = sourceOf(state.clans);
+      sources[static_cast<int>(SaveSection::VILLAGES)]           = sourceOf(state.villages);
+      sources[static_cast<int>(SaveSection::QUEUE_ITEMS)]        = sourceOf(state.queueItems);
+      sources[static_cast<int>(SaveSection::UNITS)]              = sourceOf(state.units);
+      sources[static_cast<int>(SaveSection::TILE_FIRST_UNIT)]    = sourceOf(state.tileFirstUnit);
+      sources[static_cast<int>(SaveSection::FOG_EXPLORED)]       = sourceOf(state.fogExplored);
+      sources[static_cast<int>(SaveSection::FOG_VISIBLE)]        = sourceOf(state.fogVisible);
+      sources[static_cast<int>(SaveSection::FOG_VISION_COUNT)]   = sourceOf(state.fogVisionCount);
+      sources[static_cast<int>(SaveSection::TERRITORY_OWNER)]    = sourceOf(state.territoryOwner);
+      sources[static_cast<int>(SaveSection::TERRITORY_DISTANCE)] = sourceOf(state.territoryDistance);
+   }
+
+   // The minimap's view of the world, shrunk so its longest side fits SAVE_THUMBNAIL_MAX
+   void renderThumbnail(const GameState& state, std::vector<uint8_t>& pixels, uint32_t& width, uint32_t& height)
+   {
+      static const uint8_t TERRAIN_RGB[7][3] = {
+         { 40, 80, 200 },   // WATER
+         { 220, 200, 120 }, // DESERT
+         { 60, 170, 60 },   // GRASSLAND
+         { 20, 110, 40 },   // FOREST
+         { 80, 110, 70 },   // SWAMP
+         { 140, 120, 80 },  // HILLS
+         { 160, 160, 160 }  // MOUNTAIN
+      };
+
+      const int longest = state.width > state.height ? state.width : state.height;
+      const int step = (longest + SAVE_THUMBNAIL_MAX - 1) / SAVE_THUMBNAIL_MAX;
+      width = static_cast<uint32_t>((state.width + step - 1) / step);
+      height = static_cast<uint32_t>((state.height + step - 1) / step);
+      pixels.assign(static_cast<size_t>(width) * height * 4, 255);
+
+      for (uint32_t py = 0; py < height; ++py)
+      {
+         for (uint32_t px = 0; px < width; ++px)
+         {
+            const SquareTile& tile = state.map[state.tileIndex(px * step, py * step)];
+            uint8_t* out = &pixels[(static_cast<size_t>(py) * width + px) * 4];
+            const uint8_t* rgb = TERRAIN_RGB[static_cast<int>(tile.terrain)];
+            out[0] = rgb[0];
+            out[1] = rgb[1];
+            out[2] = rgb[2];
+         }
+      }
+
+      // Villages on top, so they show even when the sample point missed them
+      for (const Village& village : state.villages)
+      {
+         if (!village.alive) continue;
+         const Color color = state.clans[village.clanIdx].color;
+         uint8_t* out = &pixels[(static_cast<size_t>(village.y / step) * width + village.x / step) * 4];
+         out[0] = color.r;
+         out[1] = color.g;
+         out[2] = color.b;
+      }
+   }
+
+   bool writeBytes(FILE* file, const void* data, uint64_t bytes)
+   {
+      return bytes == 0 || std::fwrite(data, 1, static_cast<size_t>(bytes), file) == bytes;
+   }
+
+   bool padTo(FILE* file, uint64_t& written, uint64_t offset)
+   {
+      static const uint8_t ZEROS[SAVE_SECTION_ALIGNMENT] = {};
+      const uint64_t padding = offset - written;
+      written = offset;
+      return writeBytes(file, ZEROS, padding);
+   }
+
+   template <typename T>
+   bool sectionMatches(const SaveView& view, SaveSection id, uint64_t expected)
+   {
+      size_t count;
+      return view.section<T>(id, count) != nullptr && count == expected;
+   }
+
+   template <typename T>
+   void loadSection(const SaveView& view, SaveSection id, std::vector<T>& arena)
+   {
+      size_t count;
+      const T* data = view.section<T>(id, count);
+      arena.assign(data, data + count);
+   }
+}
+
+uint32_t saveLayoutFingerprint()
+{
+   const uint32_t byteOrder = 0x01020304;
+   uint8_t firstByte;
+   std::memcpy(&firstByte, &byteOrder, 1);
+
+   uint32_t h = 2166136261u;
+   h = mixFingerprint(h, firstByte);
+   h = mixFingerprint(h, sizeof(SquareTile));
+   h = mixFingerprint(h, sizeof(Clan));
+   h = mixFingerprint(h, sizeof(Village));
+   h = mixFingerprint(h, sizeof(QueueItem));
+   h = mixFingerprint(h, sizeof(Unit));
+   h = mixFingerprint(h, alignof(Village));
+   h = mixFingerprint(h, alignof(Unit));
+   return h;
+}
+
+bool saveGame(const GameState& state, const std::string& path, std::string& error)
+{
+   SectionSource sources[SAVE_SECTION_COUNT];
+   gatherSections(state, sources);
+
+   std::vector<uint8_t> thumbnail;
+   SaveHeader header = {};
+   std::memcpy(header.magic, SAVE_MAGIC, sizeof(header.magic));
+   header.formatVersion = SAVE_FORMAT_VERSION;
+   header.rulesVersion = RULES_VERSION;
+   header.headerSize = sizeof(SaveHeader);
+   header.layoutFingerprint = saveLayoutFingerprint();
+   header.seed = state.seed;
+   header.currentTurn = state.currentTurn;
+   header.width = state.width;
+   header.height = state.height;
+   header.worldHash = state.worldHash;
+   header.savedAt = static_cast<int64_t>(std::time(nullptr));
+   header.clanCount = (int32_t)state.clans.size();
+   header.liveVillageCount = state.liveVillageCount;
+   header.liveUnitCount = state.liveUnitCount;
+   header.firstFreeVillage = state.firstFreeVillage;
+   header.firstFreeQueueItem = state.firstFreeQueueItem;
+   header.firstFreeUnit = state.firstFreeUnit;
+   header.unitSlotsUsed = state.unitSlotsUsed;
+   header.fogWordsPerRow = state.fogWordsPerRow;
+   renderThumbnail(state, thumbnail, header.thumbnailWidth, header.thumbnailHeight);
+   header.sectionCount = SAVE_SECTION_COUNT;
+   header.sectionTableOffset = sizeof(SaveHeader);
+
+   // Lay the file out before writing any of it
+   SaveSectionEntry table[SAVE_SECTION_COUNT] = {};
+   header.thumbnailOffset = alignUp(header.sectionTableOffset + sizeof(table));
+   uint64_t offset = header.thumbnailOffset + thumbnail.size();
+   for (int s = 0; s < SAVE_SECTION_COUNT; ++s)
+   {
+      offset = alignUp(offset);
+      table[s].id = static_cast<SaveSection>(s);
+      table[s].elementSize = sources[s].elementSize;
+      table[s].encoding = SaveEncoding::RAW;
+      table[s].count = sources[s].count;
+      table[s].offset = offset;
+      table[s].bytes = sources[s].count * sources[s].elementSize;
+      offset += table[s].bytes;
+   }
+   header.fileSize = offset;
+
+   // Written beside the old save and renamed over it, so a crash never leaves half a save
+   const std::string tempPath = path + ".tmp";
+   FILE* file = std::fopen(tempPath.c_str(), "wb");
+   if (!file)
+   {
+      error = "cannot open " + tempPath;
+      return false;
+   }
+   uint64_t written = sizeof(header) + sizeof(table);
+   bool ok = writeBytes(file, &header, sizeof(header)) && writeBytes(file, table, sizeof(table)) &&
+      padTo(file, written, header.thumbnailOffset) && writeBytes(file, thumbnail.data(), thumbnail.size());
+   written += thumbnail.size();
+   for (int s = 0; ok && s < SAVE_SECTION_COUNT; ++s)
+   {
+      ok = padTo(file, written, table[s].offset) && writeBytes(file, sources[s].data, table[s].bytes);
+      written += table[s].bytes;
+   }
+   ok = ok && syncFile(file);
+   if (std::fclose(file) != 0) ok = false;
+   if (!ok)
+   {
+      error = "cannot write " + tempPath;
+      std::remove(tempPath.c_str());
+      return false;
+   }
+   if (!replaceFile(tempPath, path))
+   {
+      error = "cannot replace " + path;
+      std::remove(tempPath.c_str());
+      return false;
+   }
+   return true;
+}
+
+bool loadGame(GameState& state, const std::string& path, std::string& error)
+{
+   SaveView view;
+   if (!view.open(path, error)) return false;
+
+   const SaveHeader& header = view.header();
+   if (header.rulesVersion != RULES_VERSION)
+   {
+      error = path + " was saved under rules version " + std::to_string(header.rulesVersion) + ", this build is " +
+         std::to_string(RULES_VERSION);
+      return false;
+   }
+
+   // Check every arena has the shape the header promises before changing anything
+   const uint64_t tiles = static_cast<uint64_t>(header.width) * header.height;
+   const uint64_t fogLayer = static_cast<uint64_t>(header.clanCount) * header.height * header.fogWordsPerRow;
+   size_t units = 0, villages = 0, queueItems = 0, occupancy = 0, territory = 0;
+   const bool fog = header.fogWordsPerRow > 0;
+   const bool valid = header.width > 0 && header.height > 0 &&
+      view.section<Unit>(SaveSection::UNITS, units) != nullptr &&
+      view.section<Village>(SaveSection::VILLAGES, villages) != nullptr &&
+      view.section<QueueItem>(SaveSection::QUEUE_ITEMS, queueItems) != nullptr &&
+      view.section<int>(SaveSection::TERRITORY_OWNER, territory) != nullptr &&
+      sectionMatches<SquareTile>(view, SaveSection::MAP, tiles) &&
+      sectionMatches<Clan>(view, SaveSection::CLANS, header.clanCount) &&
+      view.section<int>(SaveSection::TILE_FIRST_UNIT, occupancy) != nullptr && (occupancy == 0 || occupancy == tiles) &&
+      sectionMatches<uint64_t>(view, SaveSection::FOG_EXPLORED, fog ? fogLayer : 0) &&
+      sectionMatches<uint64_t>(view, SaveSection::FOG_VISIBLE, fog ? fogLayer : 0) &&
+      sectionMatches<uint16_t>(view, SaveSection::FOG_VISION_COUNT, fog ? tiles * header.clanCount : 0) &&
+      (territory == 0 || territory == tiles) &&
+      sectionMatches<uint16_t>(view, SaveSection::TERRITORY_DISTANCE, territory);
+   if (!valid)
+   {
+      error = path + " is damaged";
+      return false;
+   }
+
+   state.clear();
+   state.width = header.width;
+   state.height = header.height;
+   state.currentTurn = header.currentTurn;
+   state.seed = header.seed;
+   state.worldHash = header.worldHash;
+   state.terrainStamp = nextTerrainStamp(); // Line of sight caches are per process, so this is never saved
+   state.firstFreeVillage = header.firstFreeVillage;
+   state.liveVillageCount = header.liveVillageCount;
+   state.firstFreeQueueItem = header.firstFreeQueueItem;
+   state.firstFreeUnit = header.firstFreeUnit;
+   state.liveUnitCount = header.liveUnitCount;
+   state.unitSlotsUsed = header.unitSlotsUsed;
+   state.fogWordsPerRow = header.fogWordsPerRow;
+   loadSection(view, SaveSection::MAP, state.map);
+   loadSection(view, SaveSection::CLANS, state.clans);
+   loadSection(view, SaveSection::VILLAGES, state.villages);
+   loadSection(view, SaveSection::QUEUE_ITEMS, state.queueItems);
+   loadSection(view, SaveSection::UNITS, state.units);
+   loadSection(view, SaveSection::TILE_FIRST_UNIT, state.tileFirstUnit);
+   loadSection(view, SaveSection::FOG_EXPLORED, state.fogExplored);
+   loadSection(view, SaveSection::FOG_VISIBLE, state.fogVisible);
+   loadSection(view, SaveSection::FOG_VISION_COUNT, state.fogVisionCount);
+   loadSection(view, SaveSection::TERRITORY_OWNER, state.territoryOwner);
+   loadSection(view, SaveSection::TERRITORY_DISTANCE, state.territoryDistance);
+
+   // Compiled tables follow the tech data this build loaded
+   for (Clan& clan : state.clans)
+      compileProduction(clan, sharedTechTree());
+   return true;
+}
+
+bool hasSaveMagic(const std::string& path)
+{
+   FILE* file = std::fopen(path.c_str(), "rb");
+   if (!file) return false;
+   char magic[sizeof(SAVE_MAGIC)];
+   const bool read = std::fread(magic, 1, sizeof(magic), file) == sizeof(magic);
+   std::fclose(file);
+   return read && std::memcmp(magic, SAVE_MAGIC, sizeof(magic)) == 0;
+}
+
+bool readSaveHeader(const std::string& path, SaveHeader& header, std::string& error)
+{
+   FILE* file = std::fopen(path.c_str(), "rb");
+   if (!file)
+   {
+      error = "cannot open " + path;
+      return false;
+   }
+   const size_t read = std::fread(&header, 1, sizeof(header), file);
+   std::fclose(file);
+   if (read < sizeof(header.magic) || std::memcmp(header.magic, SAVE_MAGIC, sizeof(header.magic)) != 0)
+   {
+      error = path + " is not a save";
+      return false;
+   }
+   if (read != sizeof(header) || header.headerSize != sizeof(SaveHeader))
+   {
+      error = path + " is damaged";
+      return false;
+   }
+   return true;
+}
+
+bool SaveView::open(const std::string& path, std::string& error)
+{
+   close();
+   if (!m_file.open(path))
+   {
+      error = "cannot open " + path;
+      return false;
+   }
+
+   const uint8_t* data = m_file.data();
+   const uint64_t size = m_file.size();
+   const SaveHeader* header = reinterpret_cast<const SaveHeader*>(data);
+   if (size < sizeof(header->magic) || std::memcmp(header->magic, SAVE_MAGIC, sizeof(header->magic)) != 0)
+   {
+      error = path + " is not a save";
+      m_file.close();
+      return false;
+   }
+   if (size < sizeof(SaveHeader) || header->headerSize != sizeof(SaveHeader))
+   {
+      error = path + " is damaged";
+      m_file.close();
+      return false;
+   }
+   if (header->formatVersion != SAVE_FORMAT_VERSION || header->layoutFingerprint != saveLayoutFingerprint())
+   {
+      error = path + " was written by an incompatible build";
+      m_file.close();
+      return false;
+   }
+
+   bool valid = header->fileSize == size && header->sectionTableOffset % 8 == 0 &&
+      header->sectionTableOffset + static_cast<uint64_t>(header->sectionCount) * sizeof(SaveSectionEntry) <= size &&
+      header->thumbnailOffset + static_cast<uint64_t>(header->thumbnailWidth) * header->thumbnailHeight * 4 <= size;
+   const SaveSectionEntry* sections = reinterpret_cast<const SaveSectionEntry*>(data + header->sectionTableOffset);
+   for (uint32_t s = 0; valid && s < header->sectionCount; ++s)
+   {
+      const SaveSectionEntry& entry = sections[s];
+      valid = entry.offset % SAVE_SECTION_ALIGNMENT == 0 && entry.offset <= size && entry.bytes <= size - entry.offset &&
+         (entry.encoding != SaveEncoding::RAW || entry.bytes == entry.count * entry.elementSize);
+   }
+   if (!valid)
+   {
+      error = path + " is damaged";
+      m_file.close();
+      return false;
+   }
+
+   m_header = header;
+   m_sections = sections;
+   return true;
+}
+
+const uint8_t* SaveView::thumbnail() const
+{
+   if (!m_header || m_header->thumbnailWidth == 0) return nullptr;
+   return m_file.data() + m_header->thumbnailOffset;
+}
+
+const SaveSectionEntry* SaveView::findSection(SaveSection id) const
+{
+   if (!m_header) return nullptr;
+   for (uint32_t s = 0; s < m_header->sectionCount; ++s)
+      if (m_sections[s].id == id) return &m_sections[s];
+   return nullptr;
+}
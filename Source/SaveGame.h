@@ -0,0 +1,130 @@
+#ifndef SAVEGAME_H
+#define SAVEGAME_H
+
+#include "GameState.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+
+const uint16_t SAVE_FORMAT_VERSION = 1;
+const int SAVE_SECTION_ALIGNMENT = 64; // Section offsets are multiples of this
+const int SAVE_THUMBNAIL_MAX = 128;    // Longest side of the thumbnail, in pixels
+
+// A save file is
+//
+//    SaveHeader | SaveSectionEntry[sectionCount] | thumbnail | sections...
+//
+// Every GameState arena is one section, written exactly as it sits in memory.  The
+// element types are plain data (see GameState.h), so a mapped section can be read in
+// place as an array of its type, and loading is one copy per arena: the cost is
+// paging the file in, not parsing fields.  The header alone tells a save browser
+// everything it lists, and where the thumbnail is, without touching the rest.
+//
+// Files are native layout.  The header's layoutFingerprint records the writer's
+// byte order and struct sizes, and a reader with different ones refuses the file.
+struct SaveHeader
+{
+   char magic[4];              // "CDSV"
+   uint16_t formatVersion;
+   uint16_t rulesVersion;
+   uint32_t headerSize;
+   uint32_t layoutFingerprint;
+   uint32_t seed;
+   int32_t currentTurn;
+   int32_t width, height;
+   uint64_t worldHash;
+   int64_t savedAt;            // Seconds since the epoch
+   int32_t clanCount;
+   int32_t liveVillageCount;
+   int32_t liveUnitCount;
+   int32_t firstFreeVillage;
+   int32_t firstFreeQueueItem;
+   int32_t firstFreeUnit;
+   int32_t unitSlotsUsed;
+   int32_t fogWordsPerRow;
+   uint32_t thumbnailWidth, thumbnailHeight;
+   uint64_t thumbnailOffset;   // RGBA8 rows, top row first
+   uint32_t sectionCount;
+   uint32_t reserved;
+   uint64_t sectionTableOffset;
+   uint64_t fileSize;
+};
+
+static_assert(sizeof(SaveHeader) == 120, "SaveHeader is a file layout; keep it packed and fixed");
+
+enum class SaveSection : uint32_t
+{
+   MAP, CLANS, VILLAGES, QUEUE_ITEMS, UNITS, TILE_FIRST_UNIT,
+   FOG_EXPLORED, FOG_VISIBLE, FOG_VISION_COUNT, TERRITORY_OWNER, TERRITORY_DISTANCE,
+   COUNT
+};
+
+const int SAVE_SECTION_COUNT = static_cast<int>(SaveSection::COUNT);
+
+// How a section's bytes are stored.  Only RAW sections can be used in place.
+enum class SaveEncoding : uint32_t
+{
+   RAW
+};
+
+struct SaveSectionEntry
+{
+   SaveSection id;
+   uint32_t elementSize;
+   SaveEncoding encoding;
+   uint32_t reserved;
+   uint64_t count;    // Elements
+   uint64_t offset;   // From the start of the file
+   uint64_t bytes;    // Stored size
+};
+
+static_assert(sizeof(SaveSectionEntry) == 40, "SaveSectionEntry is a file layout; keep it packed and fixed");
+
+// The struct sizes and byte order this build writes
+uint32_t saveLayoutFingerprint();
+
+// Writes path + ".tmp", syncs it and renames it over path, so an existing save is
+// only ever replaced by a complete one.  See Autosave.h to do this off the main thread.
+bool saveGame(const GameState& state, const std::string& path, std::string& error);
+
+// Replaces state with the saved game.  Fails, leaving state alone, on a missing or
+// damaged file, another format or rules version, or another layout.
+bool loadGame(GameState& state, const std::string& path, std::string& error);
+
+// True if the file starts with a save's magic, whatever state the rest is in.  Tells
+// a damaged save from some other kind of file, so the save's own error is reported.
+bool hasSaveMagic(const std::string& path);
+
+// Reads only the header, for listing saves
+bool readSaveHeader(const std::string& path, SaveHeader& header, std::string& error);
+
+// A save mapped into memory and checked, with its sections readable in place
+class SaveView
+{
+public:
+   bool open(const std::string& path, std::string& error);
+   void close() { m_file.close(); m_header = nullptr; }
+
+   const SaveHeader& header() const { return *m_header; }
+   const uint8_t* thumbnail() const; // header().thumbnailWidth x thumbnailHeight RGBA8, or nullptr
+
+   // The section as an array of T, or nullptr if it is missing, not RAW or not made of T
+   template <typename T>
+   const T* section(SaveSection id, size_t& count) const
+   {
+      const SaveSectionEntry* entry = findSection(id);
+      count = 0;
+      if (!entry || entry->encoding != SaveEncoding::RAW || entry->elementSize != sizeof(T)) return nullptr;
+      count = static_cast<size_t>(entry->count);
+      return reinterpret_cast<const T*>(m_file.data() + entry->offset);
+   }
+
+private:
+   const SaveSectionEntry* findSection(SaveSection id) const;
+
+   MappedFile m_file;
+   const SaveHeader* m_header = nullptr;
+   const SaveSectionEntry* m_sections = nullptr;
+};
+
+#endif
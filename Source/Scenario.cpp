@@ -0,0 +1,110 @@
+#include "Scenario.h"
+#include "Fog.h"
+#include "GameState.h"
+#include "Map.h"
+#include "Production.h"
+#include "StateHash.h"
+#include "TechTree.h"
+#include "Territory.h"
+#include "Units.h"
+#include "Villages.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+// Any land tile with no village on it or next to it
+static bool canPlaceVillage(const GameState& state, int x, int y)
+{
+   if (!state.inBounds(x, y) || state.map[state.tileIndex(x, y)].terrain == Terrain::WATER) return false;
+   for (int dy = -1; dy <= 1; ++dy)
+      for (int dx = -1; dx <= 1; ++dx)
+         if (state.inBounds(x + dx, y + dy) && state.map[state.tileIndex(x + dx, y + dy)].hasVillage) return false;
+   return true;
+}
+
+static int randomBelow(int n)
+{
+   return n > 0 ? std::rand() % n : 0;
+}
+
+void generateScenario(GameState& state, const ScenarioConfig& config)
+{
+   state.width = config.width;
+   state.height = config.height;
+   generateTerrain(state);
+   initUnitPool(state, config.units + config.units / 2 + DEFAULT_UNIT_CAPACITY); // Room for the AIs to train more
+
+   // Village icons and traits cycle through the four the base game uses
+   static const Rectangle VILLAGE_TILES[4] = {
+      {0 * 16.0f, 44 * 16.0f, 16, 16}, {1 * 16.0f, 6 * 16.0f, 16, 16}, {0 * 16.0f, 6 * 16.0f, 16, 16}, {1 * 16.0f, 44 * 16.0f, 16, 16} };
+   static const uint32_t TRAITS[4] = { 0, traitBit(ClanTrait::GREEN_THUMBS), traitBit(ClanTrait::PROSPECTORS), 0 };
+
+   state.clans.clear();
+   state.clans.reserve(config.clans);
+   state.villages.reserve(config.villages);
+   for (int c = 0; c < config.clans; ++c)
+   {
+      Clan clan;
+      char name[MAX_NAME_LENGTH];
+      std::snprintf(name, sizeof(name), "Clan %d", c + 1);
+      setName(clan.name, name);
+      // Pastels like the base clans, spread so neighbouring indices differ
+      clan.color = { static_cast<unsigned char>(128 + c * 53 % 128), static_cast<unsigned char>(128 + c * 97 % 128),
+         static_cast<unsigned char>(128 + c * 151 % 128), 255 };
+      clan.villageTile = VILLAGE_TILES[c % 4];
+      clan.traits = TRAITS[c % 4];
+      compileProduction(clan, sharedTechTree());
+      state.clans.push_back(clan);
+   }
+
+   // Each clan grows a cluster outwards from a random centre, widening its search
+   // whenever the nearby land fills up
+   for (int c = 0; c < config.clans; ++c)
+   {
+      const int target = config.villages / config.clans + (c < config.villages % config.clans ? 1 : 0);
+      const int centerX = randomBelow(state.width);
+      const int centerY = randomBelow(state.height);
+      int radius = static_cast<int>(std::sqrt(static_cast<float>(target))) * 2 + 4;
+      int placed = 0;
+      int misses = 0;
+      while (placed < target && radius <= state.width + state.height)
+      {
+         const int x = centerX + randomBelow(2 * radius + 1) - radius;
+         const int y = centerY + randomBelow(2 * radius + 1) - radius;
+         if (canPlaceVillage(state, x, y))
+         {
+            state.map[state.tileIndex(x, y)].terrain = Terrain::GRASSLAND;
+            foundVillage(state, x, y, c);
+            ++placed;
+            misses = 0;
+         }
+         else if (++misses > 64)
+         {
+            radius *= 2;
+            misses = 0;
+         }
+      }
+   }
+
+   // Units share out round-robin over the villages and stand within two tiles of one
+   const int villageCount = (int)state.villages.size();
+   static const UnitType MIX[8] = { UnitType::SPEARMAN, UnitType::SPEARMAN, UnitType::SPEARMAN, UnitType::ARCHER,
+      UnitType::ARCHER, UnitType::SWORDSMAN, UnitType::SHAMAN, UnitType::SETTLER };
+   for (int u = 0; u < config.units && villageCount > 0; ++u)
+   {
+      const Village& village = state.villages[u % villageCount];
+      int x = village.x + randomBelow(5) - 2;
+      int y = village.y + randomBelow(5) - 2;
+      if (!state.inBounds(x, y) || state.map[state.tileIndex(x, y)].terrain == Terrain::WATER)
+      {
+         x = village.x;
+         y = village.y;
+      }
+      if (!isValidUnit(state, createUnit(state, MIX[u % 8], village.clanIdx, x, y))) break;
+   }
+
+   initFog(state);
+   rebuildFog(state);
+   rebuildTerritory(state);
+   state.worldHash = computeWorldHash(state);
+}
@@ -0,0 +1,23 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+struct GameState;
+
+// A stress world for measuring how the turn engine scales.  The defaults are the
+// largest mode we are considering.
+struct ScenarioConfig
+{
+   int width = 1024;
+   int height = 1024;
+   int clans = 64;
+   int villages = 20000; // In total, shared evenly between the clans
+   int units = 100000;   // In total, spread around the villages
+};
+
+// Replaces the world in state with a scenario built from config, seeded from
+// state.seed.  Each clan's villages are clustered around a random centre, with no two
+// villages adjacent; units stand near their clan's villages.  Fewer villages are
+// placed if the land runs out, so check state.liveVillageCount and liveUnitCount.
+void generateScenario(GameState& state, const ScenarioConfig& config);
+
+#endif
@@ -0,0 +1,573 @@
+// Headless simulation runner: generates a world and plays end-of-turn
+// processing without opening a window.
+//
+// Usage: ClanDestinySim [--turns N] [--seed S] [--profile file.csv] [--verify-hash] [--ai-budget MS]
+//                       [--mcts-clan C] [--mcts-budget MS] [--techs file.json]
+//                       [--scenario] [--width W] [--height H] [--clans C] [--villages V] [--units U]
+//                       [--record file] | [--replay file] [--load file] [--load-turn N] [--save file]
+//                       [--autosave file] [--history file] [--verify-handles] [--verify-territory]
+//                       [--verify-battles] [--verify-odds] [--verify-techs]
+//                       [--verify-production] [--verify-queues] [--verify-save]
+//
+//   --seed         world seed (defaults to the current time)
+//   --verify-hash  recompute the world hash from scratch every turn and
+//                  fail if the incremental hash has drifted from it
+//   --ai-budget    wall time the AI may spend planning each turn (every clan
+//                  is AI-controlled); 0 turns the AI off and -1 removes the
+//                  deadline, which makes runs with the same seed repeatable
+//   --mcts-clan    clan played by the tree search AI instead (see Mcts.h)
+//   --mcts-budget  its search time per turn
+//   --scenario     play a stress world from generateScenario (see Scenario.h)
+//                  instead of the normal map; --width, --height, --clans,
+//                  --villages and --units change its size and imply it
+//   --record       save the game as a replay (see Replay.h)
+//   --replay       play a saved replay back as fast as possible, checking the
+//                  world hash every turn, instead of playing a new game
+//   --load         continue a saved game (see SaveGame.h) or a history
+//                  chain (see DeltaSave.h) instead of generating a world
+//   --load-turn    the turn of the history chain to continue from; defaults
+//                  to its last
+//   --save         save the game after the last turn
+//   --autosave     autosave to file every turn in the background, as the game
+//                  does (see Autosave.h), and report the main thread's cost
+//   --history      write a frame of the history chain every turn, then check
+//                  that the chain loads back to the same world; with
+//                  --verify-hash, that every turn in it does
+//   --verify-handles  before playing, check that freed unit and village slots come back
+//                  under a new generation (see SimVerify.h)
+//   --verify-territory  check the territory layer against a full rebuild after
+//                  founding and razing villages before playing, then every turn
+//   --verify-battles  before playing, check that battles replay identically
+//                  and that resolving one keeps the unit pool in step
+//   --verify-odds  before playing, check the memoized battle odds against
+//                  fresh simulations
+//   --verify-techs  check the loaded tech tree's closures and order, and that
+//                  the loader rejects broken trees
+//   --verify-production  after every turn, check each clan's compiled production
+//                  against a recompile
+//   --verify-queues  churn the build queues on a copy before playing, then check
+//                  the queue pool's bookkeeping after every turn
+//   --verify-save  with --save, load the save back and check it against the
+//                  game, then save it again and compare the bytes
+//
+// Every run ends with a benchmark summary: turns per second, peak resident
+// memory and the average time per turn of each phase.
+
+#include "Clan.h"
+#include "Autosave.h"
+#include "ClanAI.h"
+#include "DeltaSave.h"
+#include "GameState.h"
+#include "Map.h"
+#include "Mcts.h"
+#include "Replay.h"
+#include "SaveGame.h"
+#include "Scenario.h"
+#include "SimVerify.h"
+#include "StateHash.h"
+#include "TechTree.h"
+#include "TurnEvents.h"
+#include "TurnProfiler.h"
+#include "WorkerPool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[])
+{
+    int turns = 100;
+    std::string csvPath = "turn_profile.csv";
+    bool verifyHash = false;
+    bool verifyHandlesFirst = false;
+    bool verifyTerritoryEachTurn = false;
+    bool verifyBattlesFirst = false;
+    bool verifyOddsFirst = false;
+    bool verifyTechsFirst = false;
+    bool verifyProductionEachTurn = false;
+    bool verifyQueuesEachTurn = false;
+    bool verifySave = false;
+    double aiBudgetMs = DEFAULT_AI_BUDGET_MS;
+    int mctsClan = -1;
+    double mctsBudgetMs = DEFAULT_MCTS_BUDGET_MS;
+    std::string techPath = "Data/techs.json";
+    unsigned int seed = static_cast<unsigned int>(std::time(nullptr));
+    bool scenario = false;
+    ScenarioConfig scenarioConfig;
+    std::string recordPath;
+    std::string replayPath;
+    std::string loadPath;
+    std::string savePath;
+    std::string autosavePath;
+    std::string historyPath;
+    int loadTurn = -1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--turns") == 0 && i + 1 < argc)
+            turns = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+            csvPath = argv[++i];
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        else if (std::strcmp(argv[i], "--verify-hash") == 0)
+            verifyHash = true;
+        else if (std::strcmp(argv[i], "--verify-handles") == 0)
+            verifyHandlesFirst = true;
+        else if (std::strcmp(argv[i], "--verify-territory") == 0)
+            verifyTerritoryEachTurn = true;
+        else if (std::strcmp(argv[i], "--verify-battles") == 0)
+            verifyBattlesFirst = true;
+        else if (std::strcmp(argv[i], "--verify-odds") == 0)
+            verifyOddsFirst = true;
+        else if (std::strcmp(argv[i], "--verify-techs") == 0)
+            verifyTechsFirst = true;
+        else if (std::strcmp(argv[i], "--verify-production") == 0)
+            verifyProductionEachTurn = true;
+        else if (std::strcmp(argv[i], "--verify-queues") == 0)
+            verifyQueuesEachTurn = true;
+        else if (std::strcmp(argv[i], "--verify-save") == 0)
+            verifySave = true;
+        else if (std::strcmp(argv[i], "--ai-budget") == 0 && i + 1 < argc)
+            aiBudgetMs = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--mcts-clan") == 0 && i + 1 < argc)
+            mctsClan = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--mcts-budget") == 0 && i + 1 < argc)
+            mctsBudgetMs = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--techs") == 0 && i + 1 < argc)
+            techPath = argv[++i];
+        else if (std::strcmp(argv[i], "--scenario") == 0)
+            scenario = true;
+        else if (std::strcmp(argv[i], "--width") == 0 && i + 1 < argc)
+            scenario = true, scenarioConfig.width = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--height") == 0 && i + 1 < argc)
+            scenario = true, scenarioConfig.height = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--clans") == 0 && i + 1 < argc)
+            scenario = true, scenarioConfig.clans = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--villages") == 0 && i + 1 < argc)
+            scenario = true, scenarioConfig.villages = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--units") == 0 && i + 1 < argc)
+            scenario = true, scenarioConfig.units = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            replayPath = argv[++i];
+        else if (std::strcmp(argv[i], "--load") == 0 && i + 1 < argc)
+            loadPath = argv[++i];
+        else if (std::strcmp(argv[i], "--save") == 0 && i + 1 < argc)
+            savePath = argv[++i];
+        else if (std::strcmp(argv[i], "--autosave") == 0 && i + 1 < argc)
+            autosavePath = argv[++i];
+        else if (std::strcmp(argv[i], "--history") == 0 && i + 1 < argc)
+            historyPath = argv[++i];
+        else if (std::strcmp(argv[i], "--load-turn") == 0 && i + 1 < argc)
+            loadTurn = std::atoi(argv[++i]);
+        else
+        {
+            std::fprintf(stderr, "Usage: %s [--turns N] [--seed S] [--profile file.csv] [--verify-hash] [--ai-budget MS] [--mcts-clan C] [--mcts-budget MS] [--techs file.json]"
+                " [--scenario] [--width W] [--height H] [--clans C] [--villages V] [--units U]"
+                " [--record file | --replay file] [--load file] [--load-turn N] [--save file] [--autosave file] [--history file]"
+                " [--verify-handles] [--verify-territory] [--verify-battles] [--verify-odds] [--verify-techs]"
+                " [--verify-production] [--verify-queues] [--verify-save]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::string techError;
+    if (!sharedTechTree().loadFromFile(techPath, techError))
+        std::fprintf(stderr, "Tech tree not loaded (%s); nothing can be researched\n", techError.c_str());
+    if (verifyTechsFirst && !verifyTechs(sharedTechTree(), techError))
+    {
+        std::fprintf(stderr, "Tech tree check failed: %s\n", techError.c_str());
+        return 1;
+    }
+
+    if (scenario && (scenarioConfig.width < 16 || scenarioConfig.height < 16 || scenarioConfig.clans < 1 ||
+        scenarioConfig.villages < scenarioConfig.clans || scenarioConfig.units < 0))
+    {
+        std::fprintf(stderr, "A scenario needs at least 16x16 tiles, one clan and a village per clan\n");
+        return 2;
+    }
+
+    if (!loadPath.empty() && !recordPath.empty())
+    {
+        std::fprintf(stderr, "A replay starts from a generated world, so --record cannot follow --load\n");
+        return 2;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    GameState state;
+    if (!replayPath.empty())
+    {
+        Replay replay;
+        ReplayPlayer player;
+        std::string replayError;
+        if (!replay.load(replayPath, replayError) || !player.start(replay, state, replayError))
+        {
+            std::fprintf(stderr, "Cannot play %s: %s\n", replayPath.c_str(), replayError.c_str());
+            return 2;
+        }
+
+        const Clock::time_point replayStart = Clock::now();
+        while (player.playTurn(state)) {}
+        const double replayMs = std::chrono::duration<double, std::milli>(Clock::now() - replayStart).count();
+
+        std::printf("replay %s: %zu bytes, seed %u, %d of %d turns in %.1f ms, world hash %016llx\n", replayPath.c_str(),
+            replay.stream.size(), replay.header.seed, player.turnsPlayed(), replay.header.turns, replayMs,
+            (unsigned long long)state.worldHash);
+        if (player.diverged())
+        {
+            std::fprintf(stderr, "Replay diverged on turn %d\n", player.divergedTurn());
+            return 1;
+        }
+        if (player.turnsPlayed() != replay.header.turns)
+        {
+            std::fprintf(stderr, "Replay stopped after %d of its %d turns\n", player.turnsPlayed(), replay.header.turns);
+            return 1;
+        }
+        if (verifyHash && state.worldHash != computeWorldHash(state))
+        {
+            std::fprintf(stderr, "Replay ended with a world hash that does not match its contents\n");
+            return 1;
+        }
+        return 0;
+    }
+
+    state.seed = seed;
+    const Clock::time_point setupStart = Clock::now();
+    if (!loadPath.empty())
+    {
+        // A save if it starts like one, however damaged, else a history chain
+        std::string loadError;
+        const bool isSave = hasSaveMagic(loadPath);
+        if (isSave ? !loadGame(state, loadPath, loadError) : !loadDeltaChain(state, loadPath, loadTurn, loadError))
+        {
+            std::fprintf(stderr, "Cannot load: %s\n", loadError.c_str());
+            return 2;
+        }
+        seed = state.seed;
+    }
+    else if (scenario)
+        generateScenario(state, scenarioConfig);
+    else
+        generateMap(state);
+    const double setupMs = std::chrono::duration<double, std::milli>(Clock::now() - setupStart).count();
+    std::printf("world %dx%d: %d clans, %d villages, %d units, %s in %.1f ms\n", state.width, state.height,
+        (int)state.clans.size(), state.liveVillageCount, state.liveUnitCount, loadPath.empty() ? "generated" : "loaded",
+        setupMs);
+    if (!loadPath.empty() && state.worldHash != computeWorldHash(state))
+    {
+        std::fprintf(stderr, "%s loaded, but its world hash does not match its contents\n", loadPath.c_str());
+        return 1;
+    }
+    std::string verifyError;
+    if (verifyHandlesFirst && !verifyHandles(state, verifyError))
+    {
+        std::fprintf(stderr, "Handle check failed: %s\n", verifyError.c_str());
+        return 1;
+    }
+    if (verifyTerritoryEachTurn && !verifyTerritory(state, verifyError))
+    {
+        std::fprintf(stderr, "Territory check failed: %s\n", verifyError.c_str());
+        return 1;
+    }
+    if (verifyBattlesFirst && !verifyBattles(state, verifyError))
+    {
+        std::fprintf(stderr, "Battle check failed: %s\n", verifyError.c_str());
+        return 1;
+    }
+    if (verifyOddsFirst && !verifyOdds(state, verifyError))
+    {
+        std::fprintf(stderr, "Battle odds check failed: %s\n", verifyError.c_str());
+        return 1;
+    }
+    if (verifyQueuesEachTurn && !verifyQueues(state, verifyError))
+    {
+        std::fprintf(stderr, "Build queue check failed: %s\n", verifyError.c_str());
+        return 1;
+    }
+    if (mctsClan >= (int)state.clans.size())
+    {
+        std::fprintf(stderr, "--mcts-clan must be below %d\n", (int)state.clans.size());
+        return 2;
+    }
+
+    TurnEventLog events;
+    TurnProfiler profiler;
+    ClanAI ai;
+    int aiCommands = 0;
+    int aiPlansCut = 0;
+    int aiInfluenceReused = 0;
+    int aiClansDeferred = 0;
+    int aiRallyMoves = 0;
+    int aiFlowFieldBuilds = 0;
+    int aiLongPaths = 0;
+    double aiLongPathMsMax = 0.0;
+    double aiPlanMsMax = 0.0;
+    MctsPlanner mcts;
+    long long mctsRollouts = 0;
+    double mctsMs = 0.0;
+    double phaseMsSum[TURN_PHASE_COUNT] = {};
+    Autosaver autosaver;
+    AutosaveResult autosave;
+    double autosaveMsSum = 0.0;
+    double autosaveMsMax = 0.0;
+    DeltaWriter history;
+    double historyMsSum = 0.0;
+    double historyDeltaMsSum = 0.0;
+    uint64_t historyBytes = 0;
+    uint64_t historyDeltaBytes = 0;
+    uint32_t historyDeltaMax = 0;
+    int historyDeltas = 0;
+    std::vector<uint64_t> historyHashes; // World hash of each frame written, by turn from the first
+    if (!historyPath.empty())
+    {
+        std::string historyError;
+        if (!history.open(historyPath, state, historyError))
+        {
+            std::fprintf(stderr, "Cannot write the history: %s\n", historyError.c_str());
+            return 2;
+        }
+        historyBytes = sizeof(DeltaChainHeader) + history.lastFrameBytes();
+        historyHashes.push_back(state.worldHash);
+    }
+    ReplayRecorder recorder;
+    if (!recordPath.empty())
+        recorder.start(state, scenario, scenarioConfig);
+    ReplayRecorder* recording = recordPath.empty() ? nullptr : &recorder;
+    const Clock::time_point runStart = Clock::now();
+    for (int turn = 1; turn <= turns; ++turn)
+    {
+        events.beginTurn(state.currentTurn);
+        profiler.beginTurn(state.currentTurn);
+        recorder.endTurn(state);
+        processEndOfTurn(state, &events, &profiler);
+        {
+            ScopedPhaseTimer timer(&profiler, TurnPhase::AI);
+            if (aiBudgetMs != 0.0)
+            {
+                ai.playTurn(state, aiBudgetMs, mctsClan, &sharedWorkerPool(), recording);
+                aiCommands += ai.lastStats().commandsApplied;
+                aiPlansCut += ai.lastStats().plansCut;
+                aiInfluenceReused += ai.lastStats().influenceReused;
+                aiClansDeferred += ai.lastStats().clansDeferred;
+                aiRallyMoves += ai.lastStats().rallyMoves;
+                aiFlowFieldBuilds += ai.lastStats().flowFieldBuilds;
+                aiLongPaths += ai.lastStats().longPaths;
+                if (ai.lastStats().longPathMsMax > aiLongPathMsMax) aiLongPathMsMax = ai.lastStats().longPathMsMax;
+                if (ai.lastStats().planMs > aiPlanMsMax) aiPlanMsMax = ai.lastStats().planMs;
+            }
+            if (mctsClan >= 0)
+            {
+                mcts.playTurn(state, mctsClan, mctsBudgetMs, &sharedWorkerPool(), recording);
+                mctsRollouts += mcts.lastStats().rollouts;
+                mctsMs += mcts.lastStats().ms;
+            }
+        }
+        profiler.endTurn();
+        for (int p = 0; p < TURN_PHASE_COUNT; ++p)
+            phaseMsSum[p] += profiler.latest().phaseMs[p];
+        ++state.currentTurn;
+
+        if (history.isOpen())
+        {
+            std::string historyError;
+            const Clock::time_point historyStart = Clock::now();
+            if (!history.writeFrame(state, historyError))
+            {
+                std::fprintf(stderr, "Cannot write the history: %s\n", historyError.c_str());
+                return 1;
+            }
+            const double historyMs = std::chrono::duration<double, std::milli>(Clock::now() - historyStart).count();
+            historyMsSum += historyMs;
+            historyBytes += history.lastFrameBytes();
+            historyHashes.push_back(state.worldHash);
+            if (!history.lastFrameWasKeyframe())
+            {
+                ++historyDeltas;
+                historyDeltaMsSum += historyMs;
+                historyDeltaBytes += history.lastFrameBytes();
+                if (history.lastFrameBytes() > historyDeltaMax) historyDeltaMax = history.lastFrameBytes();
+            }
+        }
+
+        if (!autosavePath.empty())
+        {
+            // Everything the main thread pays for an autosave
+            const Clock::time_point autosaveStart = Clock::now();
+            autosaver.request(state, autosavePath);
+            const double autosaveMs = std::chrono::duration<double, std::milli>(Clock::now() - autosaveStart).count();
+            autosaveMsSum += autosaveMs;
+            if (autosaveMs > autosaveMsMax) autosaveMsMax = autosaveMs;
+            if (autosaver.poll(autosave) && !autosave.ok)
+            {
+                std::fprintf(stderr, "Autosave failed: %s\n", autosave.error.c_str());
+                return 1;
+            }
+        }
+
+        if (verifyHash && state.worldHash != computeWorldHash(state))
+        {
+            std::fprintf(stderr, "World hash mismatch after turn %d\n", turn);
+            return 1;
+        }
+        if (verifyTerritoryEachTurn && !territoryMatchesRebuild(state, verifyError))
+        {
+            std::fprintf(stderr, "Territory mismatch after turn %d: %s\n", turn, verifyError.c_str());
+            return 1;
+        }
+        if (verifyProductionEachTurn && !productionMatchesRecompile(state, sharedTechTree(), verifyError))
+        {
+            std::fprintf(stderr, "Production mismatch after turn %d: %s\n", turn, verifyError.c_str());
+            return 1;
+        }
+        if (verifyQueuesEachTurn && !queuesConsistent(state, verifyError))
+        {
+            std::fprintf(stderr, "Build queue mismatch after turn %d: %s\n", turn, verifyError.c_str());
+            return 1;
+        }
+    }
+
+    const double runSeconds = std::chrono::duration<double>(Clock::now() - runStart).count();
+
+    if (recording)
+    {
+        recorder.finish(state);
+        std::string replayError;
+        if (!recorder.replay().save(recordPath, replayError))
+        {
+            std::fprintf(stderr, "Could not save the replay: %s\n", replayError.c_str());
+            return 1;
+        }
+        std::printf("recorded %s: %d turns, %zu bytes of commands\n", recordPath.c_str(), recorder.replay().header.turns,
+            recorder.replay().stream.size());
+    }
+
+    if (!autosavePath.empty())
+    {
+        autosaver.wait();
+        if (autosaver.poll(autosave) && !autosave.ok)
+        {
+            std::fprintf(stderr, "Autosave failed: %s\n", autosave.error.c_str());
+            return 1;
+        }
+        std::printf("autosave %s: %d written, %d skipped while a write was still going, main thread %.3f ms average and"
+            " %.3f ms worst, last write %.1f ms on the autosave thread\n", autosavePath.c_str(),
+            turns - autosaver.superseded(), autosaver.superseded(), turns > 0 ? autosaveMsSum / turns : 0.0, autosaveMsMax,
+            autosave.writeMs);
+    }
+
+    if (history.isOpen())
+    {
+        history.close(state);
+        std::printf("history %s: %llu bytes, %d deltas of %.0f bytes average and %u worst, %d keyframes, main thread %.3f ms"
+            " per delta and %.3f ms/turn, worst write %.1f ms on the history thread\n",
+            historyPath.c_str(), (unsigned long long)historyBytes, historyDeltas,
+            historyDeltas > 0 ? (double)historyDeltaBytes / historyDeltas : 0.0, historyDeltaMax, turns + 1 - historyDeltas,
+            historyDeltas > 0 ? historyDeltaMsSum / historyDeltas : 0.0, turns > 0 ? historyMsSum / turns : 0.0,
+            history.writeMsMax());
+
+        GameState reloaded;
+        std::string historyError;
+        const Clock::time_point reloadStart = Clock::now();
+        if (!loadDeltaChain(reloaded, historyPath, -1, historyError) || reloaded.worldHash != state.worldHash)
+        {
+            std::fprintf(stderr, "The history does not load back to this game: %s\n", historyError.c_str());
+            return 1;
+        }
+        std::printf("history reloaded turn %d in %.1f ms\n", reloaded.currentTurn,
+            std::chrono::duration<double, std::milli>(Clock::now() - reloadStart).count());
+
+        // Every earlier turn too, each played forward from the keyframe before it
+        const int firstTurn = state.currentTurn - ((int)historyHashes.size() - 1);
+        for (int i = 0; verifyHash && i < (int)historyHashes.size(); ++i)
+        {
+            if (!loadDeltaChain(reloaded, historyPath, firstTurn + i, historyError) ||
+                reloaded.currentTurn != firstTurn + i || reloaded.worldHash != historyHashes[i] ||
+                reloaded.worldHash != computeWorldHash(reloaded))
+            {
+                std::fprintf(stderr, "Turn %d of the history does not load back to this game: %s\n", firstTurn + i,
+                    historyError.c_str());
+                return 1;
+            }
+        }
+    }
+
+    if (!savePath.empty())
+    {
+        std::string saveError;
+        const Clock::time_point saveStart = Clock::now();
+        if (!saveGame(state, savePath, saveError))
+        {
+            std::fprintf(stderr, "Could not save the game: %s\n", saveError.c_str());
+            return 1;
+        }
+        const double saveMs = std::chrono::duration<double, std::milli>(Clock::now() - saveStart).count();
+        SaveHeader header;
+        readSaveHeader(savePath, header, saveError);
+        std::printf("saved %s: turn %d, %llu bytes in %.1f ms\n", savePath.c_str(), header.currentTurn,
+            (unsigned long long)header.fileSize, saveMs);
+        if (verifySave && !verifySaveRoundTrip(state, savePath, saveError))
+        {
+            std::fprintf(stderr, "Save check failed: %s\n", saveError.c_str());
+            return 1;
+        }
+    }
+
+    double totalMs = 0.0;
+    for (int i = 0; i < profiler.count(); ++i)
+        totalMs += profiler.at(i).totalMs;
+
+    std::printf("seed %u: %d turns, %d villages, %llu events, world hash %016llx\n", seed, turns, state.liveVillageCount,
+        (unsigned long long)events.head(), (unsigned long long)state.worldHash);
+    if (aiBudgetMs != 0.0)
+    {
+        std::printf("ai: %d commands, %d units alive, %d plans cut at the deadline, %d clan turns left for the next, %d on older influence maps,"
+            " worst planning time %.3f ms\n", aiCommands, state.liveUnitCount, aiPlansCut, aiClansDeferred, aiInfluenceReused, aiPlanMsMax);
+        std::printf("ai rallies: %d moves stepped from %d flow fields built\n", aiRallyMoves, aiFlowFieldBuilds);
+        if (aiLongPaths > 0)
+            std::printf("ai long-range moves: %d planned through HPA*, worst %.3f ms for one\n", aiLongPaths, aiLongPathMsMax);
+    }
+    if (sharedTechTree().count() > 0)
+    {
+        // Per clan for the normal game, averaged for scenarios with dozens of clans
+        const bool perClan = state.clans.size() <= 8;
+        int total = 0;
+        std::printf("techs researched of %d:", sharedTechTree().count());
+        for (const Clan& clan : state.clans)
+        {
+            int researched = 0;
+            for (int t = 0; t < sharedTechTree().count(); ++t)
+                researched += clan.researched.test(t) ? 1 : 0;
+            total += researched;
+            if (perClan) std::printf(" %s %d", clan.name, researched);
+        }
+        if (!perClan) std::printf(" %.1f per clan on average", (double)total / state.clans.size());
+        std::printf("\n");
+    }
+    if (mctsClan >= 0)
+        std::printf("mcts: clan %d, %lld rollouts in %.1f ms, %.0f rollouts/s, share of strength %.3f\n", mctsClan,
+            mctsRollouts, mctsMs, mctsMs > 0.0 ? mctsRollouts * 1000.0 / mctsMs : 0.0, evaluateClan(state, mctsClan));
+    std::printf("last %d turns: %.3f ms total, %.4f ms/turn\n", profiler.count(), totalMs,
+        profiler.count() > 0 ? totalMs / profiler.count() : 0.0);
+
+    // Wall time covers the whole loop, so --verify-hash slows it down
+    std::printf("benchmark: %d turns in %.3f s, %.2f turns/s, peak RSS %.1f MB\n", turns, runSeconds,
+        runSeconds > 0.0 ? turns / runSeconds : 0.0, peakResidentBytes() / (1024.0 * 1024.0));
+    std::printf("ms/turn by phase:");
+    for (int p = 0; p < TURN_PHASE_COUNT; ++p)
+        std::printf(" %s %.3f", turnPhaseName(static_cast<TurnPhase>(p)), turns > 0 ? phaseMsSum[p] / turns : 0.0);
+    std::printf("\n");
+
+    if (!profiler.dumpCsv(csvPath))
+    {
+        std::fprintf(stderr, "Could not write %s\n", csvPath.c_str());
+        return 1;
+    }
+    std::printf("Wrote %s\n", csvPath.c_str());
+    return 0;
+}
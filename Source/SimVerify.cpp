@@ -0,0 +1,725 @@
+#include "SimVerify.h"
+#include "BattleOdds.h"
+#include "BuildQueues.h"
+#include "Combat.h"
+#include "SaveGame.h"
+#include "StateHash.h"
+#include "TechTree.h"
+#include "Territory.h"
+#include "Units.h"
+#include "Villages.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+// Every live unit is on its tile's list exactly once, with consistent back links
+static bool checkOccupancy(const GameState& state, std::string& error)
+{
+   int listed = 0;
+   for (int y = 0; y < state.height; ++y)
+   {
+      for (int x = 0; x < state.width; ++x)
+      {
+         int prev = -1;
+         for (int slot = firstUnitOnTile(state, x, y); slot >= 0; slot = state.units[slot].nextOnTile)
+         {
+            const Unit& unit = state.units[slot];
+            if (!unit.alive || unit.x != x || unit.y != y || unit.prevOnTile != prev)
+            {
+               error = "unit slot " + std::to_string(slot) + " is misfiled on tile " + std::to_string(x) + "," + std::to_string(y);
+               return false;
+            }
+            prev = slot;
+            if (++listed > state.liveUnitCount) break;
+         }
+      }
+   }
+   if (listed != state.liveUnitCount)
+   {
+      error = std::to_string(listed) + " units on tiles, " + std::to_string(state.liveUnitCount) + " live";
+      return false;
+   }
+   return true;
+}
+
+static bool checkHash(const GameState& state, const char* after, std::string& error)
+{
+   if (state.worldHash == computeWorldHash(state)) return true;
+   error = std::string("world hash drifted after ") + after;
+   return false;
+}
+
+static bool verifyUnitHandles(GameState& state, std::string& error)
+{
+   if (!checkOccupancy(state, error)) return false;
+
+   const int x = state.width / 2;
+   const int y = state.height / 2;
+   const UnitHandle first = createUnit(state, UnitType::SPEARMAN, 0, x, y);
+   if (first.index < 0)
+   {
+      error = "the unit pool is full";
+      return false;
+   }
+   destroyUnit(state, first);
+   if (isValidUnit(state, first) || getUnit(state, first))
+   {
+      error = "a destroyed unit's handle is still valid";
+      return false;
+   }
+
+   // The freed slot is the next one handed out, under a new generation
+   const UnitHandle second = createUnit(state, UnitType::SPEARMAN, 0, x, y);
+   if (second.index != first.index || second.generation == first.generation)
+   {
+      error = "a freed unit slot was not reused under a new generation";
+      return false;
+   }
+   if (isValidUnit(state, first) || !isValidUnit(state, second) || unitHandle(state, second.index) != second)
+   {
+      error = "handles to a reused unit slot resolve wrongly";
+      return false;
+   }
+
+   moveUnit(state, second, x + 1 < state.width ? x + 1 : x - 1, y);
+   if (!checkOccupancy(state, error) || !checkHash(state, "unit moves", error)) return false;
+   destroyUnit(state, second);
+   destroyUnit(state, second); // A second destroy through a stale handle changes nothing
+   return checkOccupancy(state, error) && checkHash(state, "unit churn", error);
+}
+
+// Every live village sits once in its clan's list, and the lists account for all of them
+static bool checkClanLists(const GameState& state, std::string& error)
+{
+   int listed = 0;
+   for (int clanIdx = 0; clanIdx < (int)state.clans.size(); ++clanIdx)
+   {
+      int prev = -1;
+      for (int idx = state.clans[clanIdx].firstVillage; idx >= 0; idx = state.villages[idx].nextInClan)
+      {
+         const Village& village = state.villages[idx];
+         if (!village.alive || village.clanIdx != clanIdx || village.prevInClan != prev)
+         {
+            error = "village slot " + std::to_string(idx) + " is misfiled in clan " + std::to_string(clanIdx);
+            return false;
+         }
+         prev = idx;
+         if (++listed > state.liveVillageCount) break;
+      }
+   }
+   if (listed != state.liveVillageCount)
+   {
+      error = std::to_string(listed) + " villages in clan lists, " + std::to_string(state.liveVillageCount) + " live";
+      return false;
+   }
+   return true;
+}
+
+static bool verifyVillageHandles(GameState& state, std::string& error)
+{
+   if (!checkClanLists(state, error)) return false;
+
+   const VillageHandle first = villageHandle(state, state.clans[0].firstVillage);
+   if (!isValidVillage(state, first))
+   {
+      error = "clan 0 has no village to raze";
+      return false;
+   }
+   const int x = state.villages[first.index].x;
+   const int y = state.villages[first.index].y;
+   destroyVillage(state, first);
+   if (isValidVillage(state, first) || getVillage(state, first))
+   {
+      error = "a razed village's handle is still valid";
+      return false;
+   }
+
+   // The freed slot is the next one handed out, under a new generation
+   const VillageHandle second = foundVillage(state, x, y, 1);
+   if (second.index != first.index || second.generation == first.generation || isValidVillage(state, first))
+   {
+      error = "refounding did not reuse the razed slot under a new generation";
+      return false;
+   }
+   if (!checkClanLists(state, error) || !checkHash(state, "village churn", error)) return false;
+
+   // A capture moves the village between lists but keeps its handle
+   captureVillage(state, second, 0);
+   const Village* captured = getVillage(state, second);
+   if (!captured || captured->clanIdx != 0)
+   {
+      error = "a captured village's handle went stale";
+      return false;
+   }
+   return checkClanLists(state, error) && checkHash(state, "village capture", error);
+}
+
+bool verifyHandles(const GameState& world, std::string& error)
+{
+   GameState state;
+   state.copyFrom(world);
+   return verifyUnitHandles(state, error) && verifyVillageHandles(state, error);
+}
+
+bool territoryMatchesRebuild(const GameState& state, std::string& error)
+{
+   GameState rebuilt;
+   rebuilt.copyFrom(state, false);
+   rebuildTerritory(rebuilt);
+   for (size_t idx = 0; idx < state.territoryOwner.size(); ++idx)
+   {
+      if (state.territoryOwner[idx] != rebuilt.territoryOwner[idx] ||
+         state.territoryDistance[idx] != rebuilt.territoryDistance[idx])
+      {
+         error = "tile " + std::to_string(idx) + " belongs to village " + std::to_string(state.territoryOwner[idx]) +
+            ", a rebuild gives it to " + std::to_string(rebuilt.territoryOwner[idx]);
+         return false;
+      }
+   }
+   return true;
+}
+
+bool verifyTerritory(const GameState& world, std::string& error)
+{
+   GameState state;
+   state.copyFrom(world);
+   if (!territoryMatchesRebuild(state, error)) return false;
+
+   // Alternately raze a village and found one, at places picked from the seed
+   uint32_t rng = state.seed * 2654435761u + 1;
+   const int ROUNDS = 64;
+   for (int round = 0; round < ROUNDS; ++round)
+   {
+      rng = rng * 1664525u + 1013904223u;
+      if (round % 2 == 0 && state.liveVillageCount > 1)
+      {
+         int idx = static_cast<int>(rng % state.villages.size());
+         while (!state.villages[idx].alive) idx = (idx + 1) % (int)state.villages.size();
+         destroyVillage(state, villageHandle(state, idx));
+      }
+      else
+      {
+         const int start = static_cast<int>(rng % (state.width * state.height));
+         for (int step = 0; step < state.width * state.height; ++step)
+         {
+            const int tile = (start + step) % (state.width * state.height);
+            if (canFoundVillage(state, tile % state.width, tile / state.width))
+            {
+               foundVillage(state, tile % state.width, tile / state.width, static_cast<int>(rng % state.clans.size()));
+               break;
+            }
+         }
+      }
+      if (!territoryMatchesRebuild(state, error))
+      {
+         error = "after " + std::to_string(round + 1) + " changes, " + error;
+         return false;
+      }
+   }
+   return checkHash(state, "founding and razing villages", error);
+}
+
+// Two side-by-side tiles, (x, y) and (x + 1, y), with no units on them; y = height if none
+static void findEmptyPair(const GameState& state, int& x, int& y)
+{
+   for (y = 0; y < state.height; ++y)
+      for (x = 0; x + 1 < state.width; ++x)
+         if (firstUnitOnTile(state, x, y) < 0 && firstUnitOnTile(state, x + 1, y) < 0) return;
+}
+
+// A battle of random stacks, the same for the same seed
+static void setUpBattle(Battle& battle, uint32_t seed)
+{
+   uint32_t rng = seed * 2654435761u + 1;
+   auto next = [&rng]() { rng = rng * 1664525u + 1013904223u; return rng >> 8; };
+   static const Terrain TERRAINS[] = { Terrain::GRASSLAND, Terrain::FOREST, Terrain::SWAMP, Terrain::HILLS, Terrain::MOUNTAIN };
+   battle.reset(TERRAINS[next() % 5], seed);
+   for (int side = COMBAT_ATTACKER; side <= COMBAT_DEFENDER; ++side)
+   {
+      const int count = 1 + static_cast<int>(next() % MAX_COMBATANTS_PER_SIDE);
+      for (int k = 0; k < count; ++k)
+      {
+         const UnitType type = static_cast<UnitType>(next() % UNIT_TYPE_COUNT);
+         const UnitTypeInfo& info = unitTypeInfo(type);
+         battle.add(side, type, info.attackStrength, info.defenseStrength, info.movementPoints, info.abilities, k);
+      }
+   }
+}
+
+static bool checkBattleGrid(const Battle& battle, std::string& error)
+{
+   bool taken[COMBAT_GRID_WIDTH * COMBAT_GRID_HEIGHT] = {};
+   int alive[2] = {};
+   for (int i = 0; i < battle.count(); ++i)
+   {
+      if (!battle.alive(i)) continue;
+      ++alive[battle.side(i)];
+      const int x = battle.x(i);
+      const int y = battle.y(i);
+      if (x < 0 || x >= COMBAT_GRID_WIDTH || y < 0 || y >= COMBAT_GRID_HEIGHT || taken[y * COMBAT_GRID_WIDTH + x])
+      {
+         error = "combatant " + std::to_string(i) + " is off the grid or shares a cell";
+         return false;
+      }
+      taken[y * COMBAT_GRID_WIDTH + x] = true;
+   }
+   const BattleResult result = battle.result();
+   if (result.survivors[COMBAT_ATTACKER] != alive[COMBAT_ATTACKER] || result.survivors[COMBAT_DEFENDER] != alive[COMBAT_DEFENDER])
+   {
+      error = "battle survivor counts do not match the living combatants";
+      return false;
+   }
+   return true;
+}
+
+bool verifyBattles(const GameState& world, std::string& error)
+{
+   const uint32_t BATTLES = 256;
+   for (uint32_t b = 0; b < BATTLES; ++b)
+   {
+      const uint32_t seed = world.seed + b;
+      Battle ran;
+      setUpBattle(ran, seed);
+      const BattleResult result = ran.run();
+
+      Battle stepped;
+      setUpBattle(stepped, seed);
+      while (stepped.step())
+      {
+         if (!checkBattleGrid(stepped, error)) return false;
+      }
+      if (!checkBattleGrid(stepped, error)) return false;
+
+      bool same = stepped.result().winner == result.winner && stepped.result().rounds == result.rounds &&
+         result.rounds <= COMBAT_MAX_ROUNDS;
+      for (int i = 0; same && i < ran.count(); ++i)
+         same = ran.hp(i) == stepped.hp(i) && ran.x(i) == stepped.x(i) && ran.y(i) == stepped.y(i);
+      if (!same)
+      {
+         error = "battle " + std::to_string(b) + " played out differently when stepped";
+         return false;
+      }
+      if ((result.winner == COMBAT_ATTACKER && result.survivors[COMBAT_DEFENDER] != 0) ||
+         (result.winner == COMBAT_DEFENDER && result.survivors[COMBAT_ATTACKER] != 0))
+      {
+         error = "battle " + std::to_string(b) + " has a winner with enemies still standing";
+         return false;
+      }
+   }
+
+   // A real attack between two fresh stacks on a copy of the world
+   GameState state;
+   state.copyFrom(world);
+   int x = 0;
+   int y = 0;
+   findEmptyPair(state, x, y);
+   const int STACK = 6;
+   for (int k = 0; k < STACK; ++k)
+   {
+      const UnitType type = static_cast<UnitType>(1 + k % (UNIT_TYPE_COUNT - 1));
+      if (y >= state.height || createUnit(state, type, 0, x, y).index < 0 || createUnit(state, type, 1, x + 1, y).index < 0)
+      {
+         error = "no room for a test battle";
+         return false;
+      }
+   }
+   const BattleResult result = resolveBattle(state, 0, x, y, x + 1, y);
+   if (result.survivors[COMBAT_ATTACKER] != countUnitsOnTile(state, x, y) ||
+      result.survivors[COMBAT_DEFENDER] != countUnitsOnTile(state, x + 1, y))
+   {
+      error = "resolveBattle left a different number of units than survived";
+      return false;
+   }
+   return checkOccupancy(state, error) && checkHash(state, "resolveBattle", error);
+}
+
+static bool sameOdds(const BattleOdds& a, const BattleOdds& b)
+{
+   return a.attackerWins == b.attackerWins && a.defenderWins == b.defenderWins &&
+      a.attackerLosses == b.attackerLosses && a.defenderLosses == b.defenderLosses;
+}
+
+bool verifyOdds(const GameState& world, std::string& error)
+{
+   // The same stacks created in a different order make the same key
+   GameState state;
+   state.copyFrom(world);
+   int x = 0;
+   int y = 0;
+   findEmptyPair(state, x, y);
+   const UnitType ORDER[] = { UnitType::SPEARMAN, UnitType::ARCHER, UnitType::SPEARMAN, UnitType::SWORDSMAN, UnitType::SHAMAN };
+   const int KINDS = sizeof(ORDER) / sizeof(ORDER[0]);
+   for (int k = 0; k < KINDS; ++k)
+   {
+      if (y >= state.height || createUnit(state, ORDER[k], 0, x, y).index < 0 ||
+         createUnit(state, ORDER[KINDS - 1 - k], 1, x + 1, y).index < 0)
+      {
+         error = "no room for test stacks";
+         return false;
+      }
+   }
+   StackKey key;
+   StackKey mirrored;
+   GameState reordered;
+   reordered.copyFrom(state);
+   for (int k = 0; k < KINDS; ++k)
+   {
+      destroyUnit(reordered, unitHandle(reordered, firstUnitOnTile(reordered, x, y)));
+      destroyUnit(reordered, unitHandle(reordered, firstUnitOnTile(reordered, x + 1, y)));
+   }
+   for (int k = 0; k < KINDS; ++k)
+   {
+      createUnit(reordered, ORDER[KINDS - 1 - k], 0, x, y);
+      createUnit(reordered, ORDER[k], 1, x + 1, y);
+   }
+   if (!makeStackKey(state, 0, x, y, x + 1, y, key) || !makeStackKey(reordered, 0, x, y, x + 1, y, mirrored) ||
+      std::memcmp(&key, &mirrored, sizeof(StackKey)) != 0)
+   {
+      error = "the same stacks in another order make a different odds key";
+      return false;
+   }
+
+   // A hit returns what a fresh simulation gives
+   BattleOddsCache cache;
+   const BattleOdds first = cache.get(state, 0, x, y, x + 1, y);
+   const BattleOdds again = cache.get(reordered, 0, x, y, x + 1, y);
+   if (cache.hits() != 1 || cache.misses() != 1 || !sameOdds(first, again))
+   {
+      error = "a repeated odds lookup was not a hit on the same entry";
+      return false;
+   }
+   if (first.attackerWins < 0.0f || first.defenderWins < 0.0f || first.attackerWins + first.defenderWins > 1.0f)
+   {
+      error = "odds out of range";
+      return false;
+   }
+
+   // Overfill the table with small battles, then make sure evicted entries come back the same
+   std::vector<StackKey> keys;
+   std::vector<BattleOdds> odds;
+   for (int terrain = 0; terrain < 3 && (int)keys.size() <= ODDS_CACHE_SIZE; ++terrain)
+      for (int a = 0; a < UNIT_TYPE_COUNT * 4; ++a)
+         for (int d = 0; d < UNIT_TYPE_COUNT * 4; ++d)
+         {
+            StackKey small;
+            std::memset(&small, 0, sizeof(small));
+            small.terrain = static_cast<uint8_t>(terrain == 0 ? Terrain::GRASSLAND : terrain == 1 ? Terrain::FOREST : Terrain::HILLS);
+            const int picks[2] = { a, d };
+            for (int side = 0; side < 2; ++side)
+            {
+               const UnitType type = static_cast<UnitType>(picks[side] % UNIT_TYPE_COUNT);
+               const UnitTypeInfo& info = unitTypeInfo(type);
+               CombatantKind& kind = small.kinds[side][0];
+               kind.type = static_cast<uint8_t>(type);
+               kind.attack = static_cast<uint8_t>(info.attackStrength);
+               kind.defense = static_cast<uint8_t>(info.defenseStrength);
+               kind.movement = static_cast<uint8_t>(info.movementPoints);
+               kind.abilities = info.abilities;
+               kind.count = static_cast<uint8_t>(1 + picks[side] / UNIT_TYPE_COUNT);
+               small.kindCount[side] = 1;
+            }
+            keys.push_back(small);
+            odds.push_back(cache.get(small));
+         }
+   BattleOddsCache fresh;
+   for (size_t k = 0; k < keys.size(); k += 37)
+   {
+      if (!sameOdds(cache.get(keys[k]), odds[k]) || !sameOdds(fresh.get(keys[k]), odds[k]))
+      {
+         error = "odds for a key changed after eviction or in another cache";
+         return false;
+      }
+   }
+   return true;
+}
+
+// Every tech a prerequisite chain reaches from tech, found by walking the graph
+static TechSet walkPrerequisites(const TechTree& tree, int tech)
+{
+   TechSet reached;
+   std::vector<int> open(1, tech);
+   while (!open.empty())
+   {
+      const int t = open.back();
+      open.pop_back();
+      for (int p = 0; p < tree.count(); ++p)
+      {
+         if (!tree.tech(t).prerequisites.test(p) || reached.test(p)) continue;
+         reached.set(p);
+         open.push_back(p);
+      }
+   }
+   return reached;
+}
+
+static bool sameTechs(const TechSet& a, const TechSet& b)
+{
+   return a.containsAll(b) && b.containsAll(a);
+}
+
+// Documents loadFromJson must turn down, each with the reason
+static const char* const BAD_TECH_TREES[][2] =
+{
+   { R"({ "techs": [ { "id": "a", "requires": [ "b" ] }, { "id": "b", "requires": [ "a" ] } ] })", "a two-tech cycle" },
+   { R"({ "techs": [ { "id": "a", "requires": [ "c" ] }, { "id": "b", "requires": [ "a" ] }, { "id": "c", "requires": [ "b" ] } ] })", "a three-tech cycle" },
+   { R"({ "techs": [ { "id": "a", "requires": [ "a" ] } ] })", "a tech requiring itself" },
+   { R"({ "techs": [ { "id": "a", "requires": [ "nowhere" ] } ] })", "an unknown prerequisite" },
+   { R"({ "techs": [ { "id": "a" }, { "id": "a" } ] })", "a duplicate id" },
+};
+
+bool verifyTechs(const TechTree& tree, std::string& error)
+{
+   if (tree.count() == 0)
+   {
+      error = "no tech tree loaded";
+      return false;
+   }
+
+   // Closures match a walk of the graph, and the order puts each tech after them
+   const std::vector<int>& order = tree.topologicalOrder();
+   std::vector<int> position(tree.count(), -1);
+   for (int i = 0; i < (int)order.size(); ++i)
+      if (order[i] >= 0 && order[i] < tree.count()) position[order[i]] = i;
+   for (int t = 0; t < tree.count(); ++t)
+   {
+      const TechInfo& tech = tree.tech(t);
+      if (!sameTechs(tech.closure, walkPrerequisites(tree, t)) || tech.closure.test(t))
+      {
+         error = "the closure of \"" + tech.id + "\" is not its transitive prerequisites";
+         return false;
+      }
+      if (position[t] < 0 || (int)order.size() != tree.count())
+      {
+         error = "\"" + tech.id + "\" is missing from the topological order";
+         return false;
+      }
+      for (int p = 0; p < tree.count(); ++p)
+      {
+         if (tech.closure.test(p) && position[p] > position[t])
+         {
+            error = "\"" + tech.id + "\" comes before its prerequisite \"" + tree.tech(p).id + "\"";
+            return false;
+         }
+      }
+   }
+
+   // Researching in topological order keeps every set closed under prerequisites
+   TechSet researched;
+   for (int t : order)
+   {
+      if (!tree.canResearch(researched, t))
+      {
+         error = "\"" + tree.tech(t).id + "\" cannot be researched after everything before it";
+         return false;
+      }
+      researched.set(t);
+   }
+
+   for (const auto& bad : BAD_TECH_TREES)
+   {
+      TechTree scratch;
+      std::string loadError;
+      if (scratch.loadFromJson(bad[0], loadError) || scratch.count() != 0 || loadError.empty())
+      {
+         error = std::string("the tech loader accepted ") + bad[1];
+         return false;
+      }
+   }
+   return true;
+}
+
+bool productionMatchesRecompile(const GameState& state, const TechTree& tree, std::string& error)
+{
+   for (int clanIdx = 0; clanIdx < (int)state.clans.size(); ++clanIdx)
+   {
+      const Clan& clan = state.clans[clanIdx];
+      Clan fresh = clan;
+      compileProduction(fresh, tree);
+
+      // The same stack folded the other way round: base and traits alone, then the techs last first
+      Clan reversed = clan;
+      reversed.researched = TechSet();
+      compileProduction(reversed, tree);
+      for (int t = tree.count() - 1; t >= 0; --t)
+      {
+         const std::vector<ProductionModifier>& effects = tree.tech(t).effects;
+         if (clan.researched.test(t) && !effects.empty())
+            applyModifiers(reversed.production, effects.data(), (int)effects.size());
+      }
+
+      if (std::memcmp(&clan.production, &fresh.production, sizeof(ProductionTable)) != 0 ||
+         std::memcmp(&clan.production, &reversed.production, sizeof(ProductionTable)) != 0)
+      {
+         error = "clan " + std::to_string(clanIdx) + "'s production table is stale";
+         return false;
+      }
+      for (int idx = clan.firstVillage; idx >= 0; idx = state.villages[idx].nextInClan)
+      {
+         const VillageProduction a = calculateVillageProduction(state.villages[idx], clan);
+         const VillageProduction b = calculateVillageProduction(state.villages[idx], reversed);
+         if (a.food != b.food || a.production != b.production || a.gold != b.gold || a.knowledge != b.knowledge ||
+            a.worship != b.worship)
+         {
+            error = "village slot " + std::to_string(idx) + " yields differ from a fresh compile";
+            return false;
+         }
+      }
+   }
+   return true;
+}
+
+bool queuesConsistent(const GameState& state, std::string& error)
+{
+   const int poolSize = (int)state.queueItems.size();
+   std::vector<char> seen(poolSize, 0);
+
+   int free = 0;
+   for (int idx = state.firstFreeQueueItem; idx >= 0; idx = state.queueItems[idx].next)
+   {
+      if (idx >= poolSize || seen[idx] || state.queueItems[idx].alive)
+      {
+         error = "queue item " + std::to_string(idx) + " is misfiled in the free list";
+         return false;
+      }
+      seen[idx] = 1;
+      ++free;
+   }
+
+   int queued = 0;
+   for (int villageIdx = 0; villageIdx < (int)state.villages.size(); ++villageIdx)
+   {
+      const Village& village = state.villages[villageIdx];
+      int length = 0;
+      int last = -1;
+      for (int idx = village.queueHead; idx >= 0; idx = state.queueItems[idx].next)
+      {
+         if (idx >= poolSize || seen[idx] || !state.queueItems[idx].alive ||
+            state.queueItems[idx].villageIdx != villageIdx || ++length > MAX_BUILD_QUEUE)
+         {
+            error = "queue item " + std::to_string(idx) + " is misfiled in village slot " + std::to_string(villageIdx);
+            return false;
+         }
+         seen[idx] = 1;
+         last = idx;
+      }
+      if (length != village.queueLength || last != village.queueTail || (!village.alive && length > 0))
+      {
+         error = "village slot " + std::to_string(villageIdx) + " holds " + std::to_string(length) +
+            " queue items ending at " + std::to_string(last) + ", its counters say " +
+            std::to_string(village.queueLength) + " ending at " + std::to_string(village.queueTail);
+         return false;
+      }
+      queued += length;
+   }
+
+   if (free + queued != poolSize)
+   {
+      error = std::to_string(free) + " free and " + std::to_string(queued) + " queued items in a pool of " +
+         std::to_string(poolSize);
+      return false;
+   }
+   return true;
+}
+
+bool verifyQueues(const GameState& world, std::string& error)
+{
+   GameState state;
+   state.copyFrom(world);
+   if (!queuesConsistent(state, error)) return false;
+
+   // Fill every queue past the limit, then empty every other one through the free list
+   for (int idx = 0; idx < (int)state.villages.size(); ++idx)
+   {
+      if (!state.villages[idx].alive) continue;
+      for (int k = 0; k <= MAX_BUILD_QUEUE; ++k)
+      {
+         const bool unit = k % 2 == 1;
+         const bool added = enqueueBuild(state, idx, unit ? QueueItemKind::UNIT : QueueItemKind::BUILDING,
+            k % (unit ? UNIT_TYPE_COUNT : BUILDING_TYPE_COUNT));
+         if (added != (k < MAX_BUILD_QUEUE))
+         {
+            error = "village slot " + std::to_string(idx) + " took entry " + std::to_string(k + 1) + " of " +
+               std::to_string(MAX_BUILD_QUEUE);
+            return false;
+         }
+      }
+   }
+   if (!queuesConsistent(state, error) || !checkHash(state, "filling the queues", error)) return false;
+   const size_t poolSize = state.queueItems.size();
+   for (int idx = 0; idx < (int)state.villages.size(); idx += 2)
+      if (state.villages[idx].alive) clearBuildQueue(state, idx);
+   if (!queuesConsistent(state, error) || !checkHash(state, "clearing queues", error)) return false;
+
+   // Freed entries are reused before the pool grows, and a razed village gives its own back
+   for (int idx = 0; idx < (int)state.villages.size(); idx += 2)
+      if (state.villages[idx].alive) enqueueBuild(state, idx, QueueItemKind::UNIT, 0);
+   if (state.queueItems.size() != poolSize)
+   {
+      error = "the queue pool grew while it had free entries";
+      return false;
+   }
+   destroyVillage(state, villageHandle(state, state.clans[0].firstVillage));
+   if (!queuesConsistent(state, error) || !checkHash(state, "razing a queued village", error)) return false;
+
+   // A turn completes what it can from the front of the full queues
+   processBuildQueues(state);
+   return queuesConsistent(state, error) && checkHash(state, "processing the queues", error);
+}
+
+static std::string readFileBytes(const std::string& path)
+{
+   std::ifstream file(path, std::ios::binary);
+   return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+bool verifySaveRoundTrip(const GameState& state, const std::string& path, std::string& error)
+{
+   GameState loaded;
+   std::string loadError;
+   if (!loadGame(loaded, path, loadError))
+   {
+      error = "the save does not load: " + loadError;
+      return false;
+   }
+   if (loaded.worldHash != state.worldHash || loaded.currentTurn != state.currentTurn)
+   {
+      error = "the save loads to a different world";
+      return false;
+   }
+   if (!checkHash(loaded, "loading", error) || !checkOccupancy(loaded, error) || !checkClanLists(loaded, error) ||
+      !queuesConsistent(loaded, error) || !territoryMatchesRebuild(loaded, error) ||
+      !productionMatchesRecompile(loaded, sharedTechTree(), error))
+      return false;
+
+   // Saving what was loaded writes the same bytes
+   const std::string again = path + ".again";
+   if (!saveGame(loaded, again, loadError))
+   {
+      error = "the loaded game does not save: " + loadError;
+      return false;
+   }
+   const std::string bytes = readFileBytes(path);
+   const bool same = bytes == readFileBytes(again);
+   if (!same)
+   {
+      std::remove(again.c_str());
+      error = "saving the loaded game writes different bytes";
+      return false;
+   }
+
+   // Cut short anywhere, the file is turned down and the game loaded into stays as it was
+   const size_t cuts[] = { 2, sizeof(SaveHeader) - 1, sizeof(SaveHeader) + 1, bytes.size() / 2, bytes.size() - 1 };
+   for (size_t cut : cuts)
+   {
+      std::ofstream(again, std::ios::binary | std::ios::trunc).write(bytes.data(), static_cast<std::streamsize>(cut));
+      if (loadGame(loaded, again, loadError) || loaded.worldHash != state.worldHash)
+      {
+         std::remove(again.c_str());
+         error = "a save cut to " + std::to_string(cut) + " bytes was not turned down cleanly";
+         return false;
+      }
+   }
+   std::remove(again.c_str());
+   return true;
+}
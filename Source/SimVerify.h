@@ -0,0 +1,53 @@
+#ifndef SIMVERIFY_H
+#define SIMVERIFY_H
+
+#include "GameState.h"
+#include <string>
+
+class TechTree;
+
+// Self-checks behind ClanDestinySim's --verify-* modes, which ctest runs (see the end
+// of CMakeLists.txt).  Each one works on its own copy of the world it is given and
+// returns false with a description of the first thing it finds wrong.
+
+// Unit and village slots are reused with a new generation, so handles to dead ones stay
+// invalid, and the tile occupancy and clan village lists match the pools
+bool verifyHandles(const GameState& world, std::string& error);
+
+// The territory layer, as repaired incrementally, matches a full rebuild
+bool territoryMatchesRebuild(const GameState& state, std::string& error);
+
+// The same, after founding and razing villages all over a copy of the world
+bool verifyTerritory(const GameState& world, std::string& error);
+
+// Battles replay identically from the same seed, whether run or stepped, keep one
+// combatant per cell, and resolveBattle leaves the pool, occupancy and hash in step
+bool verifyBattles(const GameState& world, std::string& error);
+
+// Memoized battle odds: stacks in any order share a key, a hit returns the entry, and
+// odds evicted from a full table or taken from another cache come back the same
+bool verifyOdds(const GameState& world, std::string& error);
+
+// Each tech's closure is exactly what a walk of its prerequisites reaches, the
+// topological order respects it, and the loader turns down cycles, unknown
+// prerequisites and duplicate ids
+bool verifyTechs(const TechTree& tree, std::string& error);
+
+// Every clan's compiled production table equals one compiled from scratch, and one
+// folded with its techs in the opposite order, and so do its villages' yields
+bool productionMatchesRecompile(const GameState& state, const TechTree& tree, std::string& error);
+
+// The build queue pool splits exactly into the free list and the villages' queues,
+// whose heads, tails and lengths match their links
+bool queuesConsistent(const GameState& state, std::string& error);
+
+// queuesConsistent through filling every queue past its limit, clearing, reusing
+// freed entries, razing a queued village and a turn of completions
+bool verifyQueues(const GameState& world, std::string& error);
+
+// The save at path, written from state, loads back to the same hash with consistent
+// lists, territory and production, saving the loaded game again writes the same bytes,
+// and a truncated copy is refused without touching the game it was loaded into
+bool verifySaveRoundTrip(const GameState& state, const std::string& path, std::string& error);
+
+#endif
@@ -0,0 +1,121 @@
+#include "StateHash.h"
+
+namespace
+{
+   // splitmix64 finalizer
+   inline uint64_t mix64(uint64_t x)
+   {
+      x ^= x >> 30;
+      x *= 0xbf58476d1ce4e5b9ULL;
+      x ^= x >> 27;
+      x *= 0x94d049bb133111ebULL;
+      x ^= x >> 31;
+      return x;
+   }
+
+   struct KeyBuilder
+   {
+      uint64_t h;
+      KeyBuilder(uint64_t kind, int idx) : h(mix64(kind ^ (static_cast<uint64_t>(idx) << 8))) {}
+      void add(int64_t v) { h = mix64(h ^ static_cast<uint64_t>(v)); }
+   };
+
+   // Distinct per entity kind so a tile and a village with the same index never cancel out
+   const uint64_t TILE_KIND    = 0x54494c45ULL;
+   const uint64_t VILLAGE_KIND = 0x56494c4cULL;
+   const uint64_t CLAN_KIND    = 0x434c414eULL;
+   const uint64_t UNIT_KIND    = 0x554e4954ULL;
+   const uint64_t QUEUE_KIND   = 0x51554555ULL;
+}
+
+uint64_t hashTile(int idx, const SquareTile& tile)
+{
+   KeyBuilder key(TILE_KIND, idx);
+   key.add(static_cast<int>(tile.terrain));
+   key.add(tile.hasVillage);
+   key.add(tile.villageIdx);
+   return key.h;
+}
+
+uint64_t hashVillage(int idx, const Village& village)
+{
+   KeyBuilder key(VILLAGE_KIND, idx);
+   key.add(village.x);
+   key.add(village.y);
+   key.add(village.clanIdx);
+   key.add(village.population);
+   key.add(village.foodStorehouse);
+   key.add(village.productionStorehouse);
+   key.add(village.foodProduction);
+   key.add(village.productionOutput);
+   key.add(village.goldOutput);
+   key.add(village.knowledgeOutput);
+   key.add(village.worshipOutput);
+   for (int i = 0; i < village.buildingCount; ++i)
+   {
+      const Building& b = village.buildings[i];
+      key.add(static_cast<int>(b.type));
+      key.add(b.tileX);
+      key.add(b.tileY);
+      key.add(b.workerIdx);
+   }
+   key.add(village.workers);
+   key.add(village.queueHead);
+   key.add(village.queueLength);
+   return key.h;
+}
+
+uint64_t hashClan(int idx, const Clan& clan)
+{
+   KeyBuilder key(CLAN_KIND, idx);
+   key.add(clan.gold);
+   key.add(clan.knowledge);
+   key.add(clan.worship);
+   key.add(clan.traits);
+   for (int w = 0; w < TECH_WORDS; ++w)
+      key.add(static_cast<int64_t>(clan.researched.words[w]));
+   // Village membership is already covered by each village's clanIdx
+   return key.h;
+}
+
+uint64_t hashUnit(int slot, const Unit& unit)
+{
+   // Occupancy links and the slot generation are pool bookkeeping, not game state
+   KeyBuilder key(UNIT_KIND, slot);
+   key.add(static_cast<int>(unit.type));
+   key.add(unit.clanIdx);
+   key.add(unit.x);
+   key.add(unit.y);
+   key.add(unit.attackStrength);
+   key.add(unit.defenseStrength);
+   key.add(unit.movementPoints);
+   key.add(unit.abilities);
+   return key.h;
+}
+
+uint64_t hashQueueItem(int slot, const QueueItem& item)
+{
+   // The links are hashed here because they carry the queue order
+   KeyBuilder key(QUEUE_KIND, slot);
+   key.add(static_cast<int>(item.kind));
+   key.add(item.type);
+   key.add(item.villageIdx);
+   key.add(item.next);
+   return key.h;
+}
+
+uint64_t computeWorldHash(const GameState& state)
+{
+   uint64_t h = 0;
+   for (size_t i = 0; i < state.map.size(); ++i)
+      h ^= hashTile((int)i, state.map[i]);
+   for (size_t i = 0; i < state.villages.size(); ++i)
+      if (state.villages[i].alive) h ^= hashVillage((int)i, state.villages[i]);
+   for (size_t i = 0; i < state.clans.size(); ++i)
+      h ^= hashClan((int)i, state.clans[i]);
+   for (size_t i = 0; i < state.units.size(); ++i)
+      if (state.units[i].alive) h ^= hashUnit((int)i, state.units[i]);
+   for (size_t i = 0; i < state.queueItems.size(); ++i)
+      if (state.queueItems[i].alive) h ^= hashQueueItem((int)i, state.queueItems[i]);
+   return h;
+}
@@ -0,0 +1,28 @@
+#ifndef STATEHASH_H
+#define STATEHASH_H
+
+#include "GameState.h"
+#include <cstdint>
+
+// The world hash is the XOR of one 64-bit key per tile, village, clan, live unit and
+// build queue entry.  Because XOR is order-independent, a mutation updates it in O(1)
+// by XORing out the entity's key from before the change and XORing in the key from
+// after it:
+//
+//    uint64_t before = hashVillage(idx, village);
+//    ... mutate village ...
+//    worldHash ^= before ^ hashVillage(idx, village);
+//
+// It also means partial hashes built on different threads can simply be XORed together.
+// Only simulation state is hashed; names and render-only fields are left out.
+
+uint64_t hashTile(int idx, const SquareTile& tile);
+uint64_t hashVillage(int idx, const Village& village);
+uint64_t hashClan(int idx, const Clan& clan);
+uint64_t hashUnit(int slot, const Unit& unit);
+uint64_t hashQueueItem(int slot, const QueueItem& item);
+
+// Full recompute, for seeding the incremental hash and for checking it
+uint64_t computeWorldHash(const GameState& state);
+
+#endif
@@ -0,0 +1,251 @@
+#include "TechTree.h"
+#include "json.hpp"
+#include <fstream>
+#include <sstream>
+
+using json = nlohmann::json;
+
+static bool readCost(const json& entry, const char* key, int& cost)
+{
+   cost = 0;
+   if (!entry.contains(key)) return true;
+   const json& value = entry[key];
+   if (!value.is_number_integer() || value.get<int>() < 0) return false;
+   cost = value.get<int>();
+   return true;
+}
+
+static int lookupName(const json& value, const char* const* names, int count)
+{
+   if (!value.is_string()) return -1;
+   for (int i = 0; i < count; ++i)
+      if (value.get<std::string>() == names[i]) return i;
+   return -1;
+}
+
+// { "building": "farm", "resource": "food", "add": 1, "percent": 0 }; building optional
+static bool readEffect(const json& entry, ProductionModifier& effect)
+{
+   static const char* const BUILDINGS[BUILDING_TYPE_COUNT] = { "farm", "logging_camp", "mine", "worship_site", "library" };
+   static const char* const RESOURCES[RESOURCE_TYPE_COUNT] = { "food", "production", "gold", "knowledge", "worship" };
+
+   if (!entry.is_object() || !entry.contains("resource")) return false;
+   const int resource = lookupName(entry["resource"], RESOURCES, RESOURCE_TYPE_COUNT);
+   const int building = entry.contains("building") ? lookupName(entry["building"], BUILDINGS, BUILDING_TYPE_COUNT) : PRODUCTION_VILLAGE;
+   if (resource < 0 || (entry.contains("building") && building < 0)) return false;
+
+   int amounts[2] = {};
+   const char* keys[2] = { "add", "percent" };
+   for (int k = 0; k < 2; ++k)
+   {
+      if (!entry.contains(keys[k])) continue;
+      const json& value = entry[keys[k]];
+      if (!value.is_number_integer() || value.get<int>() < -1000 || value.get<int>() > 1000) return false;
+      amounts[k] = value.get<int>();
+   }
+
+   effect.building = static_cast<int8_t>(building);
+   effect.resource = static_cast<uint8_t>(resource);
+   effect.add = static_cast<int16_t>(amounts[0]);
+   effect.percent = static_cast<int16_t>(amounts[1]);
+   return true;
+}
+
+bool TechTree::loadFromJson(const std::string& text, std::string& error)
+{
+   clear();
+   const json root = json::parse(text, nullptr, false);
+   if (root.is_discarded() || !root.is_object() || !root.contains("techs") || !root["techs"].is_array())
+   {
+      error = "expected an object with a \"techs\" array";
+      return false;
+   }
+
+   const json& entries = root["techs"];
+   if (entries.size() > static_cast<size_t>(MAX_TECHS))
+   {
+      error = "more than " + std::to_string(MAX_TECHS) + " techs";
+      return false;
+   }
+
+   // Ids first, so prerequisites can refer to techs listed later
+   for (const json& entry : entries)
+   {
+      if (!entry.is_object() || !entry.contains("id") || !entry["id"].is_string())
+      {
+         error = "tech " + std::to_string(m_techs.size()) + " has no id";
+         clear();
+         return false;
+      }
+
+      TechInfo info;
+      info.id = entry["id"].get<std::string>();
+      info.name = entry.contains("name") && entry["name"].is_string() ? entry["name"].get<std::string>() : info.id;
+      if (find(info.id) >= 0)
+      {
+         error = "duplicate tech \"" + info.id + "\"";
+         clear();
+         return false;
+      }
+      if (!readCost(entry, "knowledge", info.knowledgeCost) || !readCost(entry, "worship", info.worshipCost))
+      {
+         error = "tech \"" + info.id + "\" has a bad cost";
+         clear();
+         return false;
+      }
+      if (entry.contains("effects"))
+      {
+         const json& effects = entry["effects"];
+         bool valid = effects.is_array();
+         for (size_t e = 0; valid && e < effects.size(); ++e)
+         {
+            ProductionModifier effect;
+            valid = readEffect(effects[e], effect);
+            info.effects.push_back(effect);
+         }
+         if (!valid)
+         {
+            error = "tech \"" + info.id + "\" has a bad effect";
+            clear();
+            return false;
+         }
+      }
+      m_techs.push_back(info);
+   }
+
+   for (size_t t = 0; t < entries.size(); ++t)
+   {
+      if (!entries[t].contains("requires")) continue;
+      const json& list = entries[t]["requires"];
+      if (!list.is_array())
+      {
+         error = "tech \"" + m_techs[t].id + "\" has a bad \"requires\" list";
+         clear();
+         return false;
+      }
+      for (const json& id : list)
+      {
+         const int prerequisite = id.is_string() ? find(id.get<std::string>()) : -1;
+         if (prerequisite < 0)
+         {
+            error = "tech \"" + m_techs[t].id + "\" requires an unknown tech";
+            clear();
+            return false;
+         }
+         m_techs[t].prerequisites.set(prerequisite);
+      }
+   }
+
+   // Kahn's algorithm, taking ready techs in file order so the order is stable
+   const int count = (int)m_techs.size();
+   TechSet placed;
+   while ((int)m_order.size() < count)
+   {
+      const size_t before = m_order.size();
+      for (int t = 0; t < count; ++t)
+      {
+         if (placed.test(t) || !placed.containsAll(m_techs[t].prerequisites)) continue;
+         m_order.push_back(t);
+         placed.set(t);
+      }
+      if (m_order.size() == before)
+      {
+         error = "the tech graph has a cycle";
+         clear();
+         return false;
+      }
+   }
+
+   // Prerequisites come first in the order, so their closures are already complete
+   for (int t : m_order)
+   {
+      TechInfo& info = m_techs[t];
+      info.closure = info.prerequisites;
+      for (int p = 0; p < count; ++p)
+         if (info.prerequisites.test(p)) info.closure |= m_techs[p].closure;
+   }
+   return true;
+}
+
+bool TechTree::loadFromFile(const std::string& path, std::string& error)
+{
+   std::ifstream file(path);
+   if (!file)
+   {
+      clear();
+      error = "cannot open " + path;
+      return false;
+   }
+   std::stringstream text;
+   text << file.rdbuf();
+   return loadFromJson(text.str(), error);
+}
+
+void TechTree::clear()
+{
+   m_techs.clear();
+   m_order.clear();
+}
+
+int TechTree::find(const std::string& id) const
+{
+   for (int t = 0; t < (int)m_techs.size(); ++t)
+      if (m_techs[t].id == id) return t;
+   return -1;
+}
+
+bool TechTree::canResearch(const TechSet& researched, int tech) const
+{
+   return tech >= 0 && tech < count() && !researched.test(tech) && researched.containsAll(m_techs[tech].closure);
+}
+
+TechSet TechTree::researchable(const TechSet& researched) const
+{
+   TechSet result;
+   for (int t = 0; t < count(); ++t)
+      if (!researched.test(t) && researched.containsAll(m_techs[t].closure)) result.set(t);
+   return result;
+}
+
+int TechTree::cheapestAffordable(const TechSet& researched, int knowledge, int worship) const
+{
+   const TechSet open = researchable(researched);
+   int best = -1;
+   int bestCost = 0;
+   for (int t = 0; open.any() && t < count(); ++t)
+   {
+      const TechInfo& tech = m_techs[t];
+      if (!open.test(t) || tech.knowledgeCost > knowledge || tech.worshipCost > worship) continue;
+      if (best < 0 || tech.knowledgeCost + tech.worshipCost < bestCost)
+      {
+         best = t;
+         bestCost = tech.knowledgeCost + tech.worshipCost;
+      }
+   }
+   return best;
+}
+
+TechSet TechTree::missingFor(const TechSet& researched, int tech) const
+{
+   TechSet needed = m_techs[tech].closure;
+   needed.set(tech);
+   return needed.without(researched);
+}
+
+void TechTree::cost(const TechSet& techs, int& knowledge, int& worship) const
+{
+   knowledge = 0;
+   worship = 0;
+   for (int t = 0; t < count(); ++t)
+   {
+      if (!techs.test(t)) continue;
+      knowledge += m_techs[t].knowledgeCost;
+      worship += m_techs[t].worshipCost;
+   }
+}
+
+TechTree& sharedTechTree()
+{
+   static TechTree tree;
+   return tree;
+}
@@ -0,0 +1,109 @@
+#ifndef TECHTREE_H
+#define TECHTREE_H
+
+#include "Production.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+const int MAX_TECHS = 128;
+const int TECH_WORDS = MAX_TECHS / 64;
+
+// One bit per tech.  Plain data, so it can live in Clan and be copied with GameState.
+struct TechSet
+{
+   uint64_t words[TECH_WORDS] = {};
+
+   bool test(int tech) const { return (words[tech >> 6] >> (tech & 63)) & 1; }
+   void set(int tech) { words[tech >> 6] |= uint64_t(1) << (tech & 63); }
+
+   bool containsAll(const TechSet& other) const
+   {
+      for (int w = 0; w < TECH_WORDS; ++w)
+         if (other.words[w] & ~words[w]) return false;
+      return true;
+   }
+
+   bool any() const
+   {
+      for (int w = 0; w < TECH_WORDS; ++w)
+         if (words[w]) return true;
+      return false;
+   }
+
+   // Bits set here but not in other
+   TechSet without(const TechSet& other) const
+   {
+      TechSet result;
+      for (int w = 0; w < TECH_WORDS; ++w)
+         result.words[w] = words[w] & ~other.words[w];
+      return result;
+   }
+
+   TechSet& operator|=(const TechSet& other)
+   {
+      for (int w = 0; w < TECH_WORDS; ++w)
+         words[w] |= other.words[w];
+      return *this;
+   }
+};
+
+struct TechInfo
+{
+   std::string id;
+   std::string name;
+   int knowledgeCost = 0;
+   int worshipCost = 0;
+   TechSet prerequisites;  // Direct ones
+   TechSet closure;        // Every tech that must come first, however indirectly
+   std::vector<ProductionModifier> effects; // Apply to the researching clan's villages
+};
+
+// The tech/upgrade graph, loaded from JSON:
+//
+//   { "techs": [ { "id": "writing", "name": "Writing", "knowledge": 20, "worship": 0,
+//                  "requires": [ "pottery" ],
+//                  "effects": [ { "building": "library", "resource": "knowledge", "add": 1 },
+//                               { "resource": "knowledge", "percent": 10 } ] }, ... ] }
+//
+// An effect without a "building" applies once per village.
+// Loading sorts the graph topologically and stores each tech's transitive
+// prerequisites as a bitset, so every query below is a handful of word operations
+// per tech with no graph walks.  A clan's progress is just its researched TechSet;
+// sets built through research() are always closed under prerequisites.
+class TechTree
+{
+public:
+   // Returns false, leaving the tree empty, on a parse error, an unknown or duplicate
+   // id, a cycle, or more than MAX_TECHS techs
+   bool loadFromJson(const std::string& text, std::string& error);
+   bool loadFromFile(const std::string& path, std::string& error);
+   void clear();
+
+   int count() const { return (int)m_techs.size(); }
+   const TechInfo& tech(int idx) const { return m_techs[idx]; }
+   int find(const std::string& id) const;   // -1 if unknown
+
+   // Every tech appears after all of its prerequisites
+   const std::vector<int>& topologicalOrder() const { return m_order; }
+
+   bool canResearch(const TechSet& researched, int tech) const;
+   TechSet researchable(const TechSet& researched) const;
+
+   // The researchable tech with the lowest total cost that fits the budget, or -1
+   int cheapestAffordable(const TechSet& researched, int knowledge, int worship) const;
+
+   // The tech plus whatever it still needs, and their total cost
+   TechSet missingFor(const TechSet& researched, int tech) const;
+   void cost(const TechSet& techs, int& knowledge, int& worship) const;
+
+private:
+   std::vector<TechInfo> m_techs;
+   std::vector<int> m_order;
+};
+
+// The tree the game plays with.  Loaded once at startup; empty (so nothing can be
+// researched) if the data file is missing.
+TechTree& sharedTechTree();
+
+#endif
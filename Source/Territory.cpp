@@ -0,0 +1,221 @@
+#include "Territory.h"
+#include "GameState.h"
+#include "Pathfinding.h"
+#include <algorithm>
+
+const uint16_t TERRITORY_FAR = 0xFFFF;
+
+// BFS queues, reused between calls on the same thread
+struct TerritoryScratch
+{
+   std::vector<int> queue;
+   std::vector<int> seeds;
+};
+
+static TerritoryScratch& territoryScratch(const GameState& state)
+{
+   thread_local TerritoryScratch scratch;
+   const size_t tiles = static_cast<size_t>(state.width) * state.height;
+   if (scratch.queue.capacity() < tiles * 2)
+   {
+      scratch.queue.reserve(tiles * 2);
+      scratch.seeds.reserve(tiles);
+   }
+   return scratch;
+}
+
+// (distance, owner) ordering: nearer wins, then the lower village index
+static bool claimBeats(int distance, int owner, int otherDistance, int otherOwner)
+{
+   if (distance != otherDistance) return distance < otherDistance;
+   return otherOwner == TERRITORY_NONE || owner < otherOwner;
+}
+
+// Relaxes the neighbours of every tile taken from the queue; the queue must be fed in
+// non-decreasing distance order.  Seeds, if any, are merged in by distance.
+static void spread(GameState& state, std::vector<int>& queue, const std::vector<int>& seeds)
+{
+   size_t head = 0;
+   size_t nextSeed = 0;
+   for (;;)
+   {
+      int current;
+      const bool haveQueued = head < queue.size();
+      const bool haveSeed = nextSeed < seeds.size();
+      if (!haveQueued && !haveSeed) break;
+      if (haveSeed && (!haveQueued || state.territoryDistance[seeds[nextSeed]] <= state.territoryDistance[queue[head]]))
+         current = seeds[nextSeed++];
+      else
+         current = queue[head++];
+
+      const int distance = state.territoryDistance[current] + 1;
+      const int owner = state.territoryOwner[current];
+      const int cx = current % state.width;
+      const int cy = current / state.width;
+      for (int n = 0; n < 8; ++n)
+      {
+         const int nx = cx + NEIGHBOR_DX[n];
+         const int ny = cy + NEIGHBOR_DY[n];
+         if (!state.inBounds(nx, ny)) continue;
+
+         const int next = state.tileIndex(nx, ny);
+         if (!claimBeats(distance, owner, state.territoryDistance[next], state.territoryOwner[next])) continue;
+
+         // A tile won on a tie may be queued twice; the second visit changes nothing
+         state.territoryDistance[next] = static_cast<uint16_t>(distance);
+         state.territoryOwner[next] = owner;
+         queue.push_back(next);
+      }
+   }
+   queue.clear();
+}
+
+void rebuildTerritory(GameState& state)
+{
+   const size_t tiles = static_cast<size_t>(state.width) * state.height;
+   state.territoryOwner.assign(tiles, TERRITORY_NONE);
+   state.territoryDistance.assign(tiles, TERRITORY_FAR);
+
+   TerritoryScratch& scratch = territoryScratch(state);
+   scratch.queue.clear();
+   scratch.seeds.clear();
+   for (int v = 0; v < (int)state.villages.size(); ++v)
+   {
+      if (!state.villages[v].alive) continue;
+      const int idx = state.tileIndex(state.villages[v].x, state.villages[v].y);
+      if (state.territoryOwner[idx] != TERRITORY_NONE) continue;
+      state.territoryOwner[idx] = v;
+      state.territoryDistance[idx] = 0;
+      scratch.queue.push_back(idx);
+   }
+   spread(state, scratch.queue, scratch.seeds);
+}
+
+void addTerritorySource(GameState& state, int villageIdx)
+{
+   const Village& village = state.villages[villageIdx];
+   const int idx = state.tileIndex(village.x, village.y);
+   if (!claimBeats(0, villageIdx, state.territoryDistance[idx], state.territoryOwner[idx])) return;
+
+   TerritoryScratch& scratch = territoryScratch(state);
+   scratch.queue.clear();
+   scratch.seeds.clear();
+   state.territoryOwner[idx] = villageIdx;
+   state.territoryDistance[idx] = 0;
+   scratch.queue.push_back(idx);
+   spread(state, scratch.queue, scratch.seeds);
+}
+
+void removeTerritorySource(GameState& state, int villageIdx)
+{
+   const Village& village = state.villages[villageIdx];
+   const int start = state.tileIndex(village.x, village.y);
+   if (state.territoryOwner[start] != villageIdx) return;
+
+   TerritoryScratch& scratch = territoryScratch(state);
+   std::vector<int>& region = scratch.queue;
+   std::vector<int>& seeds = scratch.seeds;
+   region.clear();
+   seeds.clear();
+
+   // A region is connected (every tile's BFS parent has the same owner), so flood it
+   // from the village, clearing it as we go
+   state.territoryOwner[start] = TERRITORY_NONE;
+   state.territoryDistance[start] = TERRITORY_FAR;
+   region.push_back(start);
+   for (size_t i = 0; i < region.size(); ++i)
+   {
+      const int cx = region[i] % state.width;
+      const int cy = region[i] / state.width;
+      for (int n = 0; n < 8; ++n)
+      {
+         const int nx = cx + NEIGHBOR_DX[n];
+         const int ny = cy + NEIGHBOR_DY[n];
+         if (!state.inBounds(nx, ny)) continue;
+
+         const int next = state.tileIndex(nx, ny);
+         if (state.territoryOwner[next] == villageIdx)
+         {
+            state.territoryOwner[next] = TERRITORY_NONE;
+            state.territoryDistance[next] = TERRITORY_FAR;
+            region.push_back(next);
+         }
+      }
+   }
+
+   // The neighbouring regions' edge tiles grow back into the hole
+   for (int tile : region)
+   {
+      const int cx = tile % state.width;
+      const int cy = tile / state.width;
+      for (int n = 0; n < 8; ++n)
+      {
+         const int nx = cx + NEIGHBOR_DX[n];
+         const int ny = cy + NEIGHBOR_DY[n];
+         if (!state.inBounds(nx, ny)) continue;
+
+         const int next = state.tileIndex(nx, ny);
+         if (state.territoryOwner[next] != TERRITORY_NONE)
+            seeds.push_back(next);
+      }
+   }
+   std::sort(seeds.begin(), seeds.end(), [&](int a, int b)
+   {
+      if (state.territoryDistance[a] != state.territoryDistance[b])
+         return state.territoryDistance[a] < state.territoryDistance[b];
+      return a < b;
+   });
+   seeds.erase(std::unique(seeds.begin(), seeds.end()), seeds.end());
+
+   region.clear();
+   spread(state, region, seeds);
+}
+
+int territoryReach(const GameState& state, int villageIdx, int maxReach)
+{
+   // A tile's step count is its ring around the village, and a region is connected,
+   // so the first ring with none of the region's tiles ends it
+   const Village& village = state.villages[villageIdx];
+   for (int r = 1; r <= maxReach; ++r)
+   {
+      bool any = false;
+      for (int dy = -r; dy <= r && !any; ++dy)
+      {
+         const int y = village.y + dy;
+         if (y < 0 || y >= state.height) continue;
+         const int step = (dy == -r || dy == r) ? 1 : 2 * r;
+         for (int dx = -r; dx <= r; dx += step)
+         {
+            const int x = village.x + dx;
+            if (x >= 0 && x < state.width && state.territoryOwner[state.tileIndex(x, y)] == villageIdx)
+            {
+               any = true;
+               break;
+            }
+         }
+      }
+      if (!any) return r - 1;
+   }
+   return maxReach;
+}
+
+int territoryClan(const GameState& state, int idx)
+{
+   const int owner = state.territoryOwner[idx];
+   return owner == TERRITORY_NONE ? TERRITORY_NONE : state.villages[owner].clanIdx;
+}
+
+bool isBorderTile(const GameState& state, int idx)
+{
+   const int clan = territoryClan(state, idx);
+   const int cx = idx % state.width;
+   const int cy = idx / state.width;
+   for (int n = 0; n < 8; ++n)
+   {
+      const int nx = cx + NEIGHBOR_DX[n];
+      const int ny = cy + NEIGHBOR_DY[n];
+      if (state.inBounds(nx, ny) && territoryClan(state, state.tileIndex(nx, ny)) != clan)
+         return true;
+   }
+   return false;
+}
@@ -0,0 +1,33 @@
+#ifndef TERRITORY_H
+#define TERRITORY_H
+
+struct GameState;
+
+const int TERRITORY_NONE = -1;
+
+// Every tile belongs to its nearest village (8-connected steps, lower village index on
+// ties), kept in GameState::territoryOwner with the step count in territoryDistance.
+// The owning clan is looked up through the village, so a capture changes nothing
+// here.  Founding or removing a village only repairs the region it wins or loses.
+
+// Full multi-source BFS from every village; used after map generation or loading
+void rebuildTerritory(GameState& state);
+
+// A village was founded: grows its region outwards from its tile
+void addTerritorySource(GameState& state, int villageIdx);
+
+// A village is going away: its region is refilled from the surrounding villages.
+// Call before the village's slot is reused.
+void removeTerritorySource(GameState& state, int villageIdx);
+
+// How many steps from its tile the village's region reaches, capped at maxReach.
+// Costs the area of the square it covers.
+int territoryReach(const GameState& state, int villageIdx, int maxReach);
+
+// Clan owning the tile, or TERRITORY_NONE
+int territoryClan(const GameState& state, int idx);
+
+// True if a neighbouring tile belongs to a different clan (or to none)
+bool isBorderTile(const GameState& state, int idx);
+
+#endif
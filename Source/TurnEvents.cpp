@@ -0,0 +1,46 @@
+#include "TurnEvents.h"
+
+void TurnEventLog::push(TurnEventType type, int clanIdx, int villageIdx, int value, uint8_t detail)
+{
+   TurnEvent& e = m_events[m_head & (TURN_EVENT_CAPACITY - 1)];
+   e.turn = m_turn;
+   e.clanIdx = clanIdx;
+   e.villageIdx = villageIdx;
+   e.value = value;
+   e.type = type;
+   e.detail = detail;
+   ++m_head;
+}
+
+bool TurnEventLog::read(TurnEventCursor& cursor, TurnEvent& out) const
+{
+   // Reader fell more than a full buffer behind; skip to the oldest event still held
+   if (cursor.next < oldest())
+   {
+      cursor.dropped += oldest() - cursor.next;
+      cursor.next = oldest();
+   }
+
+   if (cursor.next >= m_head) return false;
+
+   out = m_events[cursor.next & (TURN_EVENT_CAPACITY - 1)];
+   ++cursor.next;
+   return true;
+}
+
+const char* turnEventName(TurnEventType type)
+{
+   switch (type)
+   {
+   case TurnEventType::TURN_ENDED:         return "TurnEnded";
+   case TurnEventType::POPULATION_GREW:    return "PopulationGrew";
+   case TurnEventType::BUILDING_COMPLETED: return "BuildingCompleted";
+   case TurnEventType::RESOURCE_THRESHOLD: return "ResourceThreshold";
+   case TurnEventType::UNIT_TRAINED:       return "UnitTrained";
+   case TurnEventType::VILLAGE_FOUNDED:    return "VillageFounded";
+   case TurnEventType::VILLAGE_CAPTURED:   return "VillageCaptured";
+   case TurnEventType::VILLAGE_DESTROYED:  return "VillageDestroyed";
+   case TurnEventType::TERRITORY_CHANGED:  return "TerritoryChanged";
+   }
+   return "Unknown";
+}
@@ -0,0 +1,70 @@
+#ifndef TURNEVENTS_H
+#define TURNEVENTS_H
+
+#include "Game.h"
+#include <cstdint>
+
+// Things the turn engine did that a consumer may want to react to
+enum class TurnEventType : uint8_t
+{
+   TURN_ENDED,          // Pushed last by processEndOfTurn; turn = the turn that just finished
+   POPULATION_GREW,     // villageIdx grew, value = new population
+   BUILDING_COMPLETED,  // villageIdx finished a building, detail = BuildingType, value = new building count
+   RESOURCE_THRESHOLD,  // clanIdx stockpile crossed a RESOURCE_THRESHOLD_STEP multiple, detail = ResourceType, value = new amount
+   UNIT_TRAINED,        // villageIdx trained a unit, detail = UnitType, value = the unit's pool slot
+   VILLAGE_FOUNDED,     // clanIdx founded villageIdx, value = its tile
+   VILLAGE_CAPTURED,    // clanIdx took villageIdx, value = its tile
+   VILLAGE_DESTROYED,   // villageIdx (last held by clanIdx) was razed, value = its tile
+   TERRITORY_CHANGED    // villageIdx's region changed hands, all within detail steps of tile value (TERRITORY_REACH_MAX: maybe further)
+};
+
+const int TERRITORY_REACH_MAX = 255; // Largest TERRITORY_CHANGED detail
+
+struct TurnEvent
+{
+   int turn;
+   int clanIdx;
+   int villageIdx;
+   int value;
+   TurnEventType type;
+   uint8_t detail;
+};
+
+// Each consumer (UI, scripts, logging) keeps its own cursor into the log.
+struct TurnEventCursor
+{
+   uint64_t next = 0;    // Sequence number of the next event to read
+   uint64_t dropped = 0; // Events overwritten before this cursor got to them
+};
+
+const int TURN_EVENT_CAPACITY = 1024; // Must be a power of two
+
+// Fixed-capacity ring buffer of turn events.  Appending never allocates;
+// once full, the oldest events are overwritten and slow readers skip ahead.
+class TurnEventLog
+{
+public:
+   void beginTurn(int turn) { m_turn = turn; }
+   void push(TurnEventType type, int clanIdx, int villageIdx, int value, uint8_t detail = 0);
+
+   // Copies the next unread event into out and advances the cursor.  Returns false when caught up.
+   bool read(TurnEventCursor& cursor, TurnEvent& out) const;
+
+   // A cursor that starts reading from the next event pushed
+   TurnEventCursor cursorAtHead() const { return { m_head, 0 }; }
+
+   uint64_t head() const { return m_head; }
+   uint64_t oldest() const { return m_head > TURN_EVENT_CAPACITY ? m_head - TURN_EVENT_CAPACITY : 0; }
+   void clear() { m_head = 0; }
+
+private:
+   static_assert((TURN_EVENT_CAPACITY & (TURN_EVENT_CAPACITY - 1)) == 0, "TURN_EVENT_CAPACITY must be a power of two");
+
+   TurnEvent m_events[TURN_EVENT_CAPACITY];
+   uint64_t m_head = 0; // Total events ever pushed
+   int m_turn = 0;
+};
+
+const char* turnEventName(TurnEventType type);
+
+#endif
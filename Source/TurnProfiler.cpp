@@ -0,0 +1,105 @@
+#include "TurnProfiler.h"
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+static double msSince(Clock::time_point start)
+{
+   return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void TurnProfiler::beginTurn(int turn)
+{
+   m_current = TurnTimings();
+   m_current.turn = turn;
+   m_turnStart = Clock::now();
+}
+
+void TurnProfiler::endTurn()
+{
+   m_current.totalMs = msSince(m_turnStart);
+   m_history[m_next] = m_current;
+   m_next = (m_next + 1) % TURN_PROFILE_HISTORY;
+   if (m_count < TURN_PROFILE_HISTORY) ++m_count;
+}
+
+const TurnTimings& TurnProfiler::at(int i) const
+{
+   static const TurnTimings empty;
+   if (i < 0 || i >= m_count) return empty;
+   int oldest = (m_next - m_count + TURN_PROFILE_HISTORY) % TURN_PROFILE_HISTORY;
+   return m_history[(oldest + i) % TURN_PROFILE_HISTORY];
+}
+
+bool TurnProfiler::dumpCsv(const std::string& path) const
+{
+   std::ofstream out(path);
+   if (!out.is_open()) return false;
+
+   out << "turn";
+   for (int p = 0; p < TURN_PHASE_COUNT; ++p)
+      out << "," << turnPhaseName(static_cast<TurnPhase>(p));
+   out << ",total\n";
+
+   for (int i = 0; i < m_count; ++i)
+   {
+      const TurnTimings& t = at(i);
+      out << t.turn;
+      for (int p = 0; p < TURN_PHASE_COUNT; ++p)
+         out << "," << t.phaseMs[p];
+      out << "," << t.totalMs << "\n";
+   }
+   return true;
+}
+
+ScopedPhaseTimer::ScopedPhaseTimer(TurnProfiler* profiler, TurnPhase phase)
+   : m_profiler(profiler), m_phase(phase)
+{
+   if (m_profiler) m_start = Clock::now();
+}
+
+ScopedPhaseTimer::~ScopedPhaseTimer()
+{
+   if (m_profiler) m_profiler->addTime(m_phase, msSince(m_start));
+}
+
+const char* turnPhaseName(TurnPhase phase)
+{
+   switch (phase)
+   {
+   case TurnPhase::PRODUCTION:   return "production";
+   case TurnPhase::GROWTH:       return "growth";
+   case TurnPhase::CONSTRUCTION: return "construction";
+   case TurnPhase::UNIT_UPKEEP:  return "unit_upkeep";
+   case TurnPhase::AI:           return "ai";
+   case TurnPhase::SCRIPTING:    return "scripting";
+   case TurnPhase::COUNT:        break;
+   }
+   return "unknown";
+}
+
+size_t peakResidentBytes()
+{
+#ifdef _WIN32
+   PROCESS_MEMORY_COUNTERS counters;
+   if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+   return counters.PeakWorkingSetSize;
+#else
+   struct rusage usage;
+   if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+   return static_cast<size_t>(usage.ru_maxrss);        // Bytes on macOS
+#else
+   return static_cast<size_t>(usage.ru_maxrss) * 1024; // Kilobytes on Linux
+#endif
+#endif
+}
@@ -0,0 +1,67 @@
+#ifndef TURNPROFILER_H
+#define TURNPROFILER_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+// End-of-turn phases, in the order they run
+enum class TurnPhase
+{
+   PRODUCTION, GROWTH, CONSTRUCTION, UNIT_UPKEEP, AI, SCRIPTING, COUNT
+};
+
+const int TURN_PHASE_COUNT = static_cast<int>(TurnPhase::COUNT);
+const int TURN_PROFILE_HISTORY = 128; // Turns kept for the overlay and CSV dump
+
+struct TurnTimings
+{
+   int turn = 0;
+   double phaseMs[TURN_PHASE_COUNT] = {};
+   double totalMs = 0.0; // Wall time from beginTurn to endTurn, including untimed work
+};
+
+// Keeps the per-phase timings of the last TURN_PROFILE_HISTORY turns in a ring buffer.
+class TurnProfiler
+{
+public:
+   void beginTurn(int turn);
+   void addTime(TurnPhase phase, double ms) { m_current.phaseMs[static_cast<int>(phase)] += ms; }
+   void endTurn();
+
+   int count() const { return m_count; }
+   const TurnTimings& at(int i) const; // 0 = oldest kept turn
+   const TurnTimings& latest() const { return at(m_count - 1); }
+
+   bool dumpCsv(const std::string& path) const;
+
+private:
+   TurnTimings m_history[TURN_PROFILE_HISTORY];
+   int m_next = 0;
+   int m_count = 0;
+   TurnTimings m_current;
+   std::chrono::steady_clock::time_point m_turnStart;
+};
+
+// Adds the lifetime of the timer to one phase.  Does nothing when profiler is null.
+class ScopedPhaseTimer
+{
+public:
+   ScopedPhaseTimer(TurnProfiler* profiler, TurnPhase phase);
+   ~ScopedPhaseTimer();
+
+   ScopedPhaseTimer(const ScopedPhaseTimer&) = delete;
+   ScopedPhaseTimer& operator=(const ScopedPhaseTimer&) = delete;
+
+private:
+   TurnProfiler* m_profiler;
+   TurnPhase m_phase;
+   std::chrono::steady_clock::time_point m_start;
+};
+
+const char* turnPhaseName(TurnPhase phase);
+
+// The most memory the process has had resident so far, in bytes (0 if unknown)
+size_t peakResidentBytes();
+
+#endif
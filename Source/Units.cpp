@@ -0,0 +1,180 @@
+#include "Units.h"
+#include "Fog.h"
+#include "GameState.h"
+#include "StateHash.h"
+
+static const UnitTypeInfo UNIT_TYPES[UNIT_TYPE_COUNT] =
+{
+   // name         atk def move abilities                                                                     gold vision range
+   { "Settler",    0,  1,  1,   abilityBit(SpecialAbility::BUILD_VILLAGE),                                   10,  1,     1 },
+   { "Spearman",   2,  1,  3,   0,                                                                           6,   2,     1 },
+   { "Archer",     1,  1,  2,   0,                                                                           8,   2,     3 },
+   { "Swordsman",  4,  3,  1,   0,                                                                           12,  1,     1 },
+   { "Shaman",     1,  1,  2,   abilityBit(SpecialAbility::CAST_SPELL) | abilityBit(SpecialAbility::BUFF_STACK), 10,  2,     1 },
+};
+
+const UnitTypeInfo& unitTypeInfo(UnitType type)
+{
+   return UNIT_TYPES[static_cast<int>(type)];
+}
+
+static void linkToTile(GameState& state, int slot)
+{
+   Unit& unit = state.units[slot];
+   int& head = state.tileFirstUnit[state.tileIndex(unit.x, unit.y)];
+   unit.prevOnTile = -1;
+   unit.nextOnTile = head;
+   if (head >= 0)
+   {
+      state.units[head].prevOnTile = slot;
+      state.markChanged(ChangeKind::UNIT, head);
+   }
+   head = slot;
+   state.markChanged(ChangeKind::UNIT, slot);
+   state.markChanged(ChangeKind::TILE, state.tileIndex(unit.x, unit.y));
+}
+
+static void unlinkFromTile(GameState& state, int slot)
+{
+   Unit& unit = state.units[slot];
+   if (unit.prevOnTile >= 0)
+   {
+      state.units[unit.prevOnTile].nextOnTile = unit.nextOnTile;
+      state.markChanged(ChangeKind::UNIT, unit.prevOnTile);
+   }
+   else
+   {
+      state.tileFirstUnit[state.tileIndex(unit.x, unit.y)] = unit.nextOnTile;
+      state.markChanged(ChangeKind::TILE, state.tileIndex(unit.x, unit.y));
+   }
+   if (unit.nextOnTile >= 0)
+   {
+      state.units[unit.nextOnTile].prevOnTile = unit.prevOnTile;
+      state.markChanged(ChangeKind::UNIT, unit.nextOnTile);
+   }
+   state.markChanged(ChangeKind::UNIT, slot);
+   unit.nextOnTile = -1;
+   unit.prevOnTile = -1;
+}
+
+void initUnitPool(GameState& state, int capacity)
+{
+   state.units.assign(capacity, Unit());
+   state.tileFirstUnit.assign(state.width * state.height, -1);
+
+   // Chain the free list in slot order so the first units created get the lowest slots
+   for (int i = 0; i < capacity; ++i)
+      state.units[i].nextOnTile = (i + 1 < capacity) ? i + 1 : -1;
+   state.firstFreeUnit = capacity > 0 ? 0 : -1;
+   state.liveUnitCount = 0;
+   state.unitSlotsUsed = 0;
+}
+
+UnitHandle createUnit(GameState& state, UnitType type, int clanIdx, int x, int y)
+{
+   UnitHandle handle;
+   if (state.firstFreeUnit < 0 || !state.inBounds(x, y)) return handle;
+
+   const int slot = state.firstFreeUnit;
+   Unit& unit = state.units[slot];
+   state.firstFreeUnit = unit.nextOnTile;
+
+   const UnitTypeInfo& info = unitTypeInfo(type);
+   unit.type = type;
+   unit.clanIdx = clanIdx;
+   unit.x = x;
+   unit.y = y;
+   unit.attackStrength = info.attackStrength;
+   unit.defenseStrength = info.defenseStrength;
+   unit.movementPoints = info.movementPoints;
+   unit.abilities = info.abilities;
+   unit.alive = true;
+   linkToTile(state, slot);
+   ++state.liveUnitCount;
+   if (slot >= state.unitSlotsUsed) state.unitSlotsUsed = slot + 1;
+
+   state.worldHash ^= hashUnit(slot, unit);
+   addVision(state, clanIdx, x, y, info.visionRadius);
+
+   handle.index = slot;
+   handle.generation = unit.generation;
+   return handle;
+}
+
+void destroyUnit(GameState& state, UnitHandle handle)
+{
+   if (!isValidUnit(state, handle)) return;
+
+   const int slot = handle.index;
+   Unit& unit = state.units[slot];
+   state.worldHash ^= hashUnit(slot, unit);
+   removeVision(state, unit.clanIdx, unit.x, unit.y, unitTypeInfo(unit.type).visionRadius);
+
+   unlinkFromTile(state, slot);
+   unit.alive = false;
+   ++unit.generation;
+   unit.nextOnTile = state.firstFreeUnit;
+   state.firstFreeUnit = slot;
+   --state.liveUnitCount;
+}
+
+void moveUnit(GameState& state, UnitHandle handle, int x, int y)
+{
+   if (!isValidUnit(state, handle) || !state.inBounds(x, y)) return;
+
+   const int slot = handle.index;
+   Unit& unit = state.units[slot];
+   const uint64_t before = hashUnit(slot, unit);
+   const int vision = unitTypeInfo(unit.type).visionRadius;
+
+   removeVision(state, unit.clanIdx, unit.x, unit.y, vision);
+   unlinkFromTile(state, slot);
+   unit.x = x;
+   unit.y = y;
+   linkToTile(state, slot);
+   addVision(state, unit.clanIdx, x, y, vision);
+
+   state.worldHash ^= before ^ hashUnit(slot, unit);
+}
+
+bool isValidUnit(const GameState& state, UnitHandle handle)
+{
+   if (handle.index < 0 || handle.index >= (int)state.units.size()) return false;
+   const Unit& unit = state.units[handle.index];
+   return unit.alive && unit.generation == handle.generation;
+}
+
+Unit* getUnit(GameState& state, UnitHandle handle)
+{
+   return isValidUnit(state, handle) ? &state.units[handle.index] : nullptr;
+}
+
+const Unit* getUnit(const GameState& state, UnitHandle handle)
+{
+   return isValidUnit(state, handle) ? &state.units[handle.index] : nullptr;
+}
+
+UnitHandle unitHandle(const GameState& state, int slot)
+{
+   UnitHandle handle;
+   if (slot >= 0 && slot < (int)state.units.size() && state.units[slot].alive)
+   {
+      handle.index = slot;
+      handle.generation = state.units[slot].generation;
+   }
+   return handle;
+}
+
+int firstUnitOnTile(const GameState& state, int x, int y)
+{
+   if (!state.inBounds(x, y) || state.tileFirstUnit.empty()) return -1;
+   return state.tileFirstUnit[state.tileIndex(x, y)];
+}
+
+int countUnitsOnTile(const GameState& state, int x, int y)
+{
+   int count = 0;
+   for (int slot = firstUnitOnTile(state, x, y); slot >= 0; slot = state.units[slot].nextOnTile)
+      ++count;
+   return count;
+}
@@ -0,0 +1,56 @@
+#ifndef UNITS_H
+#define UNITS_H
+
+#include "Game.h"
+#include "Clan.h"
+#include <cstdint>
+
+struct GameState;
+
+// Base stats for each UnitType
+struct UnitTypeInfo
+{
+   const char* name;
+   int attackStrength;
+   int defenseStrength;
+   int movementPoints;   // Combat map move rate; on the main map every unit moves 1 tile per turn
+   unsigned int abilities;
+   int goldCost;
+   int visionRadius;     // Tiles revealed around the unit on the main map
+   int attackRange;      // Combat map cells the unit can strike across
+};
+
+const UnitTypeInfo& unitTypeInfo(UnitType type);
+
+// Refers to a unit pool slot.  The generation must match the slot's, so a handle
+// to a unit that has died (even if its slot was reused since) is simply invalid.
+struct UnitHandle
+{
+   int index = -1;
+   unsigned int generation = 0;
+
+   bool operator==(const UnitHandle& other) const { return index == other.index && generation == other.generation; }
+   bool operator!=(const UnitHandle& other) const { return !(*this == other); }
+};
+
+// The pool is GameState::units, sized once by initUnitPool.  Dead slots are chained
+// into a free list through Unit::nextOnTile, and live units on the same tile are
+// chained through nextOnTile/prevOnTile from GameState::tileFirstUnit.  Creating,
+// destroying and moving units are O(1) and never allocate.
+void initUnitPool(GameState& state, int capacity);
+
+// Returns an invalid handle (index -1) if the pool is full
+UnitHandle createUnit(GameState& state, UnitType type, int clanIdx, int x, int y);
+void destroyUnit(GameState& state, UnitHandle handle);
+void moveUnit(GameState& state, UnitHandle handle, int x, int y);
+
+bool isValidUnit(const GameState& state, UnitHandle handle);
+Unit* getUnit(GameState& state, UnitHandle handle);
+const Unit* getUnit(const GameState& state, UnitHandle handle);
+UnitHandle unitHandle(const GameState& state, int slot);
+
+// Head of the occupancy list for a tile (a pool slot, or -1); follow Unit::nextOnTile
+int firstUnitOnTile(const GameState& state, int x, int y);
+int countUnitsOnTile(const GameState& state, int x, int y);
+
+#endif
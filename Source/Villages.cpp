@@ -0,0 +1,208 @@
+#include "Villages.h"
+#include "BuildQueues.h"
+#include "Fog.h"
+#include "GameState.h"
+#include "StateHash.h"
+#include "Territory.h"
+#include "TurnEvents.h"
+#include <cstdio>
+
+static void linkToClan(GameState& state, int idx, int clanIdx)
+{
+   Village& village = state.villages[idx];
+   Clan& clan = state.clans[clanIdx];
+   village.clanIdx = clanIdx;
+   village.prevInClan = -1;
+   village.nextInClan = clan.firstVillage;
+   if (clan.firstVillage >= 0)
+   {
+      state.villages[clan.firstVillage].prevInClan = idx;
+      state.markChanged(ChangeKind::VILLAGE, clan.firstVillage);
+   }
+   clan.firstVillage = idx;
+   ++clan.villageCount;
+   state.markChanged(ChangeKind::VILLAGE, idx);
+   state.markChanged(ChangeKind::CLAN, clanIdx);
+}
+
+static void unlinkFromClan(GameState& state, int idx)
+{
+   Village& village = state.villages[idx];
+   Clan& clan = state.clans[village.clanIdx];
+   if (village.prevInClan >= 0)
+   {
+      state.villages[village.prevInClan].nextInClan = village.nextInClan;
+      state.markChanged(ChangeKind::VILLAGE, village.prevInClan);
+   }
+   else
+   {
+      clan.firstVillage = village.nextInClan;
+   }
+   if (village.nextInClan >= 0)
+   {
+      state.villages[village.nextInClan].prevInClan = village.prevInClan;
+      state.markChanged(ChangeKind::VILLAGE, village.nextInClan);
+   }
+   village.nextInClan = -1;
+   village.prevInClan = -1;
+   --clan.villageCount;
+   state.markChanged(ChangeKind::VILLAGE, idx);
+   state.markChanged(ChangeKind::CLAN, village.clanIdx);
+}
+
+// Reports a village change, and the territory it recolours.  Call while the region is
+// the village's: after founding, before razing.
+static void reportVillage(GameState& state, TurnEventType type, int idx)
+{
+   if (!state.events) return;
+   const Village& village = state.villages[idx];
+   const int tileIdx = state.tileIndex(village.x, village.y);
+   state.events->push(type, village.clanIdx, idx, tileIdx);
+   if (!state.territoryOwner.empty())
+   {
+      const int reach = territoryReach(state, idx, TERRITORY_REACH_MAX);
+      state.events->push(TurnEventType::TERRITORY_CHANGED, village.clanIdx, idx, tileIdx, static_cast<uint8_t>(reach));
+   }
+}
+
+static void setTileVillage(GameState& state, int x, int y, int idx)
+{
+   const int tileIdx = state.tileIndex(x, y);
+   SquareTile& tile = state.map[tileIdx];
+   const uint64_t tileKey = hashTile(tileIdx, tile);
+   tile.hasVillage = idx >= 0;
+   tile.villageIdx = idx;
+   state.worldHash ^= tileKey ^ hashTile(tileIdx, tile);
+   state.markChanged(ChangeKind::TILE, tileIdx);
+}
+
+VillageHandle foundVillage(GameState& state, int x, int y, int clanIdx)
+{
+   // Reuse a razed village's slot first; the generation it carries invalidates old handles
+   int idx = state.firstFreeVillage;
+   if (idx >= 0)
+   {
+      state.firstFreeVillage = state.villages[idx].nextInClan;
+   }
+   else
+   {
+      idx = (int)state.villages.size();
+      state.villages.push_back(Village());
+   }
+   setTileVillage(state, x, y, idx);
+
+   Village& village = state.villages[idx];
+   const unsigned int generation = village.generation;
+   village = Village();
+   village.generation = generation;
+   village.alive = true;
+   village.x = x;
+   village.y = y;
+   // Formatted on the stack: AI rollouts found villages too, and must not allocate
+   char name[MAX_NAME_LENGTH + 32];
+   std::snprintf(name, sizeof(name), "%s Village %d", state.clans[clanIdx].name, idx + 1);
+   setName(village.name, name);
+   village.population = 1; // Start with 1 (per design)
+   linkToClan(state, idx, clanIdx);
+   ++state.liveVillageCount;
+
+   // Fill in the per-turn outputs so the village panel has numbers before the next End Turn
+   VillageProduction production = calculateVillageProduction(village, state.clans[clanIdx]);
+   village.foodProduction = production.food;
+   village.productionOutput = production.production;
+   village.goldOutput = production.gold;
+   village.knowledgeOutput = production.knowledge;
+   village.worshipOutput = production.worship;
+   state.worldHash ^= hashVillage(idx, village);
+   state.markChanged(ChangeKind::VILLAGE, idx);
+
+   // Both are set up after map generation places the starting villages
+   addVision(state, clanIdx, x, y, VILLAGE_VISION_RADIUS);
+   if (!state.territoryOwner.empty())
+      addTerritorySource(state, idx);
+   reportVillage(state, TurnEventType::VILLAGE_FOUNDED, idx);
+
+   VillageHandle handle;
+   handle.index = idx;
+   handle.generation = village.generation;
+   return handle;
+}
+
+void captureVillage(GameState& state, VillageHandle handle, int clanIdx)
+{
+   if (!isValidVillage(state, handle) || clanIdx < 0 || clanIdx >= (int)state.clans.size()) return;
+
+   const int idx = handle.index;
+   Village& village = state.villages[idx];
+   if (village.clanIdx == clanIdx) return;
+
+   // The new owner starts with an empty queue
+   clearBuildQueue(state, idx);
+   const uint64_t before = hashVillage(idx, village);
+   removeVision(state, village.clanIdx, village.x, village.y, VILLAGE_VISION_RADIUS);
+   unlinkFromClan(state, idx);
+   linkToClan(state, idx, clanIdx);
+   addVision(state, clanIdx, village.x, village.y, VILLAGE_VISION_RADIUS);
+   state.worldHash ^= before ^ hashVillage(idx, village);
+   // The region stays put but changes colour
+   reportVillage(state, TurnEventType::VILLAGE_CAPTURED, idx);
+}
+
+void destroyVillage(GameState& state, VillageHandle handle)
+{
+   if (!isValidVillage(state, handle)) return;
+
+   const int idx = handle.index;
+   clearBuildQueue(state, idx);
+   Village& village = state.villages[idx];
+   state.worldHash ^= hashVillage(idx, village);
+   removeVision(state, village.clanIdx, village.x, village.y, VILLAGE_VISION_RADIUS);
+   reportVillage(state, TurnEventType::VILLAGE_DESTROYED, idx);
+   // Territory refills from the neighbours while the slot still describes this village
+   if (!state.territoryOwner.empty())
+      removeTerritorySource(state, idx);
+   setTileVillage(state, village.x, village.y, -1);
+   unlinkFromClan(state, idx);
+
+   village.alive = false;
+   village.clanIdx = -1;
+   ++village.generation;
+   village.nextInClan = state.firstFreeVillage;
+   state.firstFreeVillage = idx;
+   --state.liveVillageCount;
+   state.markChanged(ChangeKind::VILLAGE, idx);
+}
+
+bool canFoundVillage(const GameState& state, int x, int y)
+{
+   if (!state.inBounds(x, y)) return false;
+   const int idx = state.tileIndex(x, y);
+   if (state.map[idx].terrain != Terrain::GRASSLAND || state.map[idx].hasVillage) return false;
+   return state.territoryOwner.empty() || state.territoryDistance[idx] >= MIN_VILLAGE_SPACING;
+}
+
+bool isValidVillage(const GameState& state, VillageHandle handle)
+{
+   if (handle.index < 0 || handle.index >= (int)state.villages.size()) return false;
+   const Village& village = state.villages[handle.index];
+   return village.alive && village.generation == handle.generation;
+}
+
+Village* getVillage(GameState& state, VillageHandle handle)
+{
+   return isValidVillage(state, handle) ? &state.villages[handle.index] : nullptr;
+}
+
+const Village* getVillage(const GameState& state, VillageHandle handle)
+{
+   return isValidVillage(state, handle) ? &state.villages[handle.index] : nullptr;
+}
+
+VillageHandle villageHandle(const GameState& state, int idx)
+{
+   VillageHandle handle;
+   if (idx < 0 || idx >= (int)state.villages.size() || !state.villages[idx].alive) return handle;
+   handle.index = idx;
+   handle.generation = state.villages[idx].generation;
+   return handle;
+}
@@ -0,0 +1,47 @@
+#ifndef VILLAGES_H
+#define VILLAGES_H
+
+#include "Clan.h"
+
+struct GameState;
+
+// Refers to a slot in GameState::villages.  As with UnitHandle, the generation must
+// match the slot's, so a handle to a destroyed village stays invalid even after its
+// slot is reused.
+struct VillageHandle
+{
+   int index = -1;
+   unsigned int generation = 0;
+
+   bool operator==(const VillageHandle& other) const { return index == other.index && generation == other.generation; }
+   bool operator!=(const VillageHandle& other) const { return !(*this == other); }
+};
+
+// Villages live in GameState::villages.  Destroyed slots are chained into a free list
+// through Village::nextInClan and reused before the vector grows; live villages are
+// chained per clan through nextInClan/prevInClan from Clan::firstVillage.  Founding,
+// capturing and destroying a village are O(1) apart from the fog and territory
+// repairs around it, and keep the world hash, fog and territory in step once they
+// have been set up.
+
+// Adds a village for clanIdx on (x, y)
+VillageHandle foundVillage(GameState& state, int x, int y, int clanIdx);
+
+// Hands the village to another clan: membership lists and vision change, the
+// territory follows through Village::clanIdx
+void captureVillage(GameState& state, VillageHandle handle, int clanIdx);
+
+// Razes the village and frees its slot
+void destroyVillage(GameState& state, VillageHandle handle);
+
+// Villages go on free grassland at least MIN_VILLAGE_SPACING steps from any other
+bool canFoundVillage(const GameState& state, int x, int y);
+
+bool isValidVillage(const GameState& state, VillageHandle handle);
+Village* getVillage(GameState& state, VillageHandle handle);
+const Village* getVillage(const GameState& state, VillageHandle handle);
+
+// Handle for a slot index (an invalid handle if the slot is out of range or dead)
+VillageHandle villageHandle(const GameState& state, int idx);
+
+#endif
@@ -0,0 +1,89 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(int threads)
+{
+   if (threads < 0)
+   {
+      const int hardware = static_cast<int>(std::thread::hardware_concurrency());
+      threads = hardware > 1 ? hardware - 1 : 0;
+   }
+
+   m_threads.reserve(threads);
+   for (int i = 0; i < threads; ++i)
+      m_threads.emplace_back(&WorkerPool::workerLoop, this, i + 1);
+}
+
+WorkerPool::~WorkerPool()
+{
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_quit = true;
+   }
+   m_wake.notify_all();
+   for (auto& t : m_threads)
+      t.join();
+}
+
+void WorkerPool::run(int count, Task task, void* ctx)
+{
+   if (count <= 0) return;
+
+   // Not worth waking anybody for a single item
+   if (m_threads.empty() || count == 1)
+   {
+      for (int i = 0; i < count; ++i)
+         task(ctx, i, 0);
+      return;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_task = task;
+      m_ctx = ctx;
+      m_count = count;
+      m_next.store(0);
+      m_busyWorkers = static_cast<int>(m_threads.size());
+      ++m_jobId;
+   }
+   m_wake.notify_all();
+
+   drain(0);
+
+   std::unique_lock<std::mutex> lock(m_mutex);
+   m_done.wait(lock, [this] { return m_busyWorkers == 0; });
+   m_task = nullptr;
+}
+
+void WorkerPool::drain(int worker)
+{
+   for (int item = m_next.fetch_add(1); item < m_count; item = m_next.fetch_add(1))
+      m_task(m_ctx, item, worker);
+}
+
+void WorkerPool::workerLoop(int worker)
+{
+   unsigned long long seenJob = 0;
+   for (;;)
+   {
+      {
+         std::unique_lock<std::mutex> lock(m_mutex);
+         m_wake.wait(lock, [&] { return m_quit || m_jobId != seenJob; });
+         if (m_quit) return;
+         seenJob = m_jobId;
+      }
+
+      drain(worker);
+
+      {
+         std::lock_guard<std::mutex> lock(m_mutex);
+         if (--m_busyWorkers == 0)
+            m_done.notify_one();
+      }
+   }
+}
+
+WorkerPool& sharedWorkerPool()
+{
+   static WorkerPool pool;
+   return pool;
+}
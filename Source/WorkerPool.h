@@ -0,0 +1,59 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// A fixed set of worker threads for data-parallel simulation work.  parallelFor
+// hands out item indices from an atomic counter; the calling thread takes part as
+// worker 0, so workerCount() is the number of threads plus one.  Dispatching a job
+// does not allocate.  Only one parallelFor may run at a time.
+class WorkerPool
+{
+public:
+   explicit WorkerPool(int threads = -1); // -1 = one per hardware thread, minus the caller
+   ~WorkerPool();
+
+   WorkerPool(const WorkerPool&) = delete;
+   WorkerPool& operator=(const WorkerPool&) = delete;
+
+   int workerCount() const { return static_cast<int>(m_threads.size()) + 1; }
+
+   // Calls fn(item, worker) for every item in [0, count) and returns when all are done
+   template <typename Fn>
+   void parallelFor(int count, Fn&& fn)
+   {
+      using F = typename std::remove_reference<Fn>::type;
+      run(count, [](void* ctx, int item, int worker) { (*static_cast<F*>(ctx))(item, worker); },
+         const_cast<void*>(static_cast<const void*>(&fn)));
+   }
+
+private:
+   using Task = void (*)(void* ctx, int item, int worker);
+
+   void run(int count, Task task, void* ctx);
+   void drain(int worker);
+   void workerLoop(int worker);
+
+   std::vector<std::thread> m_threads;
+   std::mutex m_mutex;
+   std::condition_variable m_wake;
+   std::condition_variable m_done;
+
+   Task m_task = nullptr;
+   void* m_ctx = nullptr;
+   int m_count = 0;
+   std::atomic<int> m_next{0};
+   int m_busyWorkers = 0;
+   unsigned long long m_jobId = 0;
+   bool m_quit = false;
+};
+
+// Process-wide pool shared by the simulation systems; created on first use
+WorkerPool& sharedWorkerPool();
+
+#endif